@@ -0,0 +1,433 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+/// Multi-threaded contention benchmark for the recycle pools.
+///
+/// For every pool type and locking policy the benchmark runs two
+/// workloads on 1..N threads:
+///
+///   symmetric:      Every thread allocates a small batch of objects
+///                   from the shared pool and releases them again.
+///
+///   cross_thread:   Threads are paired up as producer and consumer. The
+///                   producer allocates and hands the object over a
+///                   queue, the consumer releases it. I.e. objects are
+///                   allocated on thread A and released on thread B.
+///                   The remote_free_pool runs this workload with one
+///                   pool owned by every producer, since only its owning
+///                   thread may allocate.
+///
+/// Throughput is reported as completed allocate/release pairs per
+/// second, together with the p50/p99/p99.9 latency (in nanoseconds) of
+/// the individual allocate and release operations.
+///
+/// Usage: recycle_contention_benchmark [max_threads] [operations]
+
+#include <recycle/adaptive_locking_policy.hpp>
+#include <recycle/local_pool.hpp>
+#include <recycle/mutex_locking_policy.hpp>
+#include <recycle/no_locking_policy.hpp>
+#include <recycle/remote_free_pool.hpp>
+#include <recycle/shared_pool.hpp>
+#include <recycle/spin_locking_policy.hpp>
+#include <recycle/unique_pool.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "latency_histogram.hpp"
+
+namespace
+{
+using clock_type = std::chrono::steady_clock;
+using recycle::benchmark::latency_histogram;
+
+/// The object we are pooling, roughly the size of a small packet header
+struct payload
+{
+    uint8_t m_data[64] = {0};
+};
+
+/// Single producer single consumer queue used to hand objects from
+/// the allocating thread to the releasing thread.
+template <class Handle>
+class handover_queue
+{
+public:
+    explicit handover_queue(std::size_t capacity) : m_slots(capacity)
+    {
+    }
+
+    bool push(Handle& handle)
+    {
+        std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        std::size_t head = m_head.load(std::memory_order_acquire);
+
+        if (tail - head == m_slots.size())
+        {
+            return false;
+        }
+
+        m_slots[tail % m_slots.size()] = std::move(handle);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(Handle& handle)
+    {
+        std::size_t head = m_head.load(std::memory_order_relaxed);
+        std::size_t tail = m_tail.load(std::memory_order_acquire);
+
+        if (head == tail)
+        {
+            return false;
+        }
+
+        handle = std::move(m_slots[head % m_slots.size()]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::vector<Handle> m_slots;
+    alignas(64) std::atomic<std::size_t> m_head{0};
+    alignas(64) std::atomic<std::size_t> m_tail{0};
+};
+
+/// The latencies recorded by a single thread
+struct thread_result
+{
+    latency_histogram m_allocate;
+    latency_histogram m_release;
+};
+
+uint64_t elapsed_ns(clock_type::time_point start, clock_type::time_point stop)
+{
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start)
+            .count());
+}
+
+/// Starts all threads behind a barrier so they hit the pool at the
+/// same time. Returns the wall clock time in seconds.
+template <class Function>
+double run_threads(std::size_t threads, Function function)
+{
+    std::atomic<std::size_t> ready{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> workers;
+
+    for (std::size_t i = 0; i < threads; ++i)
+    {
+        workers.emplace_back(
+            [&, i]()
+            {
+                ++ready;
+                while (!go.load(std::memory_order_acquire))
+                {
+                }
+                function(i);
+            });
+    }
+
+    while (ready.load() != threads)
+    {
+    }
+
+    auto start = clock_type::now();
+    go.store(true, std::memory_order_release);
+
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    auto stop = clock_type::now();
+    return static_cast<double>(elapsed_ns(start, stop)) / 1e9;
+}
+
+template <class Pool>
+double symmetric(Pool& pool, std::size_t threads, std::size_t operations,
+                 std::vector<thread_result>& results)
+{
+    const std::size_t batch = 8;
+
+    return run_threads(
+        threads,
+        [&](std::size_t index)
+        {
+            auto& result = results[index];
+            std::vector<decltype(pool.allocate())> handles(batch);
+
+            for (std::size_t i = 0; i < operations; i += batch)
+            {
+                for (auto& handle : handles)
+                {
+                    auto start = clock_type::now();
+                    handle = pool.allocate();
+                    auto stop = clock_type::now();
+                    result.m_allocate.record(elapsed_ns(start, stop));
+
+                    handle->m_data[0] = static_cast<uint8_t>(i);
+                }
+
+                for (auto& handle : handles)
+                {
+                    auto start = clock_type::now();
+                    handle.reset();
+                    auto stop = clock_type::now();
+                    result.m_release.record(elapsed_ns(start, stop));
+                }
+            }
+        });
+}
+
+template <class Pool>
+double cross_thread(Pool& pool, std::size_t threads, std::size_t operations,
+                    std::vector<thread_result>& results)
+{
+    using handle_type = decltype(pool.allocate());
+
+    std::size_t pairs = threads / 2;
+    std::vector<std::unique_ptr<handover_queue<handle_type>>> queues;
+
+    for (std::size_t i = 0; i < pairs; ++i)
+    {
+        queues.emplace_back(new handover_queue<handle_type>(256));
+    }
+
+    return run_threads(
+        pairs * 2,
+        [&](std::size_t index)
+        {
+            auto& result = results[index];
+            auto& queue = *queues[index / 2];
+
+            if (index % 2 == 0)
+            {
+                // Producer: allocates and hands the object over
+                for (std::size_t i = 0; i < operations; ++i)
+                {
+                    auto start = clock_type::now();
+                    handle_type handle = pool.allocate();
+                    auto stop = clock_type::now();
+                    result.m_allocate.record(elapsed_ns(start, stop));
+
+                    handle->m_data[0] = static_cast<uint8_t>(i);
+
+                    while (!queue.push(handle))
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+            }
+            else
+            {
+                // Consumer: releases what the producer allocated
+                handle_type handle;
+
+                for (std::size_t i = 0; i < operations; ++i)
+                {
+                    while (!queue.pop(handle))
+                    {
+                        std::this_thread::yield();
+                    }
+
+                    auto start = clock_type::now();
+                    handle.reset();
+                    auto stop = clock_type::now();
+                    result.m_release.record(elapsed_ns(start, stop));
+                }
+            }
+        });
+}
+
+/// Like cross_thread, but every producer owns its own pool which is
+/// created on the producer thread
+template <class Pool>
+double cross_thread_owned(std::size_t threads, std::size_t operations,
+                          std::vector<thread_result>& results)
+{
+    using handle_type = typename Pool::pool_ptr;
+
+    std::size_t pairs = threads / 2;
+    std::vector<std::unique_ptr<handover_queue<handle_type>>> queues;
+
+    for (std::size_t i = 0; i < pairs; ++i)
+    {
+        queues.emplace_back(new handover_queue<handle_type>(256));
+    }
+
+    return run_threads(
+        pairs * 2,
+        [&](std::size_t index)
+        {
+            auto& result = results[index];
+            auto& queue = *queues[index / 2];
+
+            if (index % 2 == 0)
+            {
+                Pool pool;
+
+                for (std::size_t i = 0; i < operations; ++i)
+                {
+                    auto start = clock_type::now();
+                    handle_type handle = pool.allocate();
+                    auto stop = clock_type::now();
+                    result.m_allocate.record(elapsed_ns(start, stop));
+
+                    handle->m_data[0] = static_cast<uint8_t>(i);
+
+                    while (!queue.push(handle))
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+            }
+            else
+            {
+                handle_type handle;
+
+                for (std::size_t i = 0; i < operations; ++i)
+                {
+                    while (!queue.pop(handle))
+                    {
+                        std::this_thread::yield();
+                    }
+
+                    auto start = clock_type::now();
+                    handle.reset();
+                    auto stop = clock_type::now();
+                    result.m_release.record(elapsed_ns(start, stop));
+                }
+            }
+        });
+}
+
+void report(const std::string& pool, const std::string& policy,
+            const std::string& scenario, std::size_t threads,
+            double seconds, const std::vector<thread_result>& results)
+{
+    thread_result total;
+
+    for (const auto& result : results)
+    {
+        total.m_allocate.merge(result.m_allocate);
+        total.m_release.merge(result.m_release);
+    }
+
+    double throughput =
+        static_cast<double>(total.m_release.count()) / seconds;
+
+    std::printf("%-12s %-10s %-13s %7zu %14.0f"
+                " %7llu %7llu %7llu %7llu %7llu %7llu\n",
+                pool.c_str(), policy.c_str(), scenario.c_str(), threads,
+                throughput,
+                (unsigned long long)total.m_allocate.percentile(50.0),
+                (unsigned long long)total.m_allocate.percentile(99.0),
+                (unsigned long long)total.m_allocate.percentile(99.9),
+                (unsigned long long)total.m_release.percentile(50.0),
+                (unsigned long long)total.m_release.percentile(99.0),
+                (unsigned long long)total.m_release.percentile(99.9));
+}
+
+template <class Pool>
+void run_policy(const std::string& pool_name, const std::string& policy,
+                bool thread_safe, std::size_t max_threads,
+                std::size_t operations)
+{
+    for (std::size_t threads = 1; threads <= max_threads; threads *= 2)
+    {
+        if (threads > 1 && !thread_safe)
+        {
+            break;
+        }
+
+        {
+            Pool pool;
+            std::vector<thread_result> results(threads);
+            double seconds = symmetric(pool, threads, operations, results);
+            report(pool_name, policy, "symmetric", threads, seconds, results);
+        }
+
+        if (threads >= 2)
+        {
+            Pool pool;
+            std::vector<thread_result> results(threads);
+            double seconds =
+                cross_thread(pool, threads, operations, results);
+            report(pool_name, policy, "cross_thread", threads, seconds,
+                   results);
+        }
+    }
+}
+
+template <template <class, class> class Pool>
+void run_pool(const std::string& pool_name, std::size_t max_threads,
+              std::size_t operations)
+{
+    run_policy<Pool<payload, recycle::no_locking_policy>>(
+        pool_name, "none", false, max_threads, operations);
+    run_policy<Pool<payload, recycle::mutex_locking_policy>>(
+        pool_name, "mutex", true, max_threads, operations);
+    run_policy<Pool<payload, recycle::spin_locking_policy>>(
+        pool_name, "spinlock", true, max_threads, operations);
+    run_policy<Pool<payload, recycle::adaptive_locking_policy>>(
+        pool_name, "adaptive", true, max_threads, operations);
+}
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t max_threads = std::thread::hardware_concurrency();
+    std::size_t operations = 100000;
+
+    if (argc > 1)
+    {
+        max_threads = std::strtoul(argv[1], nullptr, 10);
+    }
+
+    if (argc > 2)
+    {
+        operations = std::strtoul(argv[2], nullptr, 10);
+    }
+
+    if (max_threads < 2)
+    {
+        max_threads = 2;
+    }
+
+    std::printf("%-12s %-10s %-13s %7s %14s"
+                " %7s %7s %7s %7s %7s %7s\n",
+                "pool", "policy", "scenario", "threads", "ops/s",
+                "a.p50", "a.p99", "a.p99.9", "r.p50", "r.p99", "r.p99.9");
+
+    run_pool<recycle::unique_pool>("unique_pool", max_threads, operations);
+    run_pool<recycle::shared_pool>("shared_pool", max_threads, operations);
+
+    // The local_pool is single-threaded only
+    run_policy<recycle::local_pool<payload>>("local_pool", "none", false,
+                                             max_threads, operations);
+
+    // The remote_free_pool is lock-free, but only the owner allocates
+    for (std::size_t threads = 2; threads <= max_threads; threads *= 2)
+    {
+        std::vector<thread_result> results(threads);
+        double seconds =
+            cross_thread_owned<recycle::remote_free_pool<payload>>(
+                threads, operations, results);
+        report("remote_free", "lock-free", "cross_thread", threads, seconds,
+               results);
+    }
+
+    return 0;
+}
@@ -0,0 +1,156 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+
+namespace recycle
+{
+namespace benchmark
+{
+/// @brief Log-linear latency histogram in the style of HdrHistogram.
+///
+/// Values below 32 are recorded exactly. Above that every power of two
+/// is split into 16 linear sub-buckets, which bounds the relative error
+/// of a reported percentile to roughly 6% while keeping the histogram
+/// small enough to keep one per thread and merge them afterwards.
+class latency_histogram
+{
+public:
+    /// Record a single value, typically a latency in nanoseconds
+    void record(uint64_t value)
+    {
+        ++m_counts[bucket_index(value)];
+        ++m_total;
+
+        if (value > m_max)
+        {
+            m_max = value;
+        }
+    }
+
+    /// Add all the values recorded in another histogram to this one
+    void merge(const latency_histogram& other)
+    {
+        for (std::size_t i = 0; i < m_counts.size(); ++i)
+        {
+            m_counts[i] += other.m_counts[i];
+        }
+
+        m_total += other.m_total;
+
+        if (other.m_max > m_max)
+        {
+            m_max = other.m_max;
+        }
+    }
+
+    /// @return The number of recorded values
+    uint64_t count() const
+    {
+        return m_total;
+    }
+
+    /// @return The largest recorded value
+    uint64_t max() const
+    {
+        return m_max;
+    }
+
+    /// @param percentile The percentile in the range [0, 100]
+    /// @return The value at the given percentile. The value reported is
+    ///         the upper bound of the bucket the percentile falls into.
+    uint64_t percentile(double percentile) const
+    {
+        assert(percentile >= 0.0 && percentile <= 100.0);
+
+        if (m_total == 0)
+        {
+            return 0;
+        }
+
+        uint64_t rank = static_cast<uint64_t>(
+            std::ceil(percentile / 100.0 * static_cast<double>(m_total)));
+
+        if (rank == 0)
+        {
+            rank = 1;
+        }
+
+        uint64_t seen = 0;
+        for (std::size_t i = 0; i < m_counts.size(); ++i)
+        {
+            seen += m_counts[i];
+
+            if (seen >= rank)
+            {
+                uint64_t upper = bucket_upper_bound(i);
+                return upper < m_max ? upper : m_max;
+            }
+        }
+
+        return m_max;
+    }
+
+private:
+    /// Number of values recorded exactly
+    static constexpr uint64_t exact_values = 32;
+
+    /// Number of linear sub-buckets per power of two above exact_values
+    static constexpr uint64_t sub_buckets = 16;
+
+    /// Number of powers of two we can represent above exact_values
+    static constexpr uint64_t exponents = 59;
+
+    static std::size_t bucket_index(uint64_t value)
+    {
+        if (value < exact_values)
+        {
+            return static_cast<std::size_t>(value);
+        }
+
+        // Shift so that the value falls in [sub_buckets, 2 * sub_buckets)
+        uint64_t shift = 0;
+        while ((value >> shift) >= 2 * sub_buckets)
+        {
+            ++shift;
+        }
+
+        assert(shift >= 1);
+        return static_cast<std::size_t>(exact_values +
+                                        (shift - 1) * sub_buckets +
+                                        ((value >> shift) - sub_buckets));
+    }
+
+    static uint64_t bucket_upper_bound(std::size_t index)
+    {
+        if (index < exact_values)
+        {
+            return index;
+        }
+
+        uint64_t offset = index - exact_values;
+        uint64_t shift = offset / sub_buckets + 1;
+        uint64_t sub = offset % sub_buckets + sub_buckets;
+
+        return ((sub + 1) << shift) - 1;
+    }
+
+private:
+    /// The bucket counters
+    std::array<uint64_t, exact_values + exponents * sub_buckets> m_counts{};
+
+    /// The total number of recorded values
+    uint64_t m_total = 0;
+
+    /// The largest recorded value
+    uint64_t m_max = 0;
+};
+}
+}
@@ -0,0 +1,134 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "cpu_relax.hpp"
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace recycle
+{
+/// Locking policy using a mutex which spins for a short while before
+/// going to sleep.
+///
+/// Most of the time the lock of a pool is released again after a few
+/// instructions, so a short spin acquires it without a system call. If
+/// the lock is still held after spinning, e.g. because its owner was
+/// preempted, the waiting thread sleeps on a futex on Linux. On other
+/// platforms it falls back to yielding the CPU.
+///
+/// The mutex follows the three state futex mutex described by Ulrich
+/// Drepper in "Futexes Are Tricky": 0 is unlocked, 1 is locked and 2 is
+/// locked with possible sleepers. Only unlocking a mutex in state 2
+/// costs a system call.
+struct adaptive_locking_policy
+{
+    /// The spin-then-sleep mutex
+    class adaptive_mutex
+    {
+    public:
+        /// The number of attempts to acquire the lock before sleeping
+        static constexpr uint32_t spin_limit = 100;
+
+        /// Creates the mutex in unlocked state
+        adaptive_mutex() = default;
+
+        /// The mutex is not copyable
+        adaptive_mutex(const adaptive_mutex&) = delete;
+
+        /// The mutex is not copyable
+        adaptive_mutex& operator=(const adaptive_mutex&) = delete;
+
+        /// Acquires the lock, sleeping if it is not available after
+        /// spinning
+        void lock()
+        {
+            for (uint32_t i = 0; i < spin_limit; ++i)
+            {
+                if (try_lock())
+                {
+                    return;
+                }
+
+                cpu_relax();
+            }
+
+            // Mark the lock as contended, so that unlock() wakes us up
+            while (m_state.exchange(contended, std::memory_order_acquire) !=
+                   unlocked)
+            {
+                wait();
+            }
+        }
+
+        /// @return True if the lock was acquired
+        bool try_lock()
+        {
+            uint32_t expected = unlocked;
+            return m_state.load(std::memory_order_relaxed) == unlocked &&
+                   m_state.compare_exchange_strong(expected, locked,
+                                                   std::memory_order_acquire,
+                                                   std::memory_order_relaxed);
+        }
+
+        /// Releases the lock, waking up one sleeping thread if any
+        void unlock()
+        {
+            if (m_state.exchange(unlocked, std::memory_order_release) ==
+                contended)
+            {
+                wake();
+            }
+        }
+
+    private:
+        void wait()
+        {
+#if defined(__linux__)
+            ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_state),
+                      FUTEX_WAIT_PRIVATE, contended, nullptr, nullptr, 0);
+#else
+            std::this_thread::yield();
+#endif
+        }
+
+        void wake()
+        {
+#if defined(__linux__)
+            ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_state),
+                      FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#endif
+        }
+
+    private:
+        /// The states of the mutex
+        static constexpr uint32_t unlocked = 0;
+        static constexpr uint32_t locked = 1;
+        static constexpr uint32_t contended = 2;
+
+        /// The state of the mutex, also used as the futex word
+        std::atomic<uint32_t> m_state{unlocked};
+
+        static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+                      "The futex word must be 32 bits");
+    };
+
+    /// The locking policy mutex type
+    using mutex_type = adaptive_mutex;
+
+    /// The locking policy lock type
+    using lock_type = std::lock_guard<mutex_type>;
+};
+}
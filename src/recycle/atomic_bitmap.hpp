@@ -0,0 +1,145 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+
+#include "bit_operations.hpp"
+
+namespace recycle
+{
+/// @brief Lock-free allocator of N slots tracked in an atomic bitmap.
+///
+/// Every slot is a bit which is set while the slot is free. A slot is
+/// claimed by finding a word with a set bit, picking the lowest set bit
+/// and clearing it with fetch_and. If another thread cleared the same bit
+/// first, the previous value returned by fetch_and tells us which bits
+/// remain and we try the next one. Releasing a slot is a single fetch_or.
+///
+/// Since a slot is identified by its bit alone and there are no pointers
+/// to swing, the allocator has no ABA problem.
+///
+/// Claiming starts at a rotating hint rather than at the first word, so
+/// that threads do not all contend for the bits of the first word. The
+/// words are scanned with plain loads, skipping empty words without
+/// writing to them.
+///
+/// Claiming a slot synchronizes with releasing it, so everything written
+/// to the slot's memory before release() is visible after claim().
+template <std::size_t N>
+class atomic_bitmap
+{
+public:
+    static_assert(N > 0, "The bitmap must have at least one slot");
+
+    /// Returned by claim() when all slots are in use
+    static constexpr std::size_t npos =
+        std::numeric_limits<std::size_t>::max();
+
+    /// The number of slots
+    static constexpr std::size_t capacity = N;
+
+public:
+    /// Constructor, all slots are free
+    atomic_bitmap()
+    {
+        for (std::size_t i = 0; i < words; ++i)
+        {
+            m_words[i].store(~uint64_t{0}, std::memory_order_relaxed);
+        }
+
+        // Clear the bits beyond the last slot
+        if (N % 64 != 0)
+        {
+            m_words[words - 1].store((uint64_t{1} << (N % 64)) - 1,
+                                     std::memory_order_relaxed);
+        }
+    }
+
+    /// The bitmap is not copyable
+    atomic_bitmap(const atomic_bitmap&) = delete;
+
+    /// The bitmap is not copyable
+    atomic_bitmap& operator=(const atomic_bitmap&) = delete;
+
+    /// Claims a free slot
+    /// @return The index of the slot or npos if all slots are in use
+    std::size_t claim()
+    {
+        std::size_t start = m_hint.load(std::memory_order_relaxed);
+
+        for (std::size_t n = 0; n < words; ++n)
+        {
+            std::size_t index = (start + n) % words;
+            uint64_t word = m_words[index].load(std::memory_order_relaxed);
+
+            while (word != 0)
+            {
+                uint32_t bit = count_trailing_zeros(word);
+                uint64_t mask = uint64_t{1} << bit;
+
+                uint64_t previous = m_words[index].fetch_and(
+                    ~mask, std::memory_order_acquire);
+
+                if ((previous & mask) != 0)
+                {
+                    if (index != start)
+                    {
+                        m_hint.store(index, std::memory_order_relaxed);
+                    }
+
+                    return index * 64 + bit;
+                }
+
+                // Somebody beat us to it, try the remaining bits
+                word = previous & ~mask;
+            }
+        }
+
+        return npos;
+    }
+
+    /// Releases a claimed slot
+    /// @param slot The index returned by claim()
+    void release(std::size_t slot)
+    {
+        assert(slot < N);
+
+        uint64_t mask = uint64_t{1} << (slot % 64);
+        uint64_t previous =
+            m_words[slot / 64].fetch_or(mask, std::memory_order_release);
+
+        assert((previous & mask) == 0 && "Slot released twice");
+        (void)previous;
+    }
+
+    /// @return The number of free slots. Only a snapshot if other
+    ///         threads claim or release slots concurrently.
+    std::size_t available() const
+    {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < words; ++i)
+        {
+            count += popcount(m_words[i].load(std::memory_order_relaxed));
+        }
+
+        return count;
+    }
+
+private:
+    /// The number of 64 bit words in the bitmap
+    static constexpr std::size_t words = (N + 63) / 64;
+
+    /// Bit i is set if slot i is free
+    std::atomic<uint64_t> m_words[words];
+
+    /// The word the next claim starts scanning at
+    std::atomic<std::size_t> m_hint{0};
+};
+}
@@ -0,0 +1,139 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace recycle
+{
+/// @brief A zero-copy, read-only view of a sub-range of a shared buffer.
+///
+/// A slice shares the ownership of the buffer it was taken from, so a
+/// buffer allocated from a shared_pool only returns to the pool when the
+/// buffer itself and the last slice of it have been destroyed.
+///
+/// Slices use the aliasing constructor of std::shared_ptr, i.e. they
+/// point into the buffer but share its control block. Creating, copying
+/// and destroying a slice therefore never allocates, it only updates the
+/// reference count of the buffer.
+///
+/// Example, splitting a pooled buffer into MTU sized packets:
+///
+///     recycle::shared_pool<std::vector<uint8_t>> pool;
+///
+///     auto buffer = pool.allocate();
+///     ...
+///     std::vector<recycle::buffer_slice> packets;
+///     for (std::size_t offset = 0; offset < buffer->size(); offset += mtu)
+///     {
+///         std::size_t size = std::min(mtu, buffer->size() - offset);
+///         packets.push_back(recycle::slice(buffer, offset, size));
+///     }
+///
+class buffer_slice
+{
+public:
+    /// Creates an empty slice
+    buffer_slice() = default;
+
+    /// Creates a slice of a buffer
+    /// @param data Pointer to the first byte, sharing the ownership of
+    ///        the buffer
+    /// @param size The number of bytes in the slice
+    buffer_slice(std::shared_ptr<const uint8_t> data, std::size_t size) :
+        m_data(std::move(data)), m_size(size)
+    {
+        assert(m_data || m_size == 0);
+    }
+
+    /// @return Pointer to the first byte of the slice
+    const uint8_t* data() const
+    {
+        return m_data.get();
+    }
+
+    /// @return The number of bytes in the slice
+    std::size_t size() const
+    {
+        return m_size;
+    }
+
+    /// @return True if the slice is empty
+    bool empty() const
+    {
+        return m_size == 0;
+    }
+
+    /// @return The number of owners of the underlying buffer, including
+    ///          the slice itself
+    long use_count() const
+    {
+        return m_data.use_count();
+    }
+
+    /// Creates a slice of this slice, also sharing the ownership of the
+    /// underlying buffer
+    /// @param offset The offset of the first byte relative to this slice
+    /// @param size The number of bytes in the new slice
+    /// @return The new slice
+    buffer_slice slice(std::size_t offset, std::size_t size) const
+    {
+        assert(offset <= m_size && size <= m_size - offset);
+        return buffer_slice(
+            std::shared_ptr<const uint8_t>(m_data, data() + offset), size);
+    }
+
+    /// Drops the slice's share of the underlying buffer
+    void reset()
+    {
+        m_data.reset();
+        m_size = 0;
+    }
+
+private:
+    /// Pointer to the first byte, sharing the ownership of the buffer
+    std::shared_ptr<const uint8_t> m_data;
+
+    /// The number of bytes in the slice
+    std::size_t m_size = 0;
+};
+
+/// Creates a slice of a shared buffer. The buffer must provide data()
+/// returning a pointer to its elements and size() returning their number,
+/// e.g. a std::vector. The slice is a view of the bytes of the elements.
+/// @param buffer The buffer, e.g. allocated from a shared_pool
+/// @param offset The offset of the first byte of the slice
+/// @param size The number of bytes in the slice
+/// @return The slice sharing the ownership of the buffer
+template <class Buffer>
+buffer_slice slice(const std::shared_ptr<Buffer>& buffer, std::size_t offset,
+                   std::size_t size)
+{
+    assert(buffer);
+
+    std::size_t bytes = buffer->size() * sizeof(*buffer->data());
+    assert(offset <= bytes && size <= bytes - offset);
+    (void)bytes;
+
+    const uint8_t* data = static_cast<const uint8_t*>(
+        static_cast<const void*>(buffer->data()));
+    return buffer_slice(std::shared_ptr<const uint8_t>(buffer, data + offset),
+                        size);
+}
+
+/// Creates a slice of a whole shared buffer
+/// @param buffer The buffer, e.g. allocated from a shared_pool
+/// @return The slice sharing the ownership of the buffer
+template <class Buffer>
+buffer_slice slice(const std::shared_ptr<Buffer>& buffer)
+{
+    assert(buffer);
+    return slice(buffer, 0, buffer->size() * sizeof(*buffer->data()));
+}
+}
@@ -0,0 +1,356 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace recycle
+{
+/// @brief A lightweight pool which borrows its resources from a parent
+///        unique_pool or shared_pool in batches.
+///
+/// A child_pool is meant to serve a single connection, task or thread.
+/// When it runs empty it borrows a batch of resources from the parent, and
+/// it gives resources back to the parent in batches when it holds more
+/// than two batches. When the child_pool is destroyed its whole free list
+/// is given back. The parent therefore only is locked once per batch, and
+/// the resources of a connection stay warm in its child.
+///
+/// Resources given back to the parent go through the parent's recycle
+/// function and byte budget, so a burst on one connection does not
+/// permanently grow the free list of the parent beyond its budget.
+///
+/// Example:
+///
+///     recycle::unique_pool<buffer, recycle::mutex_locking_policy> pool;
+///
+///     // In the connection
+///     recycle::child_pool<decltype(pool)> child(pool, 16);
+///     auto b = child.allocate();
+///
+/// The child_pool hands out the same kind of pointer as the parent, i.e. a
+/// std::unique_ptr with a custom deleter for a unique_pool and a
+/// std::shared_ptr for a shared_pool. If the child_pool dies before the
+/// resources it has handed out, they are given back to the parent when
+/// released.
+///
+/// The child_pool and the resources allocated from it must only be used
+/// from a single thread, like the local_pool. If children on different
+/// threads share a parent, the parent needs a thread safe locking policy.
+/// The parent must neither be destroyed nor moved while it has children
+/// or their resources are in use.
+template <class Parent>
+class child_pool
+{
+private:
+    /// Forward declare
+    struct deleter;
+    struct impl;
+
+public:
+    /// The type of the parent pool
+    using parent_type = Parent;
+
+    /// The type managed
+    using value_type = typename Parent::value_type;
+
+    /// The owning pointer to the resource
+    using value_ptr = typename Parent::value_ptr;
+
+    /// The pointer to the resource
+    using pool_ptr = typename std::conditional<
+        std::is_same<value_ptr, std::shared_ptr<value_type>>::value,
+        std::shared_ptr<value_type>,
+        std::unique_ptr<value_type, deleter>>::type;
+
+    /// The recycle function type
+    /// If specified the recycle function will be called every time a
+    /// resource gets recycled into the child_pool. If the recycle function
+    /// resets the resource, it is destroyed instead of being kept.
+    using recycle_function = typename Parent::recycle_function;
+
+    /// The default number of resources borrowed at once
+    static constexpr std::size_t default_batch = 16;
+
+public:
+    /// Create a child_pool
+    /// @param parent The pool to borrow the resources from
+    /// @param batch The number of resources borrowed at once
+    explicit child_pool(Parent& parent, std::size_t batch = default_batch) :
+        m_pool(new impl(parent, batch, recycle_function()))
+    {
+    }
+
+    /// Create a child_pool with a recycle function
+    /// @param parent The pool to borrow the resources from
+    /// @param batch The number of resources borrowed at once
+    /// @param recycle Recycle function
+    child_pool(Parent& parent, std::size_t batch, recycle_function recycle) :
+        m_pool(new impl(parent, batch, std::move(recycle)))
+    {
+    }
+
+    /// The child_pool is not copyable
+    child_pool(const child_pool&) = delete;
+
+    /// The child_pool is not copyable
+    child_pool& operator=(const child_pool&) = delete;
+
+    /// Move constructor
+    child_pool(child_pool&& other) : m_pool(other.m_pool)
+    {
+        assert(m_pool);
+        other.m_pool = nullptr;
+    }
+
+    /// Move assignment
+    child_pool& operator=(child_pool&& other)
+    {
+        std::swap(m_pool, other.m_pool);
+        return *this;
+    }
+
+    /// Destructor, gives the unused resources back to the parent
+    ~child_pool()
+    {
+        if (m_pool)
+        {
+            m_pool->close();
+        }
+    }
+
+    /// @return A resource from the pool.
+    pool_ptr allocate()
+    {
+        assert(m_pool);
+        return m_pool->allocate();
+    }
+
+    /// @returns the number of unused resources held by the child_pool
+    std::size_t unused_resources() const
+    {
+        assert(m_pool);
+        return m_pool->unused_resources();
+    }
+
+    /// @returns the number of resources borrowed at once
+    std::size_t batch() const
+    {
+        assert(m_pool);
+        return m_pool->batch();
+    }
+
+    /// Gives all unused resources back to the parent
+    void flush()
+    {
+        assert(m_pool);
+        m_pool->flush();
+    }
+
+    /// @return The parent pool
+    parent_type& parent() const
+    {
+        assert(m_pool);
+        return m_pool->parent();
+    }
+
+private:
+    /// The actual pool implementation. The impl is owned by the
+    /// child_pool together with all the resources currently handed out.
+    /// It is deleted when the pool has been closed and the last
+    /// outstanding resource has been released.
+    struct impl
+    {
+        /// @copydoc child_pool::child_pool(Parent&, std::size_t,
+        ///                                 recycle_function)
+        impl(Parent& parent, std::size_t batch, recycle_function recycle) :
+            m_parent(&parent), m_batch(batch), m_recycle(std::move(recycle))
+        {
+            assert(m_batch > 0);
+        }
+
+        /// Allocate a new value from the pool
+        pool_ptr allocate()
+        {
+            if (m_free_list.empty())
+            {
+                m_free_list = m_parent->borrow(m_batch);
+            }
+
+            assert(!m_free_list.empty());
+            value_ptr resource = std::move(m_free_list.back());
+            m_free_list.pop_back();
+
+            ++m_outstanding;
+
+            value_type* naked_ptr = resource.get();
+            return pool_ptr(naked_ptr, deleter(this, std::move(resource)));
+        }
+
+        /// @copydoc child_pool::unused_resources()
+        std::size_t unused_resources() const
+        {
+            return m_free_list.size();
+        }
+
+        /// @copydoc child_pool::batch()
+        std::size_t batch() const
+        {
+            return m_batch;
+        }
+
+        /// @copydoc child_pool::flush()
+        void flush()
+        {
+            give_back(m_free_list.size());
+        }
+
+        /// @copydoc child_pool::parent()
+        parent_type& parent() const
+        {
+            return *m_parent;
+        }
+
+        /// This function called when a resource has been released by
+        /// its pool_ptr
+        void release(value_ptr resource)
+        {
+            assert(m_outstanding > 0);
+            --m_outstanding;
+
+            if (m_open)
+            {
+                if (m_recycle)
+                {
+                    m_recycle(resource);
+                }
+
+                // The recycle function dropped the resource
+                if (!resource)
+                {
+                    return;
+                }
+
+                m_free_list.push_back(std::move(resource));
+
+                // Keep one batch and give the rest back to the parent,
+                // the oldest first
+                if (m_free_list.size() > 2 * m_batch)
+                {
+                    give_back(m_free_list.size() - m_batch);
+                }
+
+                return;
+            }
+
+            // The child_pool is gone, the resource goes straight back to
+            // the parent and, if it was the last one, we delete ourselves.
+            std::vector<value_ptr> resources;
+            resources.push_back(std::move(resource));
+            m_parent->give_back(std::move(resources));
+
+            if (m_outstanding == 0)
+            {
+                delete this;
+            }
+        }
+
+        /// Called when the owning child_pool is destroyed
+        void close()
+        {
+            assert(m_open);
+            m_open = false;
+            flush();
+
+            if (m_outstanding == 0)
+            {
+                delete this;
+            }
+        }
+
+    private:
+        /// Gives the given number of resources from the front of the free
+        /// list back to the parent
+        void give_back(std::size_t count)
+        {
+            if (count == 0)
+            {
+                return;
+            }
+
+            auto first = m_free_list.begin();
+            auto last = first + count;
+
+            std::vector<value_ptr> resources(std::make_move_iterator(first),
+                                             std::make_move_iterator(last));
+            m_free_list.erase(first, last);
+
+            m_parent->give_back(std::move(resources));
+        }
+
+    private:
+        /// The pool the resources are borrowed from
+        Parent* m_parent;
+
+        /// The number of resources borrowed at once
+        std::size_t m_batch;
+
+        /// The recycle function
+        recycle_function m_recycle;
+
+        /// Stores all the free resources
+        std::vector<value_ptr> m_free_list;
+
+        /// The number of resources handed out and not yet released
+        std::size_t m_outstanding = 0;
+
+        /// True as long as the owning child_pool is alive
+        bool m_open = true;
+    };
+
+    /// The custom deleter object used by the pool_ptr. It stores a plain
+    /// pointer to the pool state, which is kept alive as long as there
+    /// are outstanding resources, and the owning pointer to the resource.
+    struct deleter
+    {
+        /// Constructor
+        deleter() = default;
+
+        /// @param pool The pool state
+        /// @param resource The owning pointer
+        deleter(impl* pool, value_ptr resource) :
+            m_pool(pool), m_resource(std::move(resource))
+        {
+            assert(m_pool);
+            assert(m_resource);
+        }
+
+        /// Call operator called by the pool_ptr when de-allocating the
+        /// object.
+        void operator()(value_type*)
+        {
+            assert(m_pool);
+            m_pool->release(std::move(m_resource));
+        }
+
+        // Pointer to the pool needed for recycling
+        impl* m_pool = nullptr;
+
+        // The resource object
+        value_ptr m_resource;
+    };
+
+private:
+    // The pool impl
+    impl* m_pool;
+};
+}
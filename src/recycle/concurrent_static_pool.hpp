@@ -0,0 +1,167 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+#include "atomic_bitmap.hpp"
+
+namespace recycle
+{
+/// @brief The concurrent_static_pool is a thread safe static_pool.
+///
+/// Like the static_pool, the pool stores its N values inline and never
+/// allocates on the heap. The free slots are tracked in an atomic_bitmap,
+/// so allocate() and releasing a resource each cost a single atomic
+/// read-modify-write in the common case. There is no mutex and no ABA
+/// problem.
+///
+/// The values are default constructed the first time their slot is
+/// used and are kept constructed while unused. Only the thread holding a
+/// slot touches its value, so the constructed flags need no atomics.
+/// When all N slots are in use, allocate() returns an empty pool_ptr.
+///
+/// The pool must outlive the resources it hands out, and it is neither
+/// copyable nor movable since the resources point into it.
+template <class Value, std::size_t N>
+class concurrent_static_pool
+{
+private:
+    /// Forward declare
+    struct deleter;
+
+public:
+    /// The type managed
+    using value_type = Value;
+
+    /// The pointer to the resource
+    using pool_ptr = std::unique_ptr<value_type, deleter>;
+
+    /// The number of slots
+    static constexpr std::size_t capacity = N;
+
+public:
+    /// Default constructor, all slots are free
+    concurrent_static_pool()
+    {
+        static_assert(std::is_default_constructible<Value>::value,
+                      "The value type must be default constructible");
+
+        for (std::size_t i = 0; i < N; ++i)
+        {
+            m_constructed[i] = false;
+        }
+    }
+
+    /// The pool is not copyable
+    concurrent_static_pool(const concurrent_static_pool&) = delete;
+
+    /// The pool is not copyable
+    concurrent_static_pool& operator=(const concurrent_static_pool&) =
+        delete;
+
+    /// Destructor, destroys the constructed values
+    ~concurrent_static_pool()
+    {
+        assert(m_slots.available() == N &&
+               "The pool must outlive its resources");
+
+        for (std::size_t i = 0; i < N; ++i)
+        {
+            if (m_constructed[i])
+            {
+                slot(i)->~value_type();
+            }
+        }
+    }
+
+    /// @return A resource from the pool or an empty pool_ptr if all
+    ///         slots are in use
+    pool_ptr allocate()
+    {
+        std::size_t index = m_slots.claim();
+
+        if (index == atomic_bitmap<N>::npos)
+        {
+            return pool_ptr();
+        }
+
+        if (!m_constructed[index])
+        {
+            new (slot(index)) value_type();
+            m_constructed[index] = true;
+        }
+
+        return pool_ptr(slot(index), deleter(this));
+    }
+
+    /// @returns the number of free slots. Only a snapshot if other
+    ///          threads use the pool concurrently.
+    std::size_t available() const
+    {
+        return m_slots.available();
+    }
+
+private:
+    /// Called by the deleter when a resource is released
+    void release(value_type* value)
+    {
+        std::size_t index = static_cast<std::size_t>(
+            reinterpret_cast<storage_type*>(value) - m_storage);
+
+        m_slots.release(index);
+    }
+
+    value_type* slot(std::size_t index)
+    {
+        assert(index < N);
+        return reinterpret_cast<value_type*>(&m_storage[index]);
+    }
+
+    /// The custom deleter object used by the std::unique_ptr<T>
+    struct deleter
+    {
+        /// Constructor
+        deleter() = default;
+
+        /// @param pool The pool the resource belongs to
+        deleter(concurrent_static_pool* pool) : m_pool(pool)
+        {
+            assert(m_pool);
+        }
+
+        /// Call operator called by std::unique_ptr<T> when
+        /// de-allocating the object.
+        void operator()(value_type* value)
+        {
+            assert(m_pool);
+            m_pool->release(value);
+        }
+
+        /// The pool the resource belongs to
+        concurrent_static_pool* m_pool = nullptr;
+    };
+
+private:
+    /// The storage of a single value
+    using storage_type =
+        typename std::aligned_storage<sizeof(Value), alignof(Value)>::type;
+
+    /// The values
+    storage_type m_storage[N];
+
+    /// True if the slot holds a constructed value, only accessed by the
+    /// thread holding the slot
+    bool m_constructed[N];
+
+    /// The free slots
+    atomic_bitmap<N> m_slots;
+};
+}
@@ -0,0 +1,336 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+
+namespace recycle
+{
+/// @brief Observer policy tracking the demand for the resources of a pool.
+///
+/// Instead of freeing unused resources on a fixed schedule, the tracker
+/// learns how many resources the pool actually needs. It counts the
+/// resources in use (allocated and not yet released) and the misses, and
+/// every call to tick() closes a window and updates two exponentially
+/// weighted moving averages (EWMA):
+///
+///   - The peak number of resources in use during a window.
+///   - The miss rate, i.e. the fraction of allocations which had to
+///     create a new resource.
+///
+/// From these the tracker recommends how many unused resources to retain:
+/// enough to bring the resources in use up to the smoothed peak. It also
+/// tells whether demand has been low for a number of windows in a row,
+/// in which case the pool should shrink, or whether misses have been
+/// frequent for a number of windows in a row, in which case the pool
+/// should be prewarmed. The adapt() function applies this to a pool.
+///
+/// Example:
+///
+///     using pool_type = recycle::unique_pool<
+///         heavy_object, lock_policy, recycle::demand_tracker>;
+///     pool_type pool;
+///
+///     // Called periodically, e.g. every second, the window length
+///     recycle::adapt(pool);
+///
+/// The event functions are thread safe and lock-free. tick() may be
+/// called from any thread.
+class demand_tracker
+{
+public:
+    /// What adapt() did to the pool
+    enum class action
+    {
+        /// Nothing, demand is stable
+        none,
+
+        /// Freed unused resources after sustained low demand
+        shrink,
+
+        /// Created unused resources after sustained misses
+        prewarm
+    };
+
+public:
+    /// Default constructor
+    demand_tracker() = default;
+
+    /// Copy constructor, copies only the configuration. The copy belongs
+    /// to a new pool, which has no resources in use and has learned
+    /// nothing yet.
+    demand_tracker(const demand_tracker& other)
+    {
+        std::lock_guard<std::mutex> other_lock(other.m_mutex);
+
+        m_alpha = other.m_alpha;
+        m_miss_threshold = other.m_miss_threshold;
+        m_sustain = other.m_sustain;
+    }
+
+    /// Copy assignment, copies only the configuration and starts over
+    demand_tracker& operator=(const demand_tracker& other)
+    {
+        if (this == &other)
+        {
+            return *this;
+        }
+
+        std::lock(m_mutex, other.m_mutex);
+        std::lock_guard<std::mutex> lock(m_mutex, std::adopt_lock);
+        std::lock_guard<std::mutex> other_lock(other.m_mutex,
+                                               std::adopt_lock);
+
+        m_in_use.store(0);
+        m_window_peak.store(0);
+        m_allocations.store(0);
+        m_misses.store(0);
+        m_alpha = other.m_alpha;
+        m_miss_threshold = other.m_miss_threshold;
+        m_sustain = other.m_sustain;
+        m_peak = 0.0;
+        m_miss_rate = 0.0;
+        m_low_windows = 0;
+        m_miss_windows = 0;
+        m_windows = 0;
+        return *this;
+    }
+
+    /// Set the weight of the latest window in the moving averages
+    /// @param alpha The weight in the range (0, 1], by default 0.25
+    void set_alpha(double alpha)
+    {
+        assert(alpha > 0.0 && alpha <= 1.0);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_alpha = alpha;
+    }
+
+    /// Set the miss rate above which a window counts as missing
+    /// @param threshold The miss rate in the range [0, 1], by default 0.05
+    void set_miss_threshold(double threshold)
+    {
+        assert(threshold >= 0.0 && threshold <= 1.0);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_miss_threshold = threshold;
+    }
+
+    /// Set the number of windows in a row needed before shrinking or
+    /// prewarming
+    /// @param windows The number of windows, by default 3
+    void set_sustain(uint32_t windows)
+    {
+        assert(windows > 0);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_sustain = windows;
+    }
+
+    /// Seed the moving average of the peak, e.g. from the sizing_profile
+    /// saved by a previous run. The next window is averaged with the seed
+    /// instead of replacing it.
+    /// @param peak The peak number of resources in use
+    void set_peak(double peak)
+    {
+        assert(peak >= 0.0);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_peak = peak;
+        m_windows = std::max<uint64_t>(m_windows, 1);
+    }
+
+    /// Closes the current window and updates the moving averages
+    void tick()
+    {
+        uint64_t in_use = m_in_use.load(std::memory_order_relaxed);
+
+        // The next window starts with the resources currently in use
+        uint64_t peak = m_window_peak.exchange(in_use);
+        uint64_t allocations = m_allocations.exchange(0);
+        uint64_t misses = m_misses.exchange(0);
+
+        double miss_rate =
+            allocations == 0 ? 0.0
+                             : static_cast<double>(misses) /
+                                   static_cast<double>(allocations);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (m_windows == 0)
+        {
+            m_peak = static_cast<double>(peak);
+            m_miss_rate = miss_rate;
+        }
+        else
+        {
+            // Demand is low if the window stayed below the average
+            bool low = static_cast<double>(peak) < m_peak;
+            m_low_windows = low ? m_low_windows + 1 : 0;
+
+            m_peak = m_alpha * static_cast<double>(peak) +
+                     (1.0 - m_alpha) * m_peak;
+            m_miss_rate = m_alpha * miss_rate + (1.0 - m_alpha) * m_miss_rate;
+        }
+
+        m_miss_windows = miss_rate > m_miss_threshold ? m_miss_windows + 1 : 0;
+        ++m_windows;
+    }
+
+    /// @return The number of resources currently in use
+    uint64_t in_use() const
+    {
+        return m_in_use.load(std::memory_order_relaxed);
+    }
+
+    /// @return The moving average of the peak number of resources in use
+    double peak() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_peak;
+    }
+
+    /// @return The moving average of the miss rate
+    double miss_rate() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_miss_rate;
+    }
+
+    /// @return The number of unused resources the pool should retain,
+    ///         enough to serve the average peak demand
+    std::size_t recommended_unused() const
+    {
+        double peak = this->peak();
+        double in_use = static_cast<double>(this->in_use());
+        double wanted = std::round(peak) - in_use;
+
+        return wanted > 0.0 ? static_cast<std::size_t>(wanted) : 0;
+    }
+
+    /// @return True if demand has been low for the sustain number of
+    ///         windows in a row
+    bool should_shrink() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_low_windows >= m_sustain;
+    }
+
+    /// @return True if the miss rate has been above the threshold for the
+    ///         sustain number of windows in a row
+    bool should_prewarm() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_miss_windows >= m_sustain;
+    }
+
+    /// Called when a resource has been handed out by the pool
+    void on_allocate(const void*, std::size_t)
+    {
+        m_allocations.fetch_add(1, std::memory_order_relaxed);
+        uint64_t in_use =
+            m_in_use.fetch_add(1, std::memory_order_relaxed) + 1;
+
+        uint64_t peak = m_window_peak.load(std::memory_order_relaxed);
+        while (in_use > peak && !m_window_peak.compare_exchange_weak(
+                                    peak, in_use, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    /// Called before the allocate function is invoked on a miss
+    void on_miss(const void*)
+    {
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /// Called when a resource has been released back to the pool
+    void on_recycle(const void*, std::size_t)
+    {
+        m_in_use.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    /// Called when unused resources have been freed
+    void on_free_unused(const void*, std::size_t)
+    {
+    }
+
+private:
+    /// The number of resources in use
+    std::atomic<uint64_t> m_in_use{0};
+
+    /// The peak number of resources in use in the current window
+    std::atomic<uint64_t> m_window_peak{0};
+
+    /// The number of allocations in the current window
+    std::atomic<uint64_t> m_allocations{0};
+
+    /// The number of misses in the current window
+    std::atomic<uint64_t> m_misses{0};
+
+    /// The weight of the latest window in the moving averages
+    double m_alpha = 0.25;
+
+    /// The miss rate above which a window counts as missing
+    double m_miss_threshold = 0.05;
+
+    /// The number of windows in a row needed to shrink or prewarm
+    uint32_t m_sustain = 3;
+
+    /// The moving average of the peak resources in use
+    double m_peak = 0.0;
+
+    /// The moving average of the miss rate
+    double m_miss_rate = 0.0;
+
+    /// The number of low demand windows in a row
+    uint32_t m_low_windows = 0;
+
+    /// The number of missing windows in a row
+    uint32_t m_miss_windows = 0;
+
+    /// The number of windows closed
+    uint64_t m_windows = 0;
+
+    /// Mutex protecting the moving averages
+    mutable std::mutex m_mutex;
+};
+
+/// Closes a window of the pool's demand_tracker and adapts the number of
+/// unused resources of the pool to the demand. After sustained misses
+/// the pool is prewarmed, after sustained low demand it is shrunk, in
+/// both cases to the number of unused resources recommended by the
+/// tracker.
+/// @param pool A pool using the demand_tracker as observer
+/// @return What was done to the pool
+template <class Pool>
+demand_tracker::action adapt(Pool& pool)
+{
+    demand_tracker& tracker = pool.observer();
+    tracker.tick();
+
+    std::size_t unused = tracker.recommended_unused();
+
+    if (tracker.should_prewarm())
+    {
+        pool.prewarm(unused);
+        return demand_tracker::action::prewarm;
+    }
+
+    if (tracker.should_shrink())
+    {
+        pool.shrink_to(unused);
+        return demand_tracker::action::shrink;
+    }
+
+    return demand_tracker::action::none;
+}
+}
@@ -0,0 +1,381 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <sys/uio.h>
+
+#include "no_locking_policy.hpp"
+#include "unique_pool.hpp"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <cerrno>
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define RECYCLE_HAS_IO_URING 1
+#endif
+#endif
+
+#if !defined(RECYCLE_HAS_IO_URING)
+#define RECYCLE_HAS_IO_URING 0
+#endif
+
+namespace recycle
+{
+/// @brief The fixed_buffer_pool is a pool of byte buffers carved out of a
+///        single block of memory which can be registered with io_uring.
+///
+/// Registering buffers with io_uring (IORING_REGISTER_BUFFERS) pins their
+/// pages once, so that reads and writes using IORING_OP_READ_FIXED and
+/// IORING_OP_WRITE_FIXED avoid the per-I/O page pinning and mapping.
+/// Such operations refer to a buffer by its index in the registered
+/// array, which the buffers of this pool expose with index().
+///
+/// The pool is built on top of the unique_pool, so buffers are handed out
+/// as pool_ptr's and are returned to the pool when they go out of scope.
+/// All registered buffers are created up front. If more buffers are
+/// allocated than were registered, the pool falls back to heap allocated
+/// buffers for which index() returns buffer::unregistered. These must be
+/// used with the normal read and write operations. Heap allocated
+/// buffers are destroyed when released instead of being kept in the
+/// pool, so allocate() hands out a registered buffer whenever one is
+/// free.
+///
+/// The memory of the buffers is page aligned and each buffer starts on
+/// a page boundary.
+///
+/// Example:
+///
+///     recycle::fixed_buffer_pool<> pool(64 * 1024, 128);
+///
+///     // io_uring_register_buffers(&ring, pool.iovecs().data(),
+///     //                           pool.iovecs().size());
+///     pool.register_buffers(ring_fd);
+///
+///     auto buffer = pool.allocate();
+///     // io_uring_prep_read_fixed(sqe, fd, buffer->data(), buffer->size(),
+///     //                          offset, buffer->index());
+///
+template <class LockingPolicy = no_locking_policy>
+class fixed_buffer_pool
+{
+private:
+    /// Forward declare
+    struct arena;
+
+public:
+    /// A buffer handed out by the pool
+    class buffer
+    {
+    public:
+        /// The index of a buffer which is not registered
+        static constexpr int unregistered = -1;
+
+        /// Create a registered buffer in the arena
+        /// @param arena The arena owning the memory
+        /// @param index The index of the buffer in the arena
+        buffer(std::shared_ptr<arena> arena, int index) :
+            m_arena(std::move(arena)), m_index(index)
+        {
+            assert(m_arena);
+            m_data = m_arena->data(m_index);
+            m_size = m_arena->buffer_size();
+        }
+
+        /// Create an unregistered buffer on the heap
+        /// @param size The size of the buffer in bytes
+        buffer(std::size_t size) :
+            m_storage(new uint8_t[size]), m_data(m_storage.get()),
+            m_size(size), m_index(unregistered)
+        {
+        }
+
+        /// The buffer is not copyable
+        buffer(const buffer&) = delete;
+
+        /// The buffer is not copyable
+        buffer& operator=(const buffer&) = delete;
+
+        /// Destructor, gives the index back to the arena
+        ~buffer()
+        {
+            if (m_arena)
+            {
+                m_arena->release(m_index);
+            }
+        }
+
+        /// @return The memory of the buffer
+        uint8_t* data() const
+        {
+            return m_data;
+        }
+
+        /// @return The size of the buffer in bytes
+        std::size_t size() const
+        {
+            return m_size;
+        }
+
+        /// @return The index of the buffer in the registered buffers or
+        ///         unregistered
+        int index() const
+        {
+            return m_index;
+        }
+
+        /// @return True if the buffer is part of the registered buffers
+        bool is_registered() const
+        {
+            return m_index != unregistered;
+        }
+
+    private:
+        /// The arena for registered buffers
+        std::shared_ptr<arena> m_arena;
+
+        /// The memory of an unregistered buffer
+        std::unique_ptr<uint8_t[]> m_storage;
+
+        /// The memory of the buffer
+        uint8_t* m_data = nullptr;
+
+        /// The size of the buffer
+        std::size_t m_size = 0;
+
+        /// The index of the buffer
+        int m_index = unregistered;
+    };
+
+    /// The underlying pool type
+    using pool_type = unique_pool<buffer, LockingPolicy>;
+
+    /// The pointer to a buffer
+    using pool_ptr = typename pool_type::pool_ptr;
+
+    /// The alignment of the buffers
+    static constexpr std::size_t alignment = 4096;
+
+public:
+    /// Create a pool of registrable buffers
+    /// @param buffer_size The size of each buffer in bytes
+    /// @param buffers The number of registrable buffers
+    fixed_buffer_pool(std::size_t buffer_size, std::size_t buffers) :
+        m_arena(std::make_shared<arena>(buffer_size, buffers)),
+        m_pool(make_allocate(m_arena), drop_unregistered)
+    {
+        // Create all registered buffers up front, so the first
+        // allocations do not miss
+        std::vector<pool_ptr> all;
+        for (std::size_t i = 0; i < buffers; ++i)
+        {
+            all.push_back(m_pool.allocate());
+        }
+    }
+
+    /// The pool is not copyable, since the registered buffers only
+    /// exist once
+    fixed_buffer_pool(const fixed_buffer_pool&) = delete;
+
+    /// The pool is not copyable
+    fixed_buffer_pool& operator=(const fixed_buffer_pool&) = delete;
+
+    /// @return A buffer from the pool
+    pool_ptr allocate()
+    {
+        return m_pool.allocate();
+    }
+
+    /// @returns the number of unused buffers
+    std::size_t unused_resources() const
+    {
+        return m_pool.unused_resources();
+    }
+
+    /// Frees all unused buffers. The memory of registered buffers is
+    /// kept, they are created again when needed.
+    void free_unused()
+    {
+        m_pool.free_unused();
+    }
+
+    /// @return The size of each buffer in bytes
+    std::size_t buffer_size() const
+    {
+        return m_arena->buffer_size();
+    }
+
+    /// @return The number of registrable buffers
+    std::size_t buffers() const
+    {
+        return m_arena->iovecs().size();
+    }
+
+    /// @return The iovec array describing the registrable buffers, as
+    ///         expected by io_uring_register_buffers()
+    const std::vector<iovec>& iovecs() const
+    {
+        return m_arena->iovecs();
+    }
+
+#if RECYCLE_HAS_IO_URING
+    /// Registers the buffers with an io_uring instance
+    /// @param ring_fd The file descriptor of the io_uring instance
+    /// @return 0 on success, otherwise -errno
+    int register_buffers(int ring_fd) const
+    {
+        const auto& iov = iovecs();
+        long result =
+            ::syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS,
+                      iov.data(), static_cast<unsigned>(iov.size()));
+
+        return result < 0 ? -errno : 0;
+    }
+
+    /// Unregisters the buffers from an io_uring instance
+    /// @param ring_fd The file descriptor of the io_uring instance
+    /// @return 0 on success, otherwise -errno
+    int unregister_buffers(int ring_fd) const
+    {
+        long result = ::syscall(__NR_io_uring_register, ring_fd,
+                                IORING_UNREGISTER_BUFFERS, nullptr, 0);
+
+        return result < 0 ? -errno : 0;
+    }
+#endif
+
+private:
+    /// The block of memory holding the registrable buffers
+    struct arena
+    {
+        arena(std::size_t buffer_size, std::size_t buffers) :
+            m_buffer_size(buffer_size)
+        {
+            assert(buffer_size > 0);
+
+            std::size_t stride =
+                (buffer_size + alignment - 1) / alignment * alignment;
+
+            m_memory = ::operator new(stride * buffers + alignment);
+
+            uintptr_t address = reinterpret_cast<uintptr_t>(m_memory);
+            address = (address + alignment - 1) / alignment * alignment;
+            uint8_t* base = reinterpret_cast<uint8_t*>(address);
+
+            for (std::size_t i = 0; i < buffers; ++i)
+            {
+                m_iovecs.push_back({base + i * stride, buffer_size});
+            }
+
+            // Hand out the lowest indices first
+            for (std::size_t i = buffers; i > 0; --i)
+            {
+                m_free.push_back(static_cast<int>(i - 1));
+            }
+        }
+
+        ~arena()
+        {
+            ::operator delete(m_memory);
+        }
+
+        /// @return The index of a buffer not in use or
+        ///         buffer::unregistered
+        int take()
+        {
+            typename pool_type::lock_type lock(m_mutex);
+
+            if (m_free.empty())
+            {
+                return buffer::unregistered;
+            }
+
+            int index = m_free.back();
+            m_free.pop_back();
+            return index;
+        }
+
+        /// Gives the index of a destroyed buffer back
+        void release(int index)
+        {
+            typename pool_type::lock_type lock(m_mutex);
+            m_free.push_back(index);
+        }
+
+        uint8_t* data(int index) const
+        {
+            return static_cast<uint8_t*>(m_iovecs[index].iov_base);
+        }
+
+        std::size_t buffer_size() const
+        {
+            return m_buffer_size;
+        }
+
+        const std::vector<iovec>& iovecs() const
+        {
+            return m_iovecs;
+        }
+
+    private:
+        /// The allocated memory
+        void* m_memory = nullptr;
+
+        /// The size of each buffer
+        std::size_t m_buffer_size;
+
+        /// The registrable buffers
+        std::vector<iovec> m_iovecs;
+
+        /// The indices of the buffers not in use
+        std::vector<int> m_free;
+
+        /// Mutex protecting the free indices
+        typename pool_type::mutex_type m_mutex;
+    };
+
+    static typename pool_type::allocate_function
+    make_allocate(std::shared_ptr<arena> arena)
+    {
+        return [arena]()
+        {
+            int index = arena->take();
+
+            if (index == buffer::unregistered)
+            {
+                return std::make_unique<buffer>(arena->buffer_size());
+            }
+
+            return std::make_unique<buffer>(arena, index);
+        };
+    }
+
+    /// Destroys heap allocated buffers instead of keeping them in the
+    /// pool
+    static void drop_unregistered(typename pool_type::value_ptr& resource)
+    {
+        if (!resource->is_registered())
+        {
+            resource.reset();
+        }
+    }
+
+private:
+    /// The memory of the registrable buffers
+    std::shared_ptr<arena> m_arena;
+
+    /// The pool of buffers
+    pool_type m_pool;
+};
+}
@@ -0,0 +1,201 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace recycle
+{
+/// @brief The frame_pool hands out values which are all released
+///        together.
+///
+/// Many workloads allocate a number of temporary objects for a request or
+/// a generation and drop all of them at the end. The frame_pool hands out
+/// plain pointers without any per-value release bookkeeping: no deleter,
+/// no reference counting and no lock. Calling reset() ends the frame and
+/// returns all values to the pool in O(1), by rewinding to the first value
+/// and bumping the epoch.
+///
+/// Example:
+///
+///     recycle::frame_pool<symbol> pool;
+///
+///     for (auto& generation : generations)
+///     {
+///         for (...)
+///         {
+///             symbol* s = pool.allocate();
+///             ...
+///         }
+///
+///         pool.reset();
+///     }
+///
+/// The values live in chunks of contiguous memory. They are default
+/// constructed the first time they are handed out and kept constructed
+/// afterwards, so a value is handed out in the next frame as it was left
+/// in the previous one. Pointers handed out in an earlier epoch must not
+/// be used after reset(), the epoch() can be used to check this.
+///
+/// The values are destroyed by free_unused() or when the pool is
+/// destroyed. The pool is not thread safe and not copyable, typically
+/// one pool is used per request or per thread.
+template <class Value>
+class frame_pool
+{
+public:
+    /// The type managed
+    using value_type = Value;
+
+    /// The default number of values in a chunk
+    static constexpr std::size_t default_chunk_capacity = 64;
+
+public:
+    /// Create a frame_pool
+    /// @param chunk_capacity The number of values in each chunk
+    explicit frame_pool(std::size_t chunk_capacity = default_chunk_capacity) :
+        m_chunk_capacity(chunk_capacity)
+    {
+        static_assert(std::is_default_constructible<Value>::value,
+                      "The value type must be default constructible");
+        static_assert(alignof(value_type) <= alignof(std::max_align_t),
+                      "Over-aligned values are not supported");
+
+        assert(m_chunk_capacity > 0);
+    }
+
+    /// The pool is not copyable
+    frame_pool(const frame_pool&) = delete;
+
+    /// The pool is not copyable
+    frame_pool& operator=(const frame_pool&) = delete;
+
+    /// Destructor, destroys the values
+    ~frame_pool()
+    {
+        m_next = 0;
+        free_unused();
+    }
+
+    /// @return A value which stays valid until the next reset()
+    value_type* allocate()
+    {
+        if (m_next == m_constructed)
+        {
+            if (m_constructed == m_chunks.size() * m_chunk_capacity)
+            {
+                add_chunk();
+            }
+
+            new (slot(m_constructed)) value_type();
+            ++m_constructed;
+        }
+
+        return slot(m_next++);
+    }
+
+    /// Ends the frame, all values handed out are unused again. Values
+    /// are neither destroyed nor reset.
+    void reset()
+    {
+        m_next = 0;
+        ++m_epoch;
+    }
+
+    /// @return The number of times reset() has been called
+    uint64_t epoch() const
+    {
+        return m_epoch;
+    }
+
+    /// @return The number of values handed out in the current frame
+    std::size_t in_use() const
+    {
+        return m_next;
+    }
+
+    /// @returns the number of unused resources, i.e. constructed values
+    ///          not handed out in the current frame
+    std::size_t unused_resources() const
+    {
+        return m_constructed - m_next;
+    }
+
+    /// @returns the number of chunks allocated
+    std::size_t chunks() const
+    {
+        return m_chunks.size();
+    }
+
+    /// @returns the number of values in each chunk
+    std::size_t chunk_capacity() const
+    {
+        return m_chunk_capacity;
+    }
+
+    /// Destroys the unused values and deallocates the chunks which are
+    /// no longer needed for the values in use
+    void free_unused()
+    {
+        while (m_constructed > m_next)
+        {
+            --m_constructed;
+            slot(m_constructed)->~value_type();
+        }
+
+        std::size_t needed =
+            (m_next + m_chunk_capacity - 1) / m_chunk_capacity;
+
+        while (m_chunks.size() > needed)
+        {
+            ::operator delete(static_cast<void*>(m_chunks.back()));
+            m_chunks.pop_back();
+        }
+    }
+
+private:
+    void add_chunk()
+    {
+        void* memory = ::operator new(m_chunk_capacity * sizeof(value_type));
+
+        try
+        {
+            m_chunks.push_back(static_cast<value_type*>(memory));
+        }
+        catch (...)
+        {
+            ::operator delete(memory);
+            throw;
+        }
+    }
+
+    value_type* slot(std::size_t index)
+    {
+        return m_chunks[index / m_chunk_capacity] + index % m_chunk_capacity;
+    }
+
+private:
+    /// The number of values in each chunk
+    std::size_t m_chunk_capacity;
+
+    /// The chunks holding the values
+    std::vector<value_type*> m_chunks;
+
+    /// The number of values constructed, they come first
+    std::size_t m_constructed = 0;
+
+    /// The index of the next value to hand out
+    std::size_t m_next = 0;
+
+    /// The number of frames ended
+    uint64_t m_epoch = 0;
+};
+}
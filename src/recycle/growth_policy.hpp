@@ -0,0 +1,63 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+
+namespace recycle
+{
+/// @brief Decides how many resources the shared_pool and unique_pool
+///        create when they miss.
+///
+/// The first miss creates m_initial_batch resources, and every following
+/// miss creates m_factor times as many as the previous one, up to
+/// m_max_batch. One of the resources is handed out and the rest go to
+/// the free list. Freeing unused resources starts over from the initial
+/// batch.
+///
+/// The default creates a single resource on every miss. To create 16
+/// resources on the first miss and double the batch up to 256:
+///
+///     recycle::growth_policy growth;
+///     growth.m_initial_batch = 16;
+///     growth.m_factor = 2.0;
+///     growth.m_max_batch = 256;
+///
+///     pool.set_growth_policy(growth);
+///
+struct growth_policy
+{
+    /// The number of resources created on the first miss
+    std::size_t m_initial_batch = 1;
+
+    /// The factor by which the batch grows on every miss
+    double m_factor = 1.0;
+
+    /// The maximum number of resources created on a miss
+    std::size_t m_max_batch = 1;
+
+    /// @param batch The number of resources created on the previous miss
+    /// @return The number of resources to create on the next miss
+    std::size_t grow(std::size_t batch) const
+    {
+        assert(m_initial_batch > 0);
+        assert(m_factor >= 1.0);
+
+        double next = std::ceil(static_cast<double>(batch) * m_factor);
+        std::size_t limit = std::max(m_initial_batch, m_max_batch);
+
+        if (next >= static_cast<double>(limit))
+        {
+            return limit;
+        }
+
+        return std::max(static_cast<std::size_t>(next), m_initial_batch);
+    }
+};
+}
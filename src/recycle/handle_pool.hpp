@@ -0,0 +1,395 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "no_locking_policy.hpp"
+
+namespace recycle
+{
+/// @brief The handle_pool stores values in contiguous pages and hands out
+///        compact handles to them.
+///
+/// Where the unique_pool and shared_pool hand out smart pointers, the
+/// handle_pool hands out 8 byte handles made of a 32 bit slot index and a
+/// 32 bit generation. The value is looked up with get() in O(1) and the
+/// handle has to be released explicitly with release().
+///
+/// Every time a slot is released its generation is incremented, so a
+/// handle which has been released (or a copy of it) is detected as
+/// stale: get() returns nullptr and release() returns false.
+///
+/// The values are kept constructed in their slot when released, i.e.
+/// they are recycled exactly like in the other pools, until
+/// free_unused() is called.
+///
+/// Since handles refer to slots in the pool, the pool is neither
+/// copyable nor movable. When the pool is destroyed all values are
+/// destroyed, including those of outstanding handles.
+///
+/// Note, when using the handle pool in a multithreaded environment you
+/// should use a locking policy. The pointer returned by get() stays
+/// valid until the handle is released.
+template <class Value, class LockingPolicy = no_locking_policy>
+class handle_pool
+{
+public:
+    /// The type managed
+    using value_type = Value;
+
+    /// The allocate function type
+    /// Should take no arguments and return a Value which is moved into
+    /// its slot in the pool
+    using allocate_function = std::function<value_type()>;
+
+    /// The recycle function type
+    /// If specified the recycle function will be called every time a
+    /// resource gets released into the pool.
+    using recycle_function = std::function<void(value_type&)>;
+
+    /// The locking policy mutex type
+    using mutex_type = typename LockingPolicy::mutex_type;
+
+    /// The locking policy lock type
+    using lock_type = typename LockingPolicy::lock_type;
+
+    /// The number of slots in a page
+    static constexpr uint32_t page_size = 256;
+
+    /// The handle referring to a value in the pool. A default
+    /// constructed handle never refers to a value.
+    struct handle
+    {
+        /// The index of the slot
+        uint32_t m_index = 0;
+
+        /// The generation of the slot when the handle was handed out
+        uint32_t m_generation = 0;
+
+        /// @return True if the handles refer to the same slot generation
+        friend bool operator==(const handle& a, const handle& b)
+        {
+            return a.m_index == b.m_index && a.m_generation == b.m_generation;
+        }
+
+        /// @return True if the handles differ
+        friend bool operator!=(const handle& a, const handle& b)
+        {
+            return !(a == b);
+        }
+    };
+
+    static_assert(sizeof(handle) == 8, "The handle should be 8 bytes");
+
+public:
+    /// Default constructor, only available if the value_type is default
+    /// constructible.
+    template <class T = Value,
+              typename std::enable_if<std::is_default_constructible<T>::value,
+                                      uint8_t>::type = 0>
+    handle_pool() : m_allocate([]() { return value_type(); })
+    {
+    }
+
+    /// Create a handle pool using a specific allocate function.
+    /// @param allocate Allocation function
+    handle_pool(allocate_function allocate) : m_allocate(std::move(allocate))
+    {
+        assert(m_allocate);
+    }
+
+    /// Create a handle pool using a specific allocate function and
+    /// recycle function.
+    /// @param allocate Allocation function
+    /// @param recycle Recycle function. If used in a threaded environment
+    ///        the recycle function should be thread safe.
+    handle_pool(allocate_function allocate, recycle_function recycle) :
+        m_allocate(std::move(allocate)), m_recycle(std::move(recycle))
+    {
+        assert(m_allocate);
+        assert(m_recycle);
+    }
+
+    /// The handle pool is not copyable
+    handle_pool(const handle_pool&) = delete;
+
+    /// The handle pool is not copyable
+    handle_pool& operator=(const handle_pool&) = delete;
+
+    /// Destructor
+    ~handle_pool()
+    {
+        for (uint32_t i = 0; i < m_size; ++i)
+        {
+            slot& s = slot_at(i);
+
+            if (s.m_constructed)
+            {
+                s.value()->~value_type();
+            }
+        }
+    }
+
+    /// @return A handle to a value from the pool
+    handle allocate()
+    {
+        uint32_t index = invalid_index;
+        slot* s = nullptr;
+
+        {
+            lock_type lock(m_mutex);
+
+            index = m_free_head;
+
+            if (index != invalid_index)
+            {
+                m_free_head = slot_at(index).m_next_free;
+                --m_unused;
+            }
+            else
+            {
+                index = grow();
+            }
+
+            s = &slot_at(index);
+
+            if (s->m_constructed)
+            {
+                s->m_in_use = true;
+                return handle{index, s->m_generation};
+            }
+        }
+
+        // The slot is neither in the free list nor in use, so nobody else
+        // touches it while we construct the value without holding the lock
+        assert(m_allocate);
+
+        try
+        {
+            new (&s->m_storage) value_type(m_allocate());
+        }
+        catch (...)
+        {
+            // Put the slot back in the free list, so it is not lost
+            lock_type lock(m_mutex);
+            s->m_next_free = m_free_head;
+            m_free_head = index;
+            ++m_unused;
+            throw;
+        }
+
+        lock_type lock(m_mutex);
+        s->m_constructed = true;
+        s->m_in_use = true;
+        return handle{index, s->m_generation};
+    }
+
+    /// @param h The handle to look up
+    /// @return A pointer to the value or nullptr if the handle is stale
+    value_type* get(handle h)
+    {
+        lock_type lock(m_mutex);
+
+        if (!is_valid(h))
+        {
+            return nullptr;
+        }
+
+        return slot_at(h.m_index).value();
+    }
+
+    /// @param h The handle to check
+    /// @return True if the handle refers to a value which has not been
+    ///         released
+    bool valid(handle h) const
+    {
+        lock_type lock(m_mutex);
+        return is_valid(h);
+    }
+
+    /// Releases the value back into the pool, invalidating the handle
+    /// and all copies of it.
+    /// @param h The handle to release
+    /// @return False if the handle was stale, i.e. already released
+    bool release(handle h)
+    {
+        value_type* value = nullptr;
+
+        {
+            lock_type lock(m_mutex);
+
+            if (!is_valid(h))
+            {
+                return false;
+            }
+
+            slot& s = slot_at(h.m_index);
+            s.m_in_use = false;
+
+            // Generation zero is reserved for the default handle
+            if (++s.m_generation == 0)
+            {
+                s.m_generation = 1;
+            }
+
+            value = s.value();
+        }
+
+        // The slot is no longer reachable through a handle and not yet
+        // in the free list, so we can call the recycle function without
+        // holding the lock
+        if (m_recycle)
+        {
+            m_recycle(*value);
+        }
+
+        lock_type lock(m_mutex);
+
+        slot_at(h.m_index).m_next_free = m_free_head;
+        m_free_head = h.m_index;
+        ++m_unused;
+
+        return true;
+    }
+
+    /// @returns the number of unused resources
+    std::size_t unused_resources() const
+    {
+        lock_type lock(m_mutex);
+        return m_unused;
+    }
+
+    /// Destroys the values of all unused slots. The memory of the slots
+    /// is kept and reused by subsequent allocations.
+    void free_unused()
+    {
+        lock_type lock(m_mutex);
+
+        for (uint32_t i = m_free_head; i != invalid_index;)
+        {
+            slot& s = slot_at(i);
+
+            if (s.m_constructed)
+            {
+                s.value()->~value_type();
+                s.m_constructed = false;
+            }
+
+            i = s.m_next_free;
+        }
+    }
+
+    /// @return The mutex of the pool, e.g. to read the statistics of the
+    ///         instrumented_locking_policy
+    mutex_type& mutex()
+    {
+        return m_mutex;
+    }
+
+    /// @return The mutex of the pool, e.g. to read the statistics of the
+    ///         instrumented_locking_policy
+    const mutex_type& mutex() const
+    {
+        return m_mutex;
+    }
+
+private:
+    /// Marks the end of the free list
+    static constexpr uint32_t invalid_index =
+        std::numeric_limits<uint32_t>::max();
+
+    static_assert((page_size & (page_size - 1)) == 0,
+                  "The page size must be a power of two");
+
+    /// A slot in a page
+    struct slot
+    {
+        /// @return The value stored in the slot
+        value_type* value()
+        {
+            return reinterpret_cast<value_type*>(&m_storage);
+        }
+
+        /// The storage of the value
+        typename std::aligned_storage<sizeof(value_type),
+                                      alignof(value_type)>::type m_storage;
+
+        /// The current generation of the slot
+        uint32_t m_generation = 1;
+
+        /// The next slot in the free list
+        uint32_t m_next_free = invalid_index;
+
+        /// True if a value has been constructed in the storage
+        bool m_constructed = false;
+
+        /// True if the slot has been handed out
+        bool m_in_use = false;
+    };
+
+    slot& slot_at(uint32_t index) const
+    {
+        assert(index < m_size);
+        return m_pages[index / page_size][index % page_size];
+    }
+
+    bool is_valid(handle h) const
+    {
+        if (h.m_index >= m_size)
+        {
+            return false;
+        }
+
+        const slot& s = slot_at(h.m_index);
+        return s.m_in_use && s.m_generation == h.m_generation;
+    }
+
+    /// Takes the next never used slot, adding a page if needed
+    /// @return The index of the slot
+    uint32_t grow()
+    {
+        assert(m_size < invalid_index);
+
+        if (m_size % page_size == 0)
+        {
+            m_pages.emplace_back(new slot[page_size]);
+        }
+
+        return m_size++;
+    }
+
+private:
+    /// The allocator to use
+    allocate_function m_allocate;
+
+    /// The recycle function
+    recycle_function m_recycle;
+
+    /// The pages of slots
+    std::vector<std::unique_ptr<slot[]>> m_pages;
+
+    /// The number of slots taken into use
+    uint32_t m_size = 0;
+
+    /// The first slot in the free list
+    uint32_t m_free_head = invalid_index;
+
+    /// The number of slots in the free list
+    std::size_t m_unused = 0;
+
+    /// Mutex used to coordinate access to the pool
+    mutable mutex_type m_mutex;
+};
+}
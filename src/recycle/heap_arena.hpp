@@ -0,0 +1,43 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+namespace recycle
+{
+/// Defines the default arena of the recycle::slab_pool, allocating the
+/// slabs on the heap.
+///
+/// An arena provides the memory of the slabs. A valid arena defines the
+/// following two functions, which the slab_pool calls while holding its
+/// lock:
+///
+///     // Returns memory for a slab of the given size, aligned for any
+///     // value. Throws on failure.
+///     void* allocate(std::size_t bytes);
+///
+///     // Gives back the memory of a slab which is no longer in use
+///     void deallocate(void* memory, std::size_t bytes);
+///
+/// See mmap_arena for an arena reserving its memory with mmap.
+struct heap_arena
+{
+    /// @param bytes The size of the slab
+    /// @return The memory of the slab
+    void* allocate(std::size_t bytes)
+    {
+        return ::operator new(bytes);
+    }
+
+    /// @param memory The memory of the slab
+    void deallocate(void* memory, std::size_t)
+    {
+        ::operator delete(memory);
+    }
+};
+}
@@ -0,0 +1,229 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace recycle
+{
+/// Locking policy wrapping another locking policy and recording how
+/// contended the lock is.
+///
+/// For every acquisition of the lock the policy records:
+///
+///   - That the lock was acquired.
+///   - Whether the lock was contended, i.e. held by another thread when
+///     we tried to acquire it.
+///   - For contended acquisitions, the time spent waiting for the lock,
+///     both in total and in a histogram with power of two buckets.
+///
+/// Contention is detected with a flag set while the lock is held, so a
+/// thread acquiring the lock in the very moment it is released may be
+/// counted as contended or not. Uncontended acquisitions are not timed
+/// and are counted as waiting 0 nanoseconds.
+///
+/// The statistics are kept in the mutex, i.e. per pool, and are read
+/// through the mutex() of the pool:
+///
+///     using policy = recycle::instrumented_locking_policy<
+///         recycle::mutex_locking_policy>;
+///
+///     recycle::unique_pool<packet, policy> pool;
+///     ...
+///     auto stats = pool.mutex().statistics();
+///
+template <class Inner>
+struct instrumented_locking_policy
+{
+    /// The number of buckets in the wait time histogram. Bucket i counts
+    /// waits of [2^i, 2^(i+1)) nanoseconds, bucket 0 also counts waits
+    /// below one nanosecond and the last bucket all longer waits.
+    static constexpr std::size_t buckets = 32;
+
+    /// A snapshot of the recorded statistics
+    struct statistics_type
+    {
+        /// The number of times the lock was acquired
+        uint64_t m_acquisitions = 0;
+
+        /// The number of times the lock was held by another thread
+        uint64_t m_contended = 0;
+
+        /// The total time spent waiting for the lock
+        uint64_t m_wait_ns = 0;
+
+        /// The histogram of the time spent waiting for the lock
+        std::array<uint64_t, buckets> m_wait_histogram{};
+    };
+
+    /// Forward declare
+    class lock_type;
+
+    /// The mutex wrapping the inner mutex
+    class mutex_type
+    {
+    public:
+        /// Creates the mutex in unlocked state
+        mutex_type() = default;
+
+        /// The mutex is not copyable
+        mutex_type(const mutex_type&) = delete;
+
+        /// The mutex is not copyable
+        mutex_type& operator=(const mutex_type&) = delete;
+
+        /// @return A snapshot of the statistics recorded for this mutex
+        statistics_type statistics() const
+        {
+            statistics_type result;
+            result.m_acquisitions =
+                m_acquisitions.load(std::memory_order_relaxed);
+            result.m_contended = m_contended.load(std::memory_order_relaxed);
+            result.m_wait_ns = m_wait_ns.load(std::memory_order_relaxed);
+
+            for (std::size_t i = 0; i < buckets; ++i)
+            {
+                result.m_wait_histogram[i] =
+                    m_wait_histogram[i].load(std::memory_order_relaxed);
+            }
+
+            return result;
+        }
+
+        /// Resets the statistics recorded for this mutex
+        void reset()
+        {
+            m_acquisitions.store(0, std::memory_order_relaxed);
+            m_contended.store(0, std::memory_order_relaxed);
+            m_wait_ns.store(0, std::memory_order_relaxed);
+
+            for (auto& count : m_wait_histogram)
+            {
+                count.store(0, std::memory_order_relaxed);
+            }
+        }
+
+    private:
+        friend class lock_type;
+
+        /// Called before acquiring the inner lock
+        /// @return The time we started waiting or a default constructed
+        ///         time point if the lock is not held
+        std::chrono::steady_clock::time_point before_lock() const
+        {
+            if (!m_held.load(std::memory_order_relaxed))
+            {
+                return {};
+            }
+
+            return std::chrono::steady_clock::now();
+        }
+
+        /// Called after acquiring the inner lock
+        void after_lock(std::chrono::steady_clock::time_point start)
+        {
+            m_held.store(true, std::memory_order_relaxed);
+            m_acquisitions.fetch_add(1, std::memory_order_relaxed);
+
+            uint64_t wait = 0;
+
+            if (start != std::chrono::steady_clock::time_point{})
+            {
+                auto stop = std::chrono::steady_clock::now();
+                wait = static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        stop - start)
+                        .count());
+
+                m_contended.fetch_add(1, std::memory_order_relaxed);
+                m_wait_ns.fetch_add(wait, std::memory_order_relaxed);
+            }
+
+            m_wait_histogram[bucket(wait)].fetch_add(
+                1, std::memory_order_relaxed);
+        }
+
+        /// Called before releasing the inner lock
+        void before_unlock()
+        {
+            m_held.store(false, std::memory_order_relaxed);
+        }
+
+    private:
+        /// The wrapped mutex
+        typename Inner::mutex_type m_inner;
+
+        /// True while the lock is held
+        std::atomic<bool> m_held{false};
+
+        /// The number of times the lock was acquired
+        std::atomic<uint64_t> m_acquisitions{0};
+
+        /// The number of times the lock was held by another thread
+        std::atomic<uint64_t> m_contended{0};
+
+        /// The total time spent waiting for the lock
+        std::atomic<uint64_t> m_wait_ns{0};
+
+        /// The histogram of the time spent waiting for the lock
+        std::array<std::atomic<uint64_t>, buckets> m_wait_histogram{};
+    };
+
+    /// The lock wrapping the inner lock
+    class lock_type
+    {
+    public:
+        /// Acquires the lock
+        /// @param mutex The mutex to lock
+        lock_type(mutex_type& mutex) :
+            m_mutex(mutex), m_start(mutex.before_lock()),
+            m_inner(mutex.m_inner)
+        {
+            m_mutex.after_lock(m_start);
+        }
+
+        /// The lock is not copyable
+        lock_type(const lock_type&) = delete;
+
+        /// The lock is not copyable
+        lock_type& operator=(const lock_type&) = delete;
+
+        /// Releases the lock, the inner lock is released after this
+        ~lock_type()
+        {
+            m_mutex.before_unlock();
+        }
+
+    private:
+        /// The locked mutex
+        mutex_type& m_mutex;
+
+        /// The time we started waiting
+        std::chrono::steady_clock::time_point m_start;
+
+        /// The wrapped lock
+        typename Inner::lock_type m_inner;
+    };
+
+private:
+    /// @return The histogram bucket of a wait time
+    static std::size_t bucket(uint64_t wait_ns)
+    {
+        std::size_t index = 0;
+
+        while (wait_ns > 1 && index < buckets - 1)
+        {
+            wait_ns >>= 1;
+            ++index;
+        }
+
+        return index;
+    }
+};
+}
@@ -0,0 +1,312 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace recycle
+{
+/// @brief The local_pool is a single-threaded unique_pool.
+///
+/// The local_pool works like the unique_pool, but is meant for pools
+/// which are only ever used from a single thread, e.g. in a
+/// thread-per-core design.
+///
+/// The unique_pool keeps its state in a std::shared_ptr and every
+/// pool_ptr carries a std::weak_ptr to it. Even with the
+/// no_locking_policy this means that every allocation and every release
+/// performs atomic read-modify-write operations on the reference counts.
+///
+/// The local_pool instead keeps a plain pointer to its state in the
+/// pool_ptr together with a plain (non-atomic) count of the outstanding
+/// resources. Releasing a resource therefore only costs a few ordinary
+/// loads and stores. If the pool dies before the resources it has handed
+/// out, the state is kept alive until the last resource is released.
+///
+/// The local_pool and all the resources allocated from it must only be
+/// used from a single thread.
+template <class Value>
+class local_pool
+{
+private:
+    /// Forward declare
+    struct deleter;
+    struct impl;
+
+public:
+    /// The type managed
+    using value_type = Value;
+
+    /// The pointer to the resource
+    using pool_ptr = std::unique_ptr<value_type, deleter>;
+
+    /// The owning pointer to the resource
+    using value_ptr = std::unique_ptr<value_type>;
+
+    /// The allocate function type
+    /// Should take no arguments and return an std::unique_ptr to the Value
+    using allocate_function = std::function<value_ptr()>;
+
+    /// The recycle function type
+    /// If specified the recycle function will be called every time a
+    /// resource gets recycled into the pool. This allows temporary
+    /// resources, e.g., file handles to be closed when an object is longer
+    /// used. If the recycle function resets the resource, it is destroyed
+    /// instead of being put back into the pool.
+    using recycle_function = std::function<void(value_ptr&)>;
+
+public:
+    /// Default constructor, only available if the value_type is default
+    /// constructible. See unique_pool::unique_pool() for details.
+    template <class T = Value,
+              typename std::enable_if<std::is_default_constructible<T>::value,
+                                      uint8_t>::type = 0>
+    local_pool() :
+        m_pool(new impl(allocate_function(std::make_unique<value_type>)))
+    {
+    }
+
+    /// Create a local_pool using a specific allocate function.
+    /// @param allocate Allocation function
+    local_pool(allocate_function allocate) :
+        m_pool(new impl(std::move(allocate)))
+    {
+    }
+
+    /// Create a local_pool using a specific allocate function and
+    /// recycle function.
+    /// @param allocate Allocation function
+    /// @param recycle Recycle function
+    local_pool(allocate_function allocate, recycle_function recycle) :
+        m_pool(new impl(std::move(allocate), std::move(recycle)))
+    {
+    }
+
+    /// Copy constructor
+    local_pool(const local_pool& other) : m_pool(new impl(*other.m_pool))
+    {
+    }
+
+    /// Move constructor
+    local_pool(local_pool&& other) : m_pool(other.m_pool)
+    {
+        assert(m_pool);
+        other.m_pool = nullptr;
+    }
+
+    /// Copy assignment
+    local_pool& operator=(const local_pool& other)
+    {
+        local_pool tmp(other);
+        std::swap(*this, tmp);
+        return *this;
+    }
+
+    /// Move assignment
+    local_pool& operator=(local_pool&& other)
+    {
+        std::swap(m_pool, other.m_pool);
+        return *this;
+    }
+
+    /// Destructor
+    ~local_pool()
+    {
+        if (m_pool)
+        {
+            m_pool->close();
+        }
+    }
+
+    /// @returns the number of unused resources
+    std::size_t unused_resources() const
+    {
+        assert(m_pool);
+        return m_pool->unused_resources();
+    }
+
+    /// Frees all unused resources
+    void free_unused()
+    {
+        assert(m_pool);
+        m_pool->free_unused();
+    }
+
+    /// @return A resource from the pool.
+    pool_ptr allocate()
+    {
+        assert(m_pool);
+        return m_pool->allocate();
+    }
+
+private:
+    /// The actual pool implementation. The impl is owned by the
+    /// local_pool together with all the resources currently handed out.
+    /// It is deleted when the pool has been closed and the last
+    /// outstanding resource has been released.
+    struct impl
+    {
+        /// @copydoc local_pool::local_pool(allocate_function)
+        impl(allocate_function allocate) : m_allocate(std::move(allocate))
+        {
+            assert(m_allocate);
+        }
+
+        /// @copydoc local_pool::local_pool(allocate_function,
+        ///                                 recycle_function)
+        impl(allocate_function allocate, recycle_function recycle) :
+            m_allocate(std::move(allocate)), m_recycle(std::move(recycle))
+        {
+            assert(m_allocate);
+            assert(m_recycle);
+        }
+
+        /// Copy constructor
+        impl(const impl& other) :
+            m_allocate(other.m_allocate), m_recycle(other.m_recycle)
+        {
+            std::size_t size = other.unused_resources();
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                m_free_list.push_back(m_allocate());
+            }
+        }
+
+        /// Allocate a new value from the pool
+        pool_ptr allocate()
+        {
+            value_ptr resource;
+
+            if (!m_free_list.empty())
+            {
+                resource = std::move(m_free_list.back());
+                m_free_list.pop_back();
+            }
+            else
+            {
+                assert(m_allocate);
+                resource = m_allocate();
+            }
+
+            ++m_outstanding;
+            return pool_ptr(resource.release(), deleter(this));
+        }
+
+        /// @copydoc local_pool::free_unused()
+        void free_unused()
+        {
+            m_free_list.clear();
+        }
+
+        /// @copydoc local_pool::unused_resources()
+        std::size_t unused_resources() const
+        {
+            return m_free_list.size();
+        }
+
+        /// This function called when a resource has been released by
+        /// its pool_ptr
+        void release(value_type* naked_ptr)
+        {
+            value_ptr resource(naked_ptr);
+
+            assert(m_outstanding > 0);
+            --m_outstanding;
+
+            if (m_open)
+            {
+                if (m_recycle)
+                {
+                    m_recycle(resource);
+                }
+
+                // If the recycle function dropped the resource there is
+                // nothing to keep
+                if (resource)
+                {
+                    m_free_list.push_back(std::move(resource));
+                }
+
+                return;
+            }
+
+            // The pool is gone, we destroy the resource and, if it was
+            // the last one, ourselves.
+            resource.reset();
+
+            if (m_outstanding == 0)
+            {
+                delete this;
+            }
+        }
+
+        /// Called when the owning local_pool is destroyed
+        void close()
+        {
+            assert(m_open);
+            m_open = false;
+            m_free_list.clear();
+
+            if (m_outstanding == 0)
+            {
+                delete this;
+            }
+        }
+
+    private:
+        /// The allocator to use
+        allocate_function m_allocate;
+
+        /// The recycle function
+        recycle_function m_recycle;
+
+        /// Stores all the free resources
+        std::vector<value_ptr> m_free_list;
+
+        /// The number of resources handed out and not yet released
+        std::size_t m_outstanding = 0;
+
+        /// True as long as the owning local_pool is alive
+        bool m_open = true;
+    };
+
+    /// The custom deleter object used by the std::unique_ptr<T>. It
+    /// only stores a plain pointer to the pool state, which is kept
+    /// alive as long as there are outstanding resources.
+    struct deleter
+    {
+        /// Constructor
+        deleter() = default;
+
+        /// @param pool The pool state
+        deleter(impl* pool) : m_pool(pool)
+        {
+            assert(m_pool);
+        }
+
+        /// Call operator called by std::unique_ptr<T> when
+        /// de-allocating the object.
+        void operator()(value_type* naked_ptr)
+        {
+            assert(m_pool);
+            m_pool->release(naked_ptr);
+        }
+
+        // Pointer to the pool needed for recycling
+        impl* m_pool = nullptr;
+    };
+
+private:
+    // The pool impl
+    impl* m_pool;
+};
+}
@@ -0,0 +1,359 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "pool_registry.hpp"
+
+namespace recycle
+{
+/// @brief Trims the pools of a pool_registry when the system runs low on
+///        memory.
+///
+/// The monitor watches one or both of the following Linux sources:
+///
+///   PSI:    The pressure stall information in /proc/pressure/memory.
+///           Pressure is signalled when the "some avg10" value, i.e. the
+///           percentage of time at least one task stalled on memory
+///           over the last 10 seconds, reaches the threshold.
+///
+///   cgroup: The cgroup v2 memory controller files of a cgroup
+///           directory. Pressure is signalled when memory.current
+///           reaches the given fraction of the limit, i.e. the smaller of
+///           memory.high and memory.max since the kernel starts
+///           throttling at memory.high, or when the "high" or "max"
+///           counters of memory.events have increased since the previous
+///           poll. Unlimited ("max") limits are ignored.
+///
+/// Every time pressure is detected the registered pools are trimmed,
+/// by default freeing all their unused resources.
+///
+/// The sources are plain files, so the monitor can be tested on any
+/// system by pointing it at files with fake content. Sources which
+/// cannot be read never signal pressure.
+///
+/// The monitor can either be polled, e.g. from an existing housekeeping
+/// task, or run its own background thread using start() and stop().
+class memory_pressure_monitor
+{
+public:
+    /// @param registry The registry whose pools are trimmed under pressure
+    memory_pressure_monitor(pool_registry& registry) : m_registry(registry)
+    {
+    }
+
+    /// The monitor is not copyable
+    memory_pressure_monitor(const memory_pressure_monitor&) = delete;
+
+    /// The monitor is not copyable
+    memory_pressure_monitor& operator=(const memory_pressure_monitor&) =
+        delete;
+
+    /// Destructor, stops the background thread if running
+    ~memory_pressure_monitor()
+    {
+        stop();
+    }
+
+    /// Watch the pressure stall information
+    /// @param path The PSI file to read
+    /// @param threshold The "some avg10" percentage signalling pressure
+    void watch_psi(std::string path = "/proc/pressure/memory",
+                   double threshold = 10.0)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_psi_path = std::move(path);
+        m_psi_threshold = threshold;
+    }
+
+    /// Watch a cgroup v2 memory controller
+    /// @param directory The cgroup directory containing memory.current,
+    ///        memory.max, memory.high and memory.events
+    /// @param threshold The fraction of the memory limit in use which
+    ///        signals pressure
+    void watch_cgroup(std::string directory = "/sys/fs/cgroup",
+                      double threshold = 0.9)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cgroup_directory = std::move(directory);
+        m_cgroup_threshold = threshold;
+
+        // Do not count events which happened before we started watching
+        read_events(m_cgroup_directory + "/memory.events", m_events_high,
+                    m_events_max);
+    }
+
+    /// Set the fraction of the unused bytes of the registered pools
+    /// released when pressure is detected. 1.0, the default, frees all
+    /// unused resources.
+    /// @param fraction The fraction in the range [0, 1]
+    void set_release_fraction(double fraction)
+    {
+        assert(fraction >= 0.0 && fraction <= 1.0);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_release_fraction = fraction;
+    }
+
+    /// Reads the watched sources and trims the pools if there is memory
+    /// pressure.
+    /// @return True if pressure was detected
+    bool poll()
+    {
+        double fraction = 0.0;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            // Both sources are always read to keep the event counters
+            // up to date
+            bool psi = psi_pressure();
+            bool cgroup = cgroup_pressure();
+
+            if (!psi && !cgroup)
+            {
+                return false;
+            }
+
+            ++m_pressure_events;
+            fraction = m_release_fraction;
+        }
+
+        std::size_t unused = m_registry.unused_bytes();
+        double keep = static_cast<double>(unused) * (1.0 - fraction);
+        m_registry.trim(static_cast<std::size_t>(keep));
+
+        return true;
+    }
+
+    /// @return The number of times pressure has been detected
+    uint64_t pressure_events() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_pressure_events;
+    }
+
+    /// Starts a background thread polling the sources
+    /// @param interval The time between polls
+    void start(std::chrono::milliseconds interval = std::chrono::seconds(1))
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        assert(!m_thread.joinable() && "Already started");
+        m_running = true;
+        m_thread = std::thread(
+            [this, interval]()
+            {
+                std::unique_lock<std::mutex> thread_lock(m_mutex);
+
+                while (m_running)
+                {
+                    thread_lock.unlock();
+                    poll();
+                    thread_lock.lock();
+
+                    m_wakeup.wait_for(thread_lock, interval,
+                                      [this]() { return !m_running; });
+                }
+            });
+    }
+
+    /// Stops the background thread if running
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running = false;
+        }
+
+        m_wakeup.notify_all();
+
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+    }
+
+private:
+    bool psi_pressure() const
+    {
+        if (m_psi_path.empty())
+        {
+            return false;
+        }
+
+        // The file looks like:
+        //
+        //   some avg10=0.00 avg60=0.00 avg300=0.00 total=0
+        //   full avg10=0.00 avg60=0.00 avg300=0.00 total=0
+        std::ifstream file(m_psi_path);
+        std::string line;
+
+        while (std::getline(file, line))
+        {
+            std::istringstream fields(line);
+            std::string kind;
+            fields >> kind;
+
+            if (kind != "some")
+            {
+                continue;
+            }
+
+            std::string field;
+            while (fields >> field)
+            {
+                if (field.compare(0, 6, "avg10=") == 0)
+                {
+                    double avg10 = std::strtod(field.c_str() + 6, nullptr);
+                    return avg10 >= m_psi_threshold;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    bool cgroup_pressure()
+    {
+        if (m_cgroup_directory.empty())
+        {
+            return false;
+        }
+
+        bool pressure = false;
+
+        uint64_t high = 0;
+        uint64_t max = 0;
+        if (read_events(m_cgroup_directory + "/memory.events", high, max))
+        {
+            pressure = high > m_events_high || max > m_events_max;
+            m_events_high = high;
+            m_events_max = max;
+        }
+
+        uint64_t current = 0;
+        uint64_t limit = 0;
+        if (read_value(m_cgroup_directory + "/memory.current", current) &&
+            read_limit(m_cgroup_directory, limit))
+        {
+            double usage =
+                static_cast<double>(current) / static_cast<double>(limit);
+            pressure = pressure || usage >= m_cgroup_threshold;
+        }
+
+        return pressure;
+    }
+
+    /// Reads the smaller of the finite memory.high and memory.max limits
+    /// of a cgroup, fails if both are unlimited or cannot be read
+    static bool read_limit(const std::string& directory, uint64_t& limit)
+    {
+        uint64_t high = 0;
+        uint64_t max = 0;
+        bool has_high = read_value(directory + "/memory.high", high);
+        bool has_max = read_value(directory + "/memory.max", max);
+
+        if (has_high && has_max)
+        {
+            limit = std::min(high, max);
+        }
+        else if (has_high || has_max)
+        {
+            limit = has_high ? high : max;
+        }
+
+        return has_high || has_max;
+    }
+
+    /// Reads a single number, fails for missing files, zero and "max"
+    static bool read_value(const std::string& path, uint64_t& value)
+    {
+        std::ifstream file(path);
+        return static_cast<bool>(file >> value) && value > 0;
+    }
+
+    /// Reads the "high" and "max" counters from a memory.events file
+    static bool read_events(const std::string& path, uint64_t& high,
+                            uint64_t& max)
+    {
+        std::ifstream file(path);
+
+        if (!file)
+        {
+            return false;
+        }
+
+        std::string key;
+        uint64_t value = 0;
+
+        while (file >> key >> value)
+        {
+            if (key == "high")
+            {
+                high = value;
+            }
+            else if (key == "max")
+            {
+                max = value;
+            }
+        }
+
+        return true;
+    }
+
+private:
+    /// The registry whose pools are trimmed
+    pool_registry& m_registry;
+
+    /// The PSI file, empty if not watched
+    std::string m_psi_path;
+
+    /// The "some avg10" percentage signalling pressure
+    double m_psi_threshold = 10.0;
+
+    /// The cgroup directory, empty if not watched
+    std::string m_cgroup_directory;
+
+    /// The fraction of the memory limit signalling pressure
+    double m_cgroup_threshold = 0.9;
+
+    /// The memory.events "high" counter at the previous poll
+    uint64_t m_events_high = 0;
+
+    /// The memory.events "max" counter at the previous poll
+    uint64_t m_events_max = 0;
+
+    /// The fraction of the unused bytes released under pressure
+    double m_release_fraction = 1.0;
+
+    /// The number of times pressure has been detected
+    uint64_t m_pressure_events = 0;
+
+    /// True while the background thread should run
+    bool m_running = false;
+
+    /// Wakes up the background thread when stopping
+    std::condition_variable m_wakeup;
+
+    /// The background thread
+    std::thread m_thread;
+
+    /// Mutex protecting the monitor
+    mutable std::mutex m_mutex;
+};
+}
@@ -0,0 +1,342 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace recycle
+{
+/// @brief Arena for the slab_pool reserving its memory with mmap.
+///
+/// The arena reserves a range of address space up front and carves the
+/// slabs out of it. Depending on the options the arena:
+///
+///   - Asks for transparent huge pages with MADV_HUGEPAGE, reducing the
+///     TLB misses when accessing many pooled values. The hint is best
+///     effort, it is ignored if the kernel does not support it.
+///   - Pre-faults the whole reservation up front and every decommitted
+///     slab when it is reused, so the values never take first-touch page
+///     faults on the hot path. The pages are faulted in with
+///     MADV_POPULATE_WRITE, or by touching them on older kernels.
+///   - Locks the slabs in memory with mlock, so they are never swapped
+///     out.
+///
+/// When the slab_pool deallocates a slab, the arena decommits it with
+/// MADV_DONTNEED, which returns the memory to the operating system while
+/// keeping the address space reserved. The slab is reused for the next
+/// slab allocated, and reads as zero until written.
+///
+/// Errors from the operating system when reserving or pre-faulting the
+/// memory or allocating a slab are reported as std::system_error, and
+/// std::bad_alloc is thrown when the reservation is exhausted.
+///
+/// The arena is not thread safe, the slab_pool only calls it while
+/// holding its lock. It is movable but not copyable.
+///
+/// Example:
+///
+///     recycle::mmap_arena::options options;
+///     options.m_populate = true;
+///
+///     using pool_type = recycle::slab_pool<
+///         header, recycle::no_locking_policy, recycle::mmap_arena>;
+///
+///     pool_type pool(1024, recycle::mmap_arena(1 << 30, options));
+///
+class mmap_arena
+{
+public:
+    /// The options of the arena
+    struct options
+    {
+        /// Ask for transparent huge pages with MADV_HUGEPAGE
+        bool m_huge_pages = true;
+
+        /// Pre-fault the reservation and reused slabs
+        bool m_populate = false;
+
+        /// Lock the slabs in memory with mlock
+        bool m_lock = false;
+    };
+
+    /// The alignment of the reservation, the size of a huge page on most
+    /// platforms
+    static constexpr std::size_t huge_page_size = 2 * 1024 * 1024;
+
+public:
+    /// Reserve the address space of the arena with the default options
+    /// @param reserve The number of bytes to reserve
+    explicit mmap_arena(std::size_t reserve) : mmap_arena(reserve, options())
+    {
+    }
+
+    /// Reserve the address space of the arena
+    /// @param reserve The number of bytes to reserve
+    /// @param opts The options of the arena
+    mmap_arena(std::size_t reserve, options opts) :
+        m_options(opts), m_page_size(static_cast<std::size_t>(
+                             ::sysconf(_SC_PAGESIZE)))
+    {
+        assert(reserve > 0);
+
+        // Over-reserve so the start can be aligned to a huge page
+        m_mapped_size = round_up(reserve, m_page_size) + huge_page_size;
+
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+
+        void* memory = ::mmap(nullptr, m_mapped_size, PROT_READ | PROT_WRITE,
+                              flags, -1, 0);
+
+        if (memory == MAP_FAILED)
+        {
+            throw std::system_error(errno, std::generic_category(), "mmap");
+        }
+
+        m_mapped = static_cast<uint8_t*>(memory);
+
+        uintptr_t address = reinterpret_cast<uintptr_t>(m_mapped);
+        m_begin = m_mapped + (round_up(address, huge_page_size) - address);
+        m_end = m_begin + round_up(reserve, m_page_size);
+        m_next = m_begin;
+
+#if defined(MADV_HUGEPAGE)
+        // Only a hint, e.g. kernels without transparent huge pages fail
+        // with EINVAL
+        if (m_options.m_huge_pages)
+        {
+            ::madvise(m_begin, m_end - m_begin, MADV_HUGEPAGE);
+        }
+#endif
+
+        // Only the aligned reservation is faulted in, not the alignment
+        // slack around it
+        if (m_options.m_populate)
+        {
+            int error = populate(m_begin, m_end - m_begin);
+
+            if (error != 0)
+            {
+                ::munmap(m_mapped, m_mapped_size);
+                throw std::system_error(error, std::generic_category(),
+                                        "populate");
+            }
+        }
+    }
+
+    /// The arena is not copyable
+    mmap_arena(const mmap_arena&) = delete;
+
+    /// The arena is not copyable
+    mmap_arena& operator=(const mmap_arena&) = delete;
+
+    /// Move constructor
+    mmap_arena(mmap_arena&& other) :
+        m_options(other.m_options), m_page_size(other.m_page_size),
+        m_mapped(other.m_mapped), m_mapped_size(other.m_mapped_size),
+        m_begin(other.m_begin), m_end(other.m_end), m_next(other.m_next),
+        m_decommitted(std::move(other.m_decommitted)),
+        m_committed(other.m_committed)
+    {
+        other.m_mapped = nullptr;
+    }
+
+    /// Move assignment
+    mmap_arena& operator=(mmap_arena&& other)
+    {
+        std::swap(m_options, other.m_options);
+        std::swap(m_page_size, other.m_page_size);
+        std::swap(m_mapped, other.m_mapped);
+        std::swap(m_mapped_size, other.m_mapped_size);
+        std::swap(m_begin, other.m_begin);
+        std::swap(m_end, other.m_end);
+        std::swap(m_next, other.m_next);
+        std::swap(m_decommitted, other.m_decommitted);
+        std::swap(m_committed, other.m_committed);
+        return *this;
+    }
+
+    /// Destructor, releases the reservation
+    ~mmap_arena()
+    {
+        if (m_mapped != nullptr)
+        {
+            ::munmap(m_mapped, m_mapped_size);
+        }
+    }
+
+    /// @param bytes The size of the slab
+    /// @return The memory of the slab
+    void* allocate(std::size_t bytes)
+    {
+        assert(m_mapped != nullptr);
+
+        bytes = round_up(bytes, m_page_size);
+        uint8_t* slab = nullptr;
+
+        // Reuse a decommitted slab of the same size
+        for (std::size_t i = 0; i < m_decommitted.size(); ++i)
+        {
+            if (m_decommitted[i].second == bytes)
+            {
+                slab = m_decommitted[i].first;
+                m_decommitted[i] = m_decommitted.back();
+                m_decommitted.pop_back();
+                break;
+            }
+        }
+
+        // The pages of a decommitted slab are gone, fault them in again
+        if (slab != nullptr && m_options.m_populate)
+        {
+            int error = populate(slab, bytes);
+
+            if (error != 0)
+            {
+                m_decommitted.emplace_back(slab, bytes);
+                throw std::system_error(error, std::generic_category(),
+                                        "populate");
+            }
+        }
+
+        if (slab == nullptr)
+        {
+            if (static_cast<std::size_t>(m_end - m_next) < bytes)
+            {
+                throw std::bad_alloc();
+            }
+
+            slab = m_next;
+            m_next += bytes;
+        }
+
+        if (m_options.m_lock && ::mlock(slab, bytes) != 0)
+        {
+            int error = errno;
+            m_decommitted.emplace_back(slab, bytes);
+            throw std::system_error(error, std::generic_category(), "mlock");
+        }
+
+        m_committed += bytes;
+        return slab;
+    }
+
+    /// Decommits the slab, returning its memory to the operating system
+    /// @param memory The memory of the slab
+    /// @param bytes The size of the slab
+    void deallocate(void* memory, std::size_t bytes)
+    {
+        assert(m_mapped != nullptr);
+
+        uint8_t* slab = static_cast<uint8_t*>(memory);
+        bytes = round_up(bytes, m_page_size);
+
+        assert(slab >= m_begin && slab + bytes <= m_next);
+
+        if (m_options.m_lock)
+        {
+            ::munlock(slab, bytes);
+        }
+
+        // Called from destructors, so we do not throw. MADV_DONTNEED
+        // only fails for ranges which are not mapped.
+        int result = ::madvise(slab, bytes, MADV_DONTNEED);
+        assert(result == 0);
+        (void)result;
+
+        m_decommitted.emplace_back(slab, bytes);
+        m_committed -= bytes;
+    }
+
+    /// @return The number of bytes of address space reserved
+    std::size_t reserved_bytes() const
+    {
+        return static_cast<std::size_t>(m_end - m_begin);
+    }
+
+    /// @return The number of bytes of the slabs currently allocated
+    std::size_t committed_bytes() const
+    {
+        return m_committed;
+    }
+
+    /// @return True if the memory is in the reservation of the arena
+    bool contains(const void* memory) const
+    {
+        const uint8_t* address = static_cast<const uint8_t*>(memory);
+        return address >= m_begin && address < m_end;
+    }
+
+private:
+    /// Faults in the pages of the memory
+    /// @return 0 on success, otherwise the errno
+    int populate(uint8_t* memory, std::size_t bytes) const
+    {
+#if defined(MADV_POPULATE_WRITE)
+        if (::madvise(memory, bytes, MADV_POPULATE_WRITE) == 0)
+        {
+            return 0;
+        }
+
+        // Kernels before 5.14 do not know MADV_POPULATE_WRITE
+        if (errno != EINVAL)
+        {
+            return errno;
+        }
+#endif
+
+        // Touch every page, the memory is zero so writing zero keeps it
+        for (std::size_t offset = 0; offset < bytes; offset += m_page_size)
+        {
+            static_cast<volatile uint8_t*>(memory)[offset] = 0;
+        }
+
+        return 0;
+    }
+
+    static std::size_t round_up(std::size_t value, std::size_t multiple)
+    {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+
+private:
+    /// The options of the arena
+    options m_options;
+
+    /// The size of a page
+    std::size_t m_page_size;
+
+    /// The mapping
+    uint8_t* m_mapped = nullptr;
+
+    /// The size of the mapping
+    std::size_t m_mapped_size = 0;
+
+    /// The aligned start of the reservation
+    uint8_t* m_begin = nullptr;
+
+    /// The end of the reservation
+    uint8_t* m_end = nullptr;
+
+    /// The start of the memory never handed out
+    uint8_t* m_next = nullptr;
+
+    /// The decommitted slabs and their sizes
+    std::vector<std::pair<uint8_t*, std::size_t>> m_decommitted;
+
+    /// The number of bytes of the slabs currently allocated
+    std::size_t m_committed = 0;
+};
+}
@@ -0,0 +1,24 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <mutex>
+
+namespace recycle
+{
+/// Locking policy using std::mutex.
+///
+/// This is the policy most users would otherwise write by hand, see
+/// no_locking_policy.
+struct mutex_locking_policy
+{
+    /// The locking policy mutex type
+    using mutex_type = std::mutex;
+
+    /// The locking policy lock type
+    using lock_type = std::lock_guard<mutex_type>;
+};
+}
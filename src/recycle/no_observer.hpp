@@ -0,0 +1,67 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <cstddef>
+
+namespace recycle
+{
+/// Defines the default observer policy for the recycle pools.
+///
+/// An observer gets notified about the events happening inside a pool
+/// and can be used to add tracing, statistics or logging without
+/// changing the pool itself. The default observer does nothing and
+/// since all its functions are empty and inlined the compiler removes
+/// the calls completely, i.e. observing a pool has zero overhead
+/// unless an observer is actually used.
+///
+/// A valid observer defines the following member functions, where pool
+/// is an opaque identifier of the pool (the address of the pool's
+/// internal state):
+///
+///     // Called when a resource has been handed out by the pool.
+///     // unused is the number of unused resources left in the pool.
+///     void on_allocate(const void* pool, std::size_t unused);
+///
+///     // Called when the pool has no unused resources and a new
+///     // resource is about to be created by the allocate function.
+///     void on_miss(const void* pool);
+///
+///     // Called when a resource has been released back to the pool,
+///     // also if the pool dropped it because of its byte budget.
+///     // unused is the number of unused resources in the pool.
+///     void on_recycle(const void* pool, std::size_t unused);
+///
+///     // Called when unused resources have been freed. freed is the
+///     // number of resources destroyed.
+///     void on_free_unused(const void* pool, std::size_t freed);
+///
+/// The observer is called without the pool's lock being held. So if
+/// used with a thread-safe locking policy the observer itself must be
+/// thread safe.
+struct no_observer
+{
+    /// Called when a resource has been handed out by the pool
+    void on_allocate(const void*, std::size_t)
+    {
+    }
+
+    /// Called before the allocate function is invoked on a miss
+    void on_miss(const void*)
+    {
+    }
+
+    /// Called when a resource has been released back to the pool
+    void on_recycle(const void*, std::size_t)
+    {
+    }
+
+    /// Called when unused resources have been freed
+    void on_free_unused(const void*, std::size_t)
+    {
+    }
+};
+}
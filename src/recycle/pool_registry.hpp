@@ -0,0 +1,556 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace recycle
+{
+/// @brief The pool_registry coordinates the memory retained by many
+///        pools.
+///
+/// Every pool retains its unused resources independently. The registry
+/// allows a number of pools to be registered under a name, exposes the
+/// aggregated statistics of the registered pools and enforces a common
+/// budget for the bytes retained by their unused resources.
+///
+/// When the budget is exceeded, enforce_budget() trims the registered
+/// pools, either the ones retaining the most bytes first or the least
+/// recently used ones first. A pool using the pool_registry::use_counter
+/// observer is considered used when it has handed out resources since
+/// the previous call to enforce_budget(). For other pools the registry
+/// can only tell that a pool was used when its number of unused
+/// resources has changed.
+///
+/// Any pool providing unused_resources(), unused_bytes() and trim(), e.g.
+/// the shared_pool and unique_pool, can be registered.
+///
+/// Since the registry is meant to be shared by the pools of a process,
+/// it is always thread safe. It does not lock the pools while calling
+/// them, that is left to the pools' locking policies. The pools are
+/// trimmed without holding the registry's lock.
+class pool_registry
+{
+private:
+    /// Forward declare
+    struct entry;
+
+public:
+    /// Observer policy counting the resources handed out by a pool, so
+    /// the registry can tell which pools are in use. Example:
+    ///
+    ///     recycle::unique_pool<buffer, recycle::mutex_locking_policy,
+    ///                          recycle::pool_registry::use_counter> pool;
+    ///
+    class use_counter
+    {
+    public:
+        /// Default constructor
+        use_counter() = default;
+
+        /// Copy constructor, the copy belongs to a new pool which has
+        /// not been used yet
+        use_counter(const use_counter&)
+        {
+        }
+
+        /// Copy assignment, starts over like the copy constructor
+        use_counter& operator=(const use_counter&)
+        {
+            m_uses.store(0, std::memory_order_relaxed);
+            return *this;
+        }
+
+        /// @return The number of resources handed out by the pool
+        uint64_t uses() const
+        {
+            return m_uses.load(std::memory_order_relaxed);
+        }
+
+        /// Called when a resource has been handed out by the pool
+        void on_allocate(const void*, std::size_t)
+        {
+            m_uses.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /// Called before the allocate function is invoked on a miss
+        void on_miss(const void*)
+        {
+        }
+
+        /// Called when a resource has been released back to the pool
+        void on_recycle(const void*, std::size_t)
+        {
+        }
+
+        /// Called when unused resources have been freed
+        void on_free_unused(const void*, std::size_t)
+        {
+        }
+
+    private:
+        /// The number of resources handed out
+        std::atomic<uint64_t> m_uses{0};
+    };
+
+    /// The order in which the pools are trimmed when the budget is
+    /// exceeded
+    enum class order
+    {
+        /// Trim the pools retaining the most bytes first
+        largest_first,
+
+        /// Trim the pools which have been used least recently first
+        least_recently_used
+    };
+
+    /// The statistics of a registered pool
+    struct pool_info
+    {
+        /// The name given when registering the pool
+        std::string m_name;
+
+        /// The number of unused resources of the pool
+        std::size_t m_unused_resources;
+
+        /// The number of bytes retained by the unused resources
+        std::size_t m_unused_bytes;
+    };
+
+    /// The registration of a pool. The pool is unregistered when the
+    /// registration is destroyed, so it must not outlive the pool, and
+    /// the registry must outlive it.
+    class registration
+    {
+    public:
+        /// Default constructor, creates an empty registration
+        registration() = default;
+
+        /// @param registry The registry the pool is registered with
+        /// @param id The id of the pool in the registry
+        registration(pool_registry* registry, uint64_t id) :
+            m_registry(registry), m_id(id)
+        {
+            assert(m_registry);
+        }
+
+        /// The registration is not copyable
+        registration(const registration&) = delete;
+
+        /// The registration is not copyable
+        registration& operator=(const registration&) = delete;
+
+        /// Move constructor
+        registration(registration&& other) :
+            m_registry(other.m_registry), m_id(other.m_id)
+        {
+            other.m_registry = nullptr;
+        }
+
+        /// Move assignment
+        registration& operator=(registration&& other)
+        {
+            std::swap(m_registry, other.m_registry);
+            std::swap(m_id, other.m_id);
+            return *this;
+        }
+
+        /// Destructor
+        ~registration()
+        {
+            reset();
+        }
+
+        /// Unregisters the pool
+        void reset()
+        {
+            if (m_registry)
+            {
+                m_registry->remove(m_id);
+                m_registry = nullptr;
+            }
+        }
+
+    private:
+        /// The registry the pool is registered with
+        pool_registry* m_registry = nullptr;
+
+        /// The id of the pool in the registry
+        uint64_t m_id = 0;
+    };
+
+public:
+    /// Default constructor, the budget is unlimited
+    pool_registry() = default;
+
+    /// The registry is not copyable
+    pool_registry(const pool_registry&) = delete;
+
+    /// The registry is not copyable
+    pool_registry& operator=(const pool_registry&) = delete;
+
+    /// Destructor
+    ~pool_registry()
+    {
+        assert(m_entries.empty() && "Pools must be unregistered first");
+    }
+
+    /// Register a pool with the registry
+    /// @param name The name of the pool, used in the statistics
+    /// @param pool The pool to register
+    /// @return The registration keeping the pool registered
+    template <class Pool>
+    registration add(std::string name, Pool& pool)
+    {
+        entry e;
+        e.m_name = std::move(name);
+        e.m_unused_resources = [&pool]() { return pool.unused_resources(); };
+        e.m_unused_bytes = [&pool]() { return pool.unused_bytes(); };
+        e.m_trim = [&pool](std::size_t items) { return pool.trim(items); };
+        e.m_uses = uses_function(pool, pool.observer());
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        e.m_last_unused = e.m_unused_resources();
+        e.m_last_uses = e.m_uses ? e.m_uses() : 0;
+        e.m_last_used = m_tick;
+
+        uint64_t id = m_next_id++;
+        m_entries.emplace(id, std::move(e));
+        return registration(this, id);
+    }
+
+    /// @return The number of registered pools
+    std::size_t pools() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_entries.size();
+    }
+
+    /// @return The statistics of every registered pool
+    std::vector<pool_info> statistics() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        std::vector<pool_info> result;
+        for (const auto& e : m_entries)
+        {
+            result.push_back({e.second.m_name, e.second.m_unused_resources(),
+                              e.second.m_unused_bytes()});
+        }
+
+        return result;
+    }
+
+    /// @return The number of unused resources of all registered pools
+    std::size_t unused_resources() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        std::size_t total = 0;
+        for (const auto& e : m_entries)
+        {
+            total += e.second.m_unused_resources();
+        }
+
+        return total;
+    }
+
+    /// @return The number of bytes retained by the unused resources of
+    ///         all registered pools
+    std::size_t unused_bytes() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        std::size_t total = 0;
+        for (const auto& e : m_entries)
+        {
+            total += e.second.m_unused_bytes();
+        }
+
+        return total;
+    }
+
+    /// Set the budget for the bytes retained by the unused resources of
+    /// all the registered pools.
+    /// @param max_unused_bytes The budget in bytes
+    void set_max_unused_bytes(std::size_t max_unused_bytes)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_max_unused_bytes = max_unused_bytes;
+    }
+
+    /// @return The budget for the bytes retained by the unused resources
+    std::size_t max_unused_bytes() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_max_unused_bytes;
+    }
+
+    /// @param value The order in which pools are trimmed
+    void set_trim_order(order value)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_trim_order = value;
+    }
+
+    /// @return The order in which pools are trimmed
+    order trim_order() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_trim_order;
+    }
+
+    /// Trims the registered pools until the bytes retained by their
+    /// unused resources are within the budget. This is typically called
+    /// periodically, e.g. from a housekeeping task.
+    /// @return The number of bytes freed
+    std::size_t enforce_budget()
+    {
+        return trim_to(max_unused_bytes());
+    }
+
+    /// Trims the registered pools until the bytes retained by their
+    /// unused resources are at most max_unused_bytes, regardless of the
+    /// budget set.
+    /// @param max_unused_bytes The number of bytes to trim down to
+    /// @return The number of bytes freed
+    std::size_t trim(std::size_t max_unused_bytes)
+    {
+        return trim_to(max_unused_bytes);
+    }
+
+    /// Frees all unused resources of all registered pools
+    void free_unused()
+    {
+        trim(0);
+    }
+
+private:
+    /// A registered pool
+    struct entry
+    {
+        /// The name of the pool
+        std::string m_name;
+
+        /// Returns the unused resources of the pool
+        std::function<std::size_t()> m_unused_resources;
+
+        /// Returns the unused bytes of the pool
+        std::function<std::size_t()> m_unused_bytes;
+
+        /// Trims the pool
+        std::function<std::size_t(std::size_t)> m_trim;
+
+        /// Returns the number of resources handed out by the pool, empty
+        /// if the pool does not count them
+        std::function<uint64_t()> m_uses;
+
+        /// The number of unused resources last time we looked
+        std::size_t m_last_unused = 0;
+
+        /// The number of resources handed out last time we looked
+        uint64_t m_last_uses = 0;
+
+        /// The tick at which the pool was last seen in use
+        uint64_t m_last_used = 0;
+    };
+
+    /// A snapshot of a pool used while trimming
+    struct candidate
+    {
+        entry* m_entry;
+        std::size_t m_unused_resources;
+        std::size_t m_unused_bytes;
+    };
+
+    /// @return A function returning the uses counted by the observer
+    template <class Pool>
+    static std::function<uint64_t()> uses_function(Pool& pool,
+                                                   const use_counter&)
+    {
+        return [&pool]() { return pool.observer().uses(); };
+    }
+
+    /// Other observers do not count the uses
+    template <class Pool, class Observer>
+    static std::function<uint64_t()> uses_function(Pool&, const Observer&)
+    {
+        return nullptr;
+    }
+
+    void remove(uint64_t id)
+    {
+        // Wait for a trim in progress, which may be calling into the pool
+        std::lock_guard<std::mutex> trim_lock(m_trim_mutex);
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        assert(m_entries.count(id) == 1);
+        m_entries.erase(id);
+    }
+
+    /// Trims the pools. The pools to trim are chosen while holding the
+    /// registry's lock, but trimmed after releasing it. The trim lock
+    /// keeps the pools registered meanwhile.
+    std::size_t trim_to(std::size_t max_unused_bytes)
+    {
+        std::lock_guard<std::mutex> trim_lock(m_trim_mutex);
+
+        std::vector<candidate> candidates;
+        std::size_t total = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            ++m_tick;
+
+            for (auto& e : m_entries)
+            {
+                entry& pool = e.second;
+
+                std::size_t unused = pool.m_unused_resources();
+                std::size_t bytes = pool.m_unused_bytes();
+
+                if (pool.m_uses)
+                {
+                    uint64_t uses = pool.m_uses();
+
+                    if (uses != pool.m_last_uses)
+                    {
+                        pool.m_last_uses = uses;
+                        pool.m_last_used = m_tick;
+                    }
+                }
+                else if (unused != pool.m_last_unused)
+                {
+                    pool.m_last_used = m_tick;
+                }
+
+                pool.m_last_unused = unused;
+
+                candidates.push_back({&pool, unused, bytes});
+                total += bytes;
+            }
+
+            if (total <= max_unused_bytes)
+            {
+                return 0;
+            }
+
+            sort_candidates(candidates);
+        }
+
+        std::size_t freed = 0;
+
+        for (auto& c : candidates)
+        {
+            while (total > max_unused_bytes && c.m_unused_resources > 0)
+            {
+                std::size_t excess = total - max_unused_bytes;
+                std::size_t items = c.m_unused_resources;
+
+                // Estimate the number of resources to free from the
+                // average size of the pool's unused resources
+                if (excess < c.m_unused_bytes)
+                {
+                    std::size_t average = c.m_unused_bytes / items;
+                    average = std::max<std::size_t>(average, 1);
+                    items = std::min(items, (excess + average - 1) / average);
+                }
+
+                if (c.m_entry->m_trim(items) == 0)
+                {
+                    break;
+                }
+
+                std::size_t unused = c.m_entry->m_unused_resources();
+                std::size_t bytes = c.m_entry->m_unused_bytes();
+
+                std::size_t released =
+                    c.m_unused_bytes > bytes ? c.m_unused_bytes - bytes : 0;
+
+                total -= std::min(total, released);
+                freed += released;
+
+                c.m_unused_resources = unused;
+                c.m_unused_bytes = bytes;
+            }
+
+            if (total <= max_unused_bytes)
+            {
+                break;
+            }
+        }
+
+        // The trimming is not a use of the pools
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for (auto& c : candidates)
+        {
+            c.m_entry->m_last_unused = c.m_unused_resources;
+        }
+
+        return freed;
+    }
+
+    /// Orders the candidates in the order they should be trimmed
+    void sort_candidates(std::vector<candidate>& candidates) const
+    {
+        if (m_trim_order == order::largest_first)
+        {
+            std::stable_sort(candidates.begin(), candidates.end(),
+                             [](const candidate& a, const candidate& b)
+                             { return a.m_unused_bytes > b.m_unused_bytes; });
+        }
+        else
+        {
+            std::stable_sort(
+                candidates.begin(), candidates.end(),
+                [](const candidate& a, const candidate& b)
+                {
+                    if (a.m_entry->m_last_used != b.m_entry->m_last_used)
+                    {
+                        return a.m_entry->m_last_used < b.m_entry->m_last_used;
+                    }
+
+                    return a.m_unused_bytes > b.m_unused_bytes;
+                });
+        }
+    }
+
+private:
+    /// The registered pools
+    std::map<uint64_t, entry> m_entries;
+
+    /// The id given to the next registered pool
+    uint64_t m_next_id = 0;
+
+    /// Incremented every time the pools are trimmed
+    uint64_t m_tick = 0;
+
+    /// The budget for the unused bytes of all pools
+    std::size_t m_max_unused_bytes = std::numeric_limits<std::size_t>::max();
+
+    /// The order in which pools are trimmed
+    order m_trim_order = order::largest_first;
+
+    /// Mutex protecting the registry
+    mutable std::mutex m_mutex;
+
+    /// Mutex serializing the trims, taken before m_mutex
+    std::mutex m_trim_mutex;
+};
+}
@@ -0,0 +1,270 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <vector>
+
+#include "trace_recorder.hpp"
+
+namespace recycle
+{
+/// The pool configuration simulated by the pool_simulator
+struct simulation_config
+{
+    /// The maximum number of unused resources retained by the pool,
+    /// divided evenly between the shards
+    std::size_t m_max_unused = std::numeric_limits<std::size_t>::max();
+
+    /// The number of shards, each with its own free list and lock. A
+    /// thread always uses the same shard.
+    std::size_t m_shards = 1;
+
+    /// The number of unused resources each thread may cache without
+    /// taking a lock, zero for no thread cache
+    std::size_t m_thread_cache = 0;
+
+    /// The size in bytes of a resource
+    std::size_t m_resource_bytes = 1;
+};
+
+/// The outcome of replaying a trace with a pool configuration
+struct simulation_result
+{
+    /// The number of allocations replayed
+    uint64_t m_allocations = 0;
+
+    /// The number of allocations served by an unused resource
+    uint64_t m_hits = 0;
+
+    /// The number of allocations which had to create a resource
+    uint64_t m_misses = 0;
+
+    /// The number of releases replayed
+    uint64_t m_releases = 0;
+
+    /// The number of released resources destroyed since the retention
+    /// limit was reached
+    uint64_t m_dropped = 0;
+
+    /// The number of times a shard lock was acquired
+    uint64_t m_lock_acquisitions = 0;
+
+    /// The peak number of resources alive, in use or unused
+    uint64_t m_peak_resources = 0;
+
+    /// The peak number of bytes of the resources alive
+    uint64_t m_peak_bytes = 0;
+
+    /// @return The fraction of the allocations served by an unused
+    ///         resource
+    double hit_rate() const
+    {
+        if (m_allocations == 0)
+        {
+            return 0.0;
+        }
+
+        return static_cast<double>(m_hits) /
+               static_cast<double>(m_allocations);
+    }
+};
+
+/// @brief Replays a recorded trace against a pool configuration.
+///
+/// The simulator models every pool of the trace as a number of shards,
+/// each with a free list guarded by a lock, optionally fronted by a
+/// per-thread cache:
+///
+///   - An allocation is served from the thread's cache without locking.
+///     Otherwise the lock of the thread's shard is taken and an unused
+///     resource is handed out, or a new one is created on a miss.
+///   - A release goes to the thread's cache if it has room. Otherwise the
+///     lock of the thread's shard is taken and the resource is kept, or
+///     destroyed if the shard retains its share of the retention limit.
+///
+/// Only the allocate and release events of the trace are replayed. The
+/// misses and frees of the recorded run depend on its configuration, the
+/// simulator derives its own. Releases of resources allocated before the
+/// trace started are ignored.
+class pool_simulator
+{
+public:
+    /// @param config The pool configuration to simulate
+    explicit pool_simulator(const simulation_config& config) :
+        m_config(config)
+    {
+        assert(m_config.m_shards > 0);
+
+        m_shard_limit = m_config.m_max_unused / m_config.m_shards;
+
+        if (m_config.m_max_unused % m_config.m_shards != 0)
+        {
+            ++m_shard_limit;
+        }
+    }
+
+    /// Replays an event
+    /// @param event The event from the trace
+    void replay(const trace_event& event)
+    {
+        switch (event.m_type)
+        {
+        case trace_event_type::allocate:
+            allocate(m_pools[event.m_pool], event.m_thread);
+            break;
+        case trace_event_type::release:
+            release(m_pools[event.m_pool], event.m_thread);
+            break;
+        default:
+            break;
+        }
+    }
+
+    /// Replays the events of a trace
+    /// @param events The events in the order they were recorded
+    void replay(const std::vector<trace_event>& events)
+    {
+        for (const trace_event& event : events)
+        {
+            replay(event);
+        }
+    }
+
+    /// @return The outcome of the events replayed so far
+    const simulation_result& result() const
+    {
+        return m_result;
+    }
+
+private:
+    /// The simulated state of a pool
+    struct pool_state
+    {
+        /// The unused resources of each shard
+        std::vector<std::size_t> m_shards;
+
+        /// The unused resources cached by each thread
+        std::map<uint32_t, std::size_t> m_caches;
+
+        /// The resources handed out and not yet released
+        std::size_t m_in_use = 0;
+    };
+
+    void allocate(pool_state& pool, uint32_t thread)
+    {
+        ++m_result.m_allocations;
+        ++pool.m_in_use;
+
+        if (m_config.m_thread_cache > 0)
+        {
+            std::size_t& cache = pool.m_caches[thread];
+
+            if (cache > 0)
+            {
+                --cache;
+                ++m_result.m_hits;
+                return;
+            }
+        }
+
+        std::size_t& shard = shard_of(pool, thread);
+        ++m_result.m_lock_acquisitions;
+
+        if (shard > 0)
+        {
+            --shard;
+            ++m_result.m_hits;
+            return;
+        }
+
+        ++m_result.m_misses;
+        ++m_alive;
+
+        m_result.m_peak_resources = std::max(m_result.m_peak_resources,
+                                             m_alive);
+        m_result.m_peak_bytes =
+            m_result.m_peak_resources * m_config.m_resource_bytes;
+    }
+
+    void release(pool_state& pool, uint32_t thread)
+    {
+        if (pool.m_in_use == 0)
+        {
+            // Allocated before the trace started
+            return;
+        }
+
+        ++m_result.m_releases;
+        --pool.m_in_use;
+
+        if (m_config.m_thread_cache > 0)
+        {
+            std::size_t& cache = pool.m_caches[thread];
+
+            if (cache < m_config.m_thread_cache)
+            {
+                ++cache;
+                return;
+            }
+        }
+
+        std::size_t& shard = shard_of(pool, thread);
+        ++m_result.m_lock_acquisitions;
+
+        if (shard < m_shard_limit)
+        {
+            ++shard;
+            return;
+        }
+
+        ++m_result.m_dropped;
+        --m_alive;
+    }
+
+    std::size_t& shard_of(pool_state& pool, uint32_t thread)
+    {
+        if (pool.m_shards.empty())
+        {
+            pool.m_shards.resize(m_config.m_shards);
+        }
+
+        return pool.m_shards[thread % m_config.m_shards];
+    }
+
+private:
+    /// The configuration simulated
+    simulation_config m_config;
+
+    /// The unused resources each shard may retain
+    std::size_t m_shard_limit = 0;
+
+    /// The simulated pools by id
+    std::map<uint32_t, pool_state> m_pools;
+
+    /// The resources alive in all pools
+    uint64_t m_alive = 0;
+
+    /// The outcome so far
+    simulation_result m_result;
+};
+
+/// Replays a trace against a pool configuration
+/// @param events The events in the order they were recorded
+/// @param config The pool configuration to simulate
+/// @return The outcome of the simulation
+inline simulation_result simulate(const std::vector<trace_event>& events,
+                                  const simulation_config& config)
+{
+    pool_simulator simulator(config);
+    simulator.replay(events);
+    return simulator.result();
+}
+}
@@ -0,0 +1,385 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace recycle
+{
+/// @brief The remote_free_pool is a pool owned by a single thread which
+///        any thread may release resources into.
+///
+/// The pool is designed for pipelines where one thread allocates the
+/// resources and other threads release them. Instead of a mutex shared
+/// by both sides, the pool uses the scheme known from mimalloc:
+///
+///   - The owning thread has a private free list which it accesses
+///     without any synchronization.
+///
+///   - Other threads push the resources they release onto a lock-free
+///     multiple producer single consumer "remote free" list.
+///
+///   - When the private free list runs dry, the owning thread takes the
+///     whole remote free list with a single atomic exchange and uses it
+///     as its new private free list.
+///
+/// Since the remote free list is only ever emptied as a whole by its
+/// single consumer, the pushes do not suffer from the ABA problem.
+///
+/// The owning thread is the thread constructing the pool. Only that
+/// thread may call allocate(), unused_resources() and free_unused().
+/// Resources may be released from any thread, also after the pool has
+/// been destroyed, in which case they are simply destroyed.
+template <class Value>
+class remote_free_pool
+{
+private:
+    /// Forward declare
+    struct deleter;
+    struct impl;
+    struct node;
+
+public:
+    /// The type managed
+    using value_type = Value;
+
+    /// The pointer to the resource
+    using pool_ptr = std::unique_ptr<value_type, deleter>;
+
+    /// The owning pointer to the resource
+    using value_ptr = std::unique_ptr<value_type>;
+
+    /// The allocate function type
+    /// Should take no arguments and return an std::unique_ptr to the Value
+    using allocate_function = std::function<value_ptr()>;
+
+    /// The recycle function type
+    /// If specified the recycle function will be called every time a
+    /// resource gets recycled into the pool, on the releasing thread. If
+    /// the recycle function resets the resource, it is destroyed instead
+    /// of being put back into the pool.
+    using recycle_function = std::function<void(value_ptr&)>;
+
+public:
+    /// Default constructor, only available if the value_type is default
+    /// constructible. See unique_pool::unique_pool() for details.
+    template <class T = Value,
+              typename std::enable_if<std::is_default_constructible<T>::value,
+                                      uint8_t>::type = 0>
+    remote_free_pool() :
+        m_pool(new impl(allocate_function(std::make_unique<value_type>),
+                        recycle_function()))
+    {
+    }
+
+    /// Create a remote_free_pool using a specific allocate function.
+    /// @param allocate Allocation function
+    remote_free_pool(allocate_function allocate) :
+        m_pool(new impl(std::move(allocate), recycle_function()))
+    {
+    }
+
+    /// Create a remote_free_pool using a specific allocate function and
+    /// recycle function.
+    /// @param allocate Allocation function
+    /// @param recycle Recycle function, it must be thread safe.
+    remote_free_pool(allocate_function allocate, recycle_function recycle) :
+        m_pool(new impl(std::move(allocate), std::move(recycle)))
+    {
+        assert(m_pool->m_recycle);
+    }
+
+    /// The pool is not copyable, it is owned by a single thread
+    remote_free_pool(const remote_free_pool&) = delete;
+
+    /// The pool is not copyable, it is owned by a single thread
+    remote_free_pool& operator=(const remote_free_pool&) = delete;
+
+    /// Move constructor
+    remote_free_pool(remote_free_pool&& other) : m_pool(other.m_pool)
+    {
+        assert(m_pool);
+        other.m_pool = nullptr;
+    }
+
+    /// Move assignment
+    remote_free_pool& operator=(remote_free_pool&& other)
+    {
+        std::swap(m_pool, other.m_pool);
+        return *this;
+    }
+
+    /// Destructor
+    ~remote_free_pool()
+    {
+        if (m_pool)
+        {
+            m_pool->close();
+            m_pool->free_unused();
+            m_pool->unref();
+        }
+    }
+
+    /// @returns the number of unused resources. The remote free list is
+    ///          taken over by the private free list first.
+    std::size_t unused_resources()
+    {
+        assert(m_pool);
+        return m_pool->unused_resources();
+    }
+
+    /// Frees all unused resources
+    void free_unused()
+    {
+        assert(m_pool);
+        m_pool->free_unused();
+    }
+
+    /// @return A resource from the pool.
+    pool_ptr allocate()
+    {
+        assert(m_pool);
+        return m_pool->allocate();
+    }
+
+private:
+    /// A resource together with the link used in the free lists. The
+    /// node is allocated once for every resource and stays with it.
+    struct node
+    {
+        /// The resource
+        value_ptr m_value;
+
+        /// The next node in the free list
+        node* m_next = nullptr;
+    };
+
+    /// The actual pool implementation. It is kept alive by the pool and
+    /// by every resource handed out, using an atomic reference count.
+    struct impl
+    {
+        impl(allocate_function allocate, recycle_function recycle) :
+            m_allocate(std::move(allocate)), m_recycle(std::move(recycle)),
+            m_owner(std::this_thread::get_id())
+        {
+            assert(m_allocate);
+        }
+
+        ~impl()
+        {
+            delete_list(m_private);
+            delete_list(m_remote.load(std::memory_order_acquire));
+        }
+
+        /// Allocate a new value from the pool
+        pool_ptr allocate()
+        {
+            assert(is_owner());
+
+            if (m_private == nullptr)
+            {
+                // Take over everything released by other threads
+                m_private =
+                    m_remote.exchange(nullptr, std::memory_order_acquire);
+            }
+
+            node* n = m_private;
+
+            if (n != nullptr)
+            {
+                m_private = n->m_next;
+                n->m_next = nullptr;
+            }
+            else
+            {
+                std::unique_ptr<node> fresh(new node);
+                fresh->m_value = m_allocate();
+                n = fresh.release();
+            }
+
+            m_references.fetch_add(1, std::memory_order_relaxed);
+
+            value_type* naked_ptr = n->m_value.get();
+            return pool_ptr(naked_ptr, deleter(this, n));
+        }
+
+        /// @copydoc remote_free_pool::unused_resources()
+        std::size_t unused_resources()
+        {
+            assert(is_owner());
+            take_remote();
+
+            std::size_t count = 0;
+            for (node* n = m_private; n != nullptr; n = n->m_next)
+            {
+                ++count;
+            }
+
+            return count;
+        }
+
+        /// @copydoc remote_free_pool::free_unused()
+        void free_unused()
+        {
+            assert(is_owner());
+            take_remote();
+
+            delete_list(m_private);
+            m_private = nullptr;
+        }
+
+        /// Called when a resource has been released on any thread
+        void release(node* n)
+        {
+            if (m_recycle)
+            {
+                m_recycle(n->m_value);
+            }
+
+            if (!n->m_value || !m_open.load(std::memory_order_acquire))
+            {
+                // The recycle function dropped the resource or the pool
+                // is gone, so nobody will reuse the resource
+                delete n;
+            }
+            else if (is_owner())
+            {
+                n->m_next = m_private;
+                m_private = n;
+            }
+            else
+            {
+                node* head = m_remote.load(std::memory_order_relaxed);
+
+                do
+                {
+                    n->m_next = head;
+                } while (!m_remote.compare_exchange_weak(
+                    head, n, std::memory_order_release,
+                    std::memory_order_relaxed));
+            }
+
+            unref();
+        }
+
+        /// Called when the pool is destroyed
+        void close()
+        {
+            m_open.store(false, std::memory_order_release);
+        }
+
+        /// Drops a reference, deleting the impl when it was the last
+        void unref()
+        {
+            if (m_references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                delete this;
+            }
+        }
+
+    private:
+        bool is_owner() const
+        {
+            return std::this_thread::get_id() == m_owner;
+        }
+
+        /// Appends the remote free list to the private free list
+        void take_remote()
+        {
+            node* remote =
+                m_remote.exchange(nullptr, std::memory_order_acquire);
+
+            if (remote == nullptr)
+            {
+                return;
+            }
+
+            node* last = remote;
+            while (last->m_next != nullptr)
+            {
+                last = last->m_next;
+            }
+
+            last->m_next = m_private;
+            m_private = remote;
+        }
+
+        static void delete_list(node* n)
+        {
+            while (n != nullptr)
+            {
+                node* next = n->m_next;
+                delete n;
+                n = next;
+            }
+        }
+
+    public:
+        /// The allocator to use
+        allocate_function m_allocate;
+
+        /// The recycle function
+        recycle_function m_recycle;
+
+    private:
+        /// The owning thread
+        std::thread::id m_owner;
+
+        /// The private free list, only accessed by the owning thread
+        node* m_private = nullptr;
+
+        /// The remote free list, pushed to by all other threads
+        std::atomic<node*> m_remote{nullptr};
+
+        /// False once the pool has been destroyed
+        std::atomic<bool> m_open{true};
+
+        /// One reference for the pool and one for every resource handed
+        /// out
+        std::atomic<std::size_t> m_references{1};
+    };
+
+    /// The custom deleter object used by the std::unique_ptr<T>
+    struct deleter
+    {
+        /// Constructor
+        deleter() = default;
+
+        /// @param pool The pool the resource belongs to
+        /// @param n The node of the resource
+        deleter(impl* pool, node* n) : m_pool(pool), m_node(n)
+        {
+            assert(m_pool);
+            assert(m_node);
+        }
+
+        /// Call operator called by std::unique_ptr<T> when
+        /// de-allocating the object.
+        void operator()(value_type*)
+        {
+            assert(m_pool);
+            m_pool->release(m_node);
+        }
+
+        // Pointer to the pool needed for recycling
+        impl* m_pool = nullptr;
+
+        // The node of the resource
+        node* m_node = nullptr;
+    };
+
+private:
+    // The pool impl
+    impl* m_pool;
+};
+}
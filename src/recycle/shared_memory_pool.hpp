@@ -0,0 +1,596 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace recycle
+{
+/// @brief Pool whose values live in a shared memory segment, so they can
+///        be allocated in one process and released in another.
+///
+/// The segment holds a header, the free list and the values. Nothing in
+/// the segment is a pointer: the free list links the values by index and
+/// every process maps the segment at its own address. A value is handed
+/// to another process by its index, which the other process turns back
+/// into a pool_ptr owning the value:
+///
+///     // Capture process
+///     auto pool = recycle::shared_memory_pool<packet>::create(
+///         "/capture", 1024);
+///     auto p = pool.allocate();
+///     p->m_size = read(socket, p->m_data, sizeof(p->m_data));
+///     send_index(pool.to_index(std::move(p)));
+///
+///     // Encode process
+///     auto pool = recycle::shared_memory_pool<packet>::open("/capture");
+///     auto p = pool.from_index(receive_index());
+///     encode(p->m_data, p->m_size);
+///     // p is released back to the pool here, in the encode process
+///
+/// The free list is a lock-free stack whose head carries a tag, which is
+/// incremented on every update to rule out the ABA problem. Since no lock
+/// is shared, a process dying in the middle of an operation never blocks
+/// the others, although the values it owned are not returned.
+///
+/// The values must be trivially copyable and destructible, since they
+/// are accessed by several processes and never constructed or destroyed.
+/// They start out zeroed and are handed out again as they were released.
+///
+/// The segment is either anonymous, created with memfd_create where
+/// available and shared by passing fd() to the other process, e.g. over
+/// fork or a Unix socket, or a named POSIX shared memory object. Errors
+/// from the operating system are reported as std::system_error.
+///
+/// The pool must outlive the resources it hands out in this process. It
+/// is thread safe and movable but not copyable.
+template <class Value>
+class shared_memory_pool
+{
+private:
+    /// Forward declare
+    struct deleter;
+    struct header;
+
+    static_assert(std::is_trivially_copyable<Value>::value &&
+                      std::is_trivially_destructible<Value>::value,
+                  "Values in shared memory must be trivial");
+
+    static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+                  "The free list needs lock-free atomics");
+
+public:
+    /// The type managed
+    using value_type = Value;
+
+    /// The pointer to the resource
+    using pool_ptr = std::unique_ptr<value_type, deleter>;
+
+    /// The index of a value in the segment
+    using index_type = uint32_t;
+
+    /// The index used for no value
+    static constexpr index_type npos = UINT32_MAX;
+
+public:
+    /// Creates an anonymous segment
+    /// @param capacity The number of values in the segment, greater than
+    ///        zero and less than npos, otherwise std::invalid_argument is
+    ///        thrown
+    /// @return The pool owning the segment
+    static shared_memory_pool create(std::size_t capacity)
+    {
+        check_capacity(capacity);
+
+        int fd = -1;
+
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+        fd = ::memfd_create("recycle_shared_memory_pool", MFD_CLOEXEC);
+
+        if (fd < 0)
+        {
+            throw std::system_error(errno, std::generic_category(),
+                                    "memfd_create");
+        }
+#else
+        // Create a named object and remove the name right away
+        std::string name = "/recycle_" + std::to_string(::getpid()) + "_" +
+                           std::to_string(reinterpret_cast<uintptr_t>(&fd));
+
+        fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+
+        if (fd < 0)
+        {
+            throw std::system_error(errno, std::generic_category(),
+                                    "shm_open");
+        }
+
+        ::shm_unlink(name.c_str());
+#endif
+
+        return shared_memory_pool(fd, capacity);
+    }
+
+    /// Creates a named segment, which other processes open by name
+    /// @param name The name of the segment, e.g. "/capture"
+    /// @param capacity The number of values in the segment, greater than
+    ///        zero and less than npos, otherwise std::invalid_argument is
+    ///        thrown
+    /// @return The pool owning the segment
+    static shared_memory_pool create(const std::string& name,
+                                     std::size_t capacity)
+    {
+        check_capacity(capacity);
+
+        int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+
+        if (fd < 0)
+        {
+            throw std::system_error(errno, std::generic_category(),
+                                    "shm_open");
+        }
+
+        try
+        {
+            return shared_memory_pool(fd, capacity);
+        }
+        catch (...)
+        {
+            ::shm_unlink(name.c_str());
+            throw;
+        }
+    }
+
+    /// Opens a segment created by another pool
+    /// @param fd The file descriptor of the segment, it is duplicated
+    /// @return The pool using the segment
+    static shared_memory_pool open(int fd)
+    {
+        int copy = ::dup(fd);
+
+        if (copy < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "dup");
+        }
+
+        return shared_memory_pool(copy);
+    }
+
+    /// Opens a named segment created by another pool
+    /// @param name The name of the segment
+    /// @return The pool using the segment
+    static shared_memory_pool open(const std::string& name)
+    {
+        int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+
+        if (fd < 0)
+        {
+            throw std::system_error(errno, std::generic_category(),
+                                    "shm_open");
+        }
+
+        return shared_memory_pool(fd);
+    }
+
+    /// Removes the name of a named segment. Pools already using the
+    /// segment keep it alive.
+    /// @param name The name of the segment
+    static void unlink(const std::string& name)
+    {
+        ::shm_unlink(name.c_str());
+    }
+
+    /// The pool is not copyable
+    shared_memory_pool(const shared_memory_pool&) = delete;
+
+    /// The pool is not copyable
+    shared_memory_pool& operator=(const shared_memory_pool&) = delete;
+
+    /// Move constructor
+    shared_memory_pool(shared_memory_pool&& other) :
+        m_segment(std::move(other.m_segment))
+    {
+    }
+
+    /// Move assignment
+    shared_memory_pool& operator=(shared_memory_pool&& other)
+    {
+        std::swap(m_segment, other.m_segment);
+        return *this;
+    }
+
+    /// @return A resource from the pool or an empty pool_ptr if all
+    ///         values are in use
+    pool_ptr allocate()
+    {
+        assert(m_segment);
+
+        index_type index = m_segment->pop();
+
+        if (index == npos)
+        {
+            return pool_ptr();
+        }
+
+        return pool_ptr(m_segment->value(index), deleter(m_segment.get()));
+    }
+
+    /// Gives up the ownership of a resource, e.g. to hand it to another
+    /// process which takes the ownership with from_index()
+    /// @param value The resource
+    /// @return The index of the resource in the segment
+    index_type to_index(pool_ptr value)
+    {
+        assert(m_segment);
+        assert(value);
+
+        return m_segment->index(value.release());
+    }
+
+    /// Takes the ownership of a resource given up with to_index(),
+    /// possibly in another process
+    /// @param index The index of the resource in the segment. Since it
+    ///        comes from another process it is always checked, and
+    ///        std::out_of_range is thrown if it is not in the segment.
+    /// @return The resource
+    pool_ptr from_index(index_type index)
+    {
+        assert(m_segment);
+
+        if (index >= capacity())
+        {
+            throw std::out_of_range("Index not in the shared memory segment");
+        }
+
+        return pool_ptr(m_segment->value(index), deleter(m_segment.get()));
+    }
+
+    /// @return The number of values in the segment
+    std::size_t capacity() const
+    {
+        assert(m_segment);
+        return m_segment->m_header->m_capacity;
+    }
+
+    /// @return The number of unused values, in all processes
+    std::size_t unused_resources() const
+    {
+        assert(m_segment);
+        return m_segment->m_header->m_unused.load(std::memory_order_relaxed);
+    }
+
+    /// @return The file descriptor of the segment, e.g. to pass it to
+    ///         another process
+    int fd() const
+    {
+        assert(m_segment);
+        return m_segment->m_fd;
+    }
+
+private:
+    /// Checks that the capacity can be addressed by an index_type, before
+    /// the segment is created
+    static void check_capacity(std::size_t capacity)
+    {
+        if (capacity == 0 || capacity >= npos)
+        {
+            throw std::invalid_argument(
+                "Shared memory pool capacity must be in [1, npos)");
+        }
+    }
+
+    /// Creates a new segment in the file
+    shared_memory_pool(int fd, std::size_t capacity)
+    {
+        assert(capacity > 0 && capacity < npos);
+
+        std::size_t size = slots_offset(capacity) + capacity * stride();
+
+        if (::ftruncate(fd, static_cast<off_t>(size)) != 0)
+        {
+            int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(),
+                                    "ftruncate");
+        }
+
+        m_segment.reset(new segment(fd, size));
+
+        // The file is zero filled by ftruncate
+        header* h = new (m_segment->m_memory) header();
+        h->m_version = version;
+        h->m_value_size = sizeof(value_type);
+        h->m_capacity = static_cast<index_type>(capacity);
+
+        std::atomic<index_type>* next = m_segment->next();
+        for (index_type i = 0; i < capacity; ++i)
+        {
+            new (&next[i]) std::atomic<index_type>(
+                i + 1 < capacity ? i + 1 : npos);
+        }
+
+        h->m_head.store(0, std::memory_order_relaxed);
+        h->m_unused.store(h->m_capacity, std::memory_order_relaxed);
+
+        std::memcpy(h->m_magic, magic, sizeof(magic));
+        h->m_ready.store(1, std::memory_order_release);
+
+        m_segment->attach(h);
+    }
+
+    /// Opens an existing segment in the file
+    explicit shared_memory_pool(int fd)
+    {
+        struct stat info;
+
+        if (::fstat(fd, &info) != 0)
+        {
+            int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), "fstat");
+        }
+
+        std::size_t size = static_cast<std::size_t>(info.st_size);
+
+        if (size < sizeof(header))
+        {
+            ::close(fd);
+            throw std::runtime_error("Shared memory segment not created");
+        }
+
+        m_segment.reset(new segment(fd, size));
+
+        header* h = static_cast<header*>(m_segment->m_memory);
+
+        if (h->m_ready.load(std::memory_order_acquire) != 1 ||
+            std::memcmp(h->m_magic, magic, sizeof(magic)) != 0 ||
+            h->m_version != version ||
+            h->m_value_size != sizeof(value_type) ||
+            size < slots_offset(h->m_capacity) + h->m_capacity * stride())
+        {
+            throw std::runtime_error("Incompatible shared memory segment");
+        }
+
+        m_segment->attach(h);
+    }
+
+    /// @return The distance between two values
+    static std::size_t stride()
+    {
+        return (sizeof(value_type) + alignof(value_type) - 1) /
+               alignof(value_type) * alignof(value_type);
+    }
+
+    /// @return The offset of the first value in the segment
+    static std::size_t slots_offset(std::size_t capacity)
+    {
+        std::size_t offset = sizeof(header) + capacity * sizeof(index_type);
+        std::size_t alignment = alignof(value_type) > cache_line
+                                    ? alignof(value_type)
+                                    : cache_line;
+
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+private:
+    /// The size of a cache line
+    static constexpr std::size_t cache_line = 64;
+
+    /// The magic bytes identifying a segment
+    static constexpr char magic[8] = {'R', 'C', 'Y', 'S', 'H', 'M',
+                                      'P', 'L'};
+
+    /// The version of the segment layout
+    static constexpr uint32_t version = 1;
+
+    /// The header at the start of the segment
+    struct header
+    {
+        /// The magic bytes identifying a segment
+        char m_magic[8];
+
+        /// The version of the segment layout
+        uint32_t m_version;
+
+        /// The size of a value, for sanity checking
+        uint32_t m_value_size;
+
+        /// The number of values in the segment
+        index_type m_capacity;
+
+        /// Set once the segment has been initialized
+        std::atomic<uint32_t> m_ready;
+
+        /// The number of unused values
+        std::atomic<uint32_t> m_unused;
+
+        /// The head of the free list, the index of the first unused value
+        /// in the low 32 bits and the tag in the high 32 bits. Kept on its
+        /// own cache line since every operation updates it.
+        alignas(cache_line) std::atomic<uint64_t> m_head;
+    };
+
+    /// The mapping of the segment in this process. The deleters point to
+    /// it, so it stays in place when the pool is moved.
+    struct segment
+    {
+        segment(int fd, std::size_t size) : m_fd(fd), m_size(size)
+        {
+            m_memory = ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE,
+                              MAP_SHARED, m_fd, 0);
+
+            if (m_memory == MAP_FAILED)
+            {
+                int error = errno;
+                ::close(m_fd);
+                throw std::system_error(error, std::generic_category(),
+                                        "mmap");
+            }
+        }
+
+        ~segment()
+        {
+            ::munmap(m_memory, m_size);
+            ::close(m_fd);
+        }
+
+        void attach(header* h)
+        {
+            m_header = h;
+            m_slots = static_cast<uint8_t*>(m_memory) +
+                      slots_offset(h->m_capacity);
+        }
+
+        /// @return The links of the free list following the header
+        std::atomic<index_type>* next()
+        {
+            return reinterpret_cast<std::atomic<index_type>*>(
+                static_cast<uint8_t*>(m_memory) + sizeof(header));
+        }
+
+        value_type* value(index_type index)
+        {
+            return reinterpret_cast<value_type*>(m_slots + index * stride());
+        }
+
+        index_type index(value_type* value)
+        {
+            std::size_t offset = static_cast<std::size_t>(
+                reinterpret_cast<uint8_t*>(value) - m_slots);
+
+            assert(offset % stride() == 0);
+            assert(offset / stride() < m_header->m_capacity);
+
+            return static_cast<index_type>(offset / stride());
+        }
+
+        /// Takes the first value of the free list
+        index_type pop()
+        {
+            std::atomic<uint64_t>& head = m_header->m_head;
+            uint64_t current = head.load(std::memory_order_acquire);
+
+            while (true)
+            {
+                index_type first = static_cast<index_type>(current);
+
+                if (first == npos)
+                {
+                    return npos;
+                }
+
+                // If another process took the value meanwhile, the tag
+                // has changed and the exchange fails
+                index_type second =
+                    next()[first].load(std::memory_order_relaxed);
+                uint64_t tag = (current >> 32) + 1;
+
+                if (head.compare_exchange_weak(current, (tag << 32) | second,
+                                               std::memory_order_acquire,
+                                               std::memory_order_acquire))
+                {
+                    m_header->m_unused.fetch_sub(1,
+                                                 std::memory_order_relaxed);
+                    return first;
+                }
+            }
+        }
+
+        /// Puts a value first in the free list
+        void push(index_type index)
+        {
+            std::atomic<uint64_t>& head = m_header->m_head;
+            uint64_t current = head.load(std::memory_order_relaxed);
+
+            while (true)
+            {
+                next()[index].store(static_cast<index_type>(current),
+                                    std::memory_order_relaxed);
+                uint64_t tag = (current >> 32) + 1;
+
+                if (head.compare_exchange_weak(current, (tag << 32) | index,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed))
+                {
+                    m_header->m_unused.fetch_add(1,
+                                                 std::memory_order_relaxed);
+                    return;
+                }
+            }
+        }
+
+        /// The file descriptor of the segment
+        int m_fd;
+
+        /// The size of the mapping
+        std::size_t m_size;
+
+        /// The mapping
+        void* m_memory = nullptr;
+
+        /// The header at the start of the mapping
+        header* m_header = nullptr;
+
+        /// The first value
+        uint8_t* m_slots = nullptr;
+    };
+
+    /// The custom deleter object used by the std::unique_ptr<T>
+    struct deleter
+    {
+        /// Constructor
+        deleter() = default;
+
+        /// @param pool The mapping of the segment
+        deleter(segment* pool) : m_pool(pool)
+        {
+            assert(m_pool);
+        }
+
+        /// Call operator called by std::unique_ptr<T> when
+        /// de-allocating the object.
+        void operator()(value_type* value)
+        {
+            assert(m_pool);
+            m_pool->push(m_pool->index(value));
+        }
+
+        // Pointer to the mapping needed for recycling
+        segment* m_pool = nullptr;
+    };
+
+private:
+    /// The mapping of the segment
+    std::unique_ptr<segment> m_segment;
+};
+
+template <class Value>
+constexpr std::size_t shared_memory_pool<Value>::cache_line;
+
+template <class Value>
+constexpr char shared_memory_pool<Value>::magic[8];
+
+template <class Value>
+constexpr typename shared_memory_pool<Value>::index_type
+    shared_memory_pool<Value>::npos;
+}
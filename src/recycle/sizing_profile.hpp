@@ -0,0 +1,471 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <locale>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "demand_tracker.hpp"
+
+namespace recycle
+{
+/// @brief The sizing learned for a pool, kept across restarts.
+///
+/// See profile_store for saving and loading the profiles of a number of
+/// pools.
+struct sizing_profile
+{
+    /// @return The largest number of size classes, class i holds the
+    ///         resources of [2^i, 2^(i+1)) bytes
+    static constexpr std::size_t max_size_classes()
+    {
+        return std::numeric_limits<std::size_t>::digits;
+    }
+
+    /// The peak number of resources in use
+    double m_peak = 0.0;
+
+    /// The number of unused resources to retain while no resources are
+    /// in use, i.e. the number to prewarm the pool with
+    std::size_t m_recommended_unused = 0;
+
+    /// The histogram of the sizes of the unused resources, see
+    /// unique_pool::size_classes(). Holds at most max_size_classes()
+    /// classes.
+    std::vector<std::size_t> m_size_classes;
+};
+
+/// @return The peak learned by the demand_tracker
+template <class Pool>
+double observed_peak(const Pool&, const demand_tracker& tracker)
+{
+    return tracker.peak();
+}
+
+/// @return The unused resources, the best guess without a demand_tracker
+template <class Pool, class Observer>
+double observed_peak(const Pool& pool, const Observer&)
+{
+    return static_cast<double>(pool.unused_resources());
+}
+
+/// Seeds the demand_tracker with the peak of a saved profile
+inline void seed_peak(demand_tracker& tracker, double peak)
+{
+    tracker.set_peak(peak);
+}
+
+/// Other observers do not learn the demand
+template <class Observer>
+void seed_peak(Observer&, double)
+{
+}
+
+/// Captures the sizing profile of a pool, typically at shutdown. If the
+/// pool uses the demand_tracker as observer the peak is the one learned
+/// by the tracker, otherwise the number of unused resources of the pool.
+/// @param pool The pool, e.g. a shared_pool or unique_pool
+/// @return The profile of the pool
+template <class Pool>
+sizing_profile capture_profile(const Pool& pool)
+{
+    sizing_profile profile;
+    profile.m_peak = observed_peak(pool, pool.observer());
+    profile.m_recommended_unused =
+        static_cast<std::size_t>(std::round(profile.m_peak));
+    profile.m_size_classes = pool.size_classes();
+    return profile;
+}
+
+/// Applies a saved sizing profile to a pool, typically at startup. The
+/// pool is prewarmed with the recommended number of unused resources and
+/// a demand_tracker observer is seeded with the saved peak, so it does
+/// not shrink the pool again before it has seen the actual demand.
+/// @param pool The pool, e.g. a shared_pool or unique_pool
+/// @param profile The profile saved by a previous run
+/// @return The number of resources created
+template <class Pool>
+std::size_t apply_profile(Pool& pool, const sizing_profile& profile)
+{
+    seed_peak(pool.observer(), profile.m_peak);
+    return pool.prewarm(profile.m_recommended_unused);
+}
+
+/// Applies a saved sizing profile to a pool like apply_profile(Pool&,
+/// const sizing_profile&), but creates the resources according to the
+/// size class histogram of the profile. For every size class i, the
+/// size aware allocate function is called with the largest size of the
+/// class, 2^(i+1) - 1 bytes, as many times as the class was counted,
+/// largest classes first, until the pool holds
+/// the recommended number of unused resources. If the histogram holds
+/// fewer resources, the rest are created with the allocate function of
+/// the pool.
+/// @param pool The pool, e.g. a shared_pool or unique_pool
+/// @param profile The profile saved by a previous run
+/// @param allocate Called with a size in bytes, returns a new resource
+///        retaining at least that many bytes, e.g. a buffer with that
+///        capacity reserved
+/// @return The number of resources created
+template <class Pool, class SizedAllocate>
+std::size_t apply_profile(Pool& pool, const sizing_profile& profile,
+                          SizedAllocate allocate)
+{
+    assert(profile.m_size_classes.size() <=
+           sizing_profile::max_size_classes());
+
+    seed_peak(pool.observer(), profile.m_peak);
+
+    std::size_t target = profile.m_recommended_unused;
+    std::size_t created = 0;
+
+    for (std::size_t i = profile.m_size_classes.size(); i > 0; --i)
+    {
+        std::size_t unused = pool.unused_resources();
+
+        if (unused >= target)
+        {
+            return created;
+        }
+
+        std::size_t count = std::min(profile.m_size_classes[i - 1],
+                                     target - unused);
+        // The largest size of class i - 1, so the resources need not
+        // grow again when they are first used
+        std::size_t bytes = std::numeric_limits<std::size_t>::max() >>
+                            (sizing_profile::max_size_classes() - i);
+
+        std::size_t prewarmed = pool.prewarm(
+            unused + count, [&allocate, bytes]() { return allocate(bytes); });
+        created += prewarmed;
+
+        // The byte budget is exhausted
+        if (prewarmed < count)
+        {
+            return created;
+        }
+    }
+
+    return created + pool.prewarm(target);
+}
+
+/// @brief Stores the sizing profiles of a number of pools by name.
+///
+/// After a restart the pools of a service start out empty, and the first
+/// requests pay for constructing every resource. The store keeps the
+/// profiles learned by the previous run in a small text file with a
+/// section per pool, so the pools can be prewarmed at startup:
+///
+///     [buffers]
+///     peak = 112.5
+///     recommended_unused = 113
+///     size_classes = 0 0 0 0 0 0 0 0 0 0 0 0 113
+///
+/// The values may be edited by hand. Unknown keys and malformed lines,
+/// e.g. a histogram with more than sizing_profile::max_size_classes()
+/// classes, are ignored when loading, since a profile is only a hint.
+///
+/// Example:
+///
+///     recycle::profile_store store;
+///     store.load("/var/lib/my_app/pools.profile");
+///     store.restore("buffers", buffer_pool);
+///
+///     ...
+///
+///     store.capture("buffers", buffer_pool);
+///     store.save("/var/lib/my_app/pools.profile");
+///
+/// The names are the ones used to register the pools with the
+/// pool_registry. The store is not thread safe.
+class profile_store
+{
+public:
+    /// Set the profile of a pool
+    /// @param name The name of the pool, without newlines or brackets
+    /// @param profile The profile of the pool
+    void set(const std::string& name, sizing_profile profile)
+    {
+        assert(!name.empty());
+        assert(name.find_first_of("[]\n") == std::string::npos);
+        assert(profile.m_size_classes.size() <=
+               sizing_profile::max_size_classes());
+
+        m_profiles[name] = std::move(profile);
+    }
+
+    /// @param name The name of the pool
+    /// @return The profile of the pool or nullptr if there is none
+    const sizing_profile* find(const std::string& name) const
+    {
+        auto it = m_profiles.find(name);
+        return it == m_profiles.end() ? nullptr : &it->second;
+    }
+
+    /// @return The number of profiles in the store
+    std::size_t size() const
+    {
+        return m_profiles.size();
+    }
+
+    /// Removes all profiles
+    void clear()
+    {
+        m_profiles.clear();
+    }
+
+    /// Captures the profile of a pool, see capture_profile()
+    /// @param name The name of the pool
+    /// @param pool The pool
+    template <class Pool>
+    void capture(const std::string& name, const Pool& pool)
+    {
+        set(name, capture_profile(pool));
+    }
+
+    /// Prewarms a pool from its profile, see apply_profile()
+    /// @param name The name of the pool
+    /// @param pool The pool
+    /// @return The number of resources created, zero if the store has
+    ///         no profile for the pool
+    template <class Pool>
+    std::size_t restore(const std::string& name, Pool& pool) const
+    {
+        const sizing_profile* profile = find(name);
+
+        if (profile == nullptr)
+        {
+            return 0;
+        }
+
+        return apply_profile(pool, *profile);
+    }
+
+    /// Prewarms a pool from its profile per size class, see
+    /// apply_profile(Pool&, const sizing_profile&, SizedAllocate)
+    /// @param name The name of the pool
+    /// @param pool The pool
+    /// @param allocate Called with a size in bytes, returns a new resource
+    ///        retaining at least that many bytes
+    /// @return The number of resources created, zero if the store has
+    ///         no profile for the pool
+    template <class Pool, class SizedAllocate>
+    std::size_t restore(const std::string& name, Pool& pool,
+                        SizedAllocate allocate) const
+    {
+        const sizing_profile* profile = find(name);
+
+        if (profile == nullptr)
+        {
+            return 0;
+        }
+
+        return apply_profile(pool, *profile, std::move(allocate));
+    }
+
+    /// Writes the profiles to a file. The profiles are written to a
+    /// temporary file, which is flushed to disk before it atomically
+    /// replaces the file, so a crash while saving never leaves a
+    /// truncated profile.
+    /// @param path The path of the file
+    /// @return True if the file was written
+    bool save(const std::string& path) const
+    {
+        std::string temporary = path + ".tmp";
+
+        {
+            std::ofstream file(temporary, std::ios::trunc);
+            file.imbue(std::locale::classic());
+            file.precision(17);
+
+            for (const auto& p : m_profiles)
+            {
+                const sizing_profile& profile = p.second;
+
+                file << "[" << p.first << "]\n";
+                file << "peak = " << profile.m_peak << "\n";
+                file << "recommended_unused = " << profile.m_recommended_unused
+                     << "\n";
+                file << "size_classes =";
+
+                for (std::size_t count : profile.m_size_classes)
+                {
+                    file << " " << count;
+                }
+
+                file << "\n\n";
+            }
+
+            file.flush();
+
+            if (!file)
+            {
+                std::remove(temporary.c_str());
+                return false;
+            }
+        }
+
+        if (!sync(temporary) ||
+            std::rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            std::remove(temporary.c_str());
+            return false;
+        }
+
+        return true;
+    }
+
+    /// Reads the profiles from a file, replacing profiles of the same
+    /// name already in the store.
+    /// @param path The path of the file
+    /// @return False if the file could not be read, e.g. on the first
+    ///         start
+    bool load(const std::string& path)
+    {
+        std::ifstream file(path);
+
+        if (!file)
+        {
+            return false;
+        }
+
+        sizing_profile* profile = nullptr;
+        std::string line;
+
+        while (std::getline(file, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+
+            if (line.size() > 2 && line.front() == '[' && line.back() == ']')
+            {
+                std::string name = line.substr(1, line.size() - 2);
+                profile = &m_profiles[name];
+                *profile = sizing_profile();
+                continue;
+            }
+
+            std::size_t equals = line.find('=');
+
+            if (profile == nullptr || equals == std::string::npos)
+            {
+                continue;
+            }
+
+            std::string key = trim(line.substr(0, equals));
+            std::istringstream value(line.substr(equals + 1));
+            value.imbue(std::locale::classic());
+
+            if (key == "peak")
+            {
+                double peak = 0.0;
+                if (value >> peak && peak >= 0.0)
+                {
+                    profile->m_peak = peak;
+                }
+            }
+            else if (key == "recommended_unused")
+            {
+                std::size_t unused = 0;
+                if (read_count(value, unused))
+                {
+                    profile->m_recommended_unused = unused;
+                }
+            }
+            else if (key == "size_classes")
+            {
+                std::vector<std::size_t> classes;
+                std::size_t count = 0;
+
+                while (read_count(value, count))
+                {
+                    classes.push_back(count);
+                }
+
+                if (classes.size() <= sizing_profile::max_size_classes())
+                {
+                    profile->m_size_classes = std::move(classes);
+                }
+            }
+        }
+
+        return true;
+    }
+
+private:
+    /// Flushes the file to disk, otherwise the rename may reach the disk
+    /// before the content. On platforms without fsync() the file is only
+    /// flushed by the stream.
+    /// @return True if the file was flushed
+    static bool sync(const std::string& path)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(path.c_str(), O_WRONLY);
+
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        bool synced = ::fsync(fd) == 0;
+        return ::close(fd) == 0 && synced;
+#else
+        (void)path;
+        return true;
+#endif
+    }
+
+    /// Reads a non-negative number, the stream operator would wrap
+    /// negative numbers around
+    /// @return True if a number was read
+    static bool read_count(std::istream& in, std::size_t& count)
+    {
+        std::string token;
+
+        if (!(in >> token) ||
+            token.find_first_not_of("0123456789") != std::string::npos)
+        {
+            return false;
+        }
+
+        std::istringstream digits(token);
+        return static_cast<bool>(digits >> count);
+    }
+
+    /// @return The string without leading and trailing whitespace
+    static std::string trim(const std::string& text)
+    {
+        std::size_t first = text.find_first_not_of(" \t");
+
+        if (first == std::string::npos)
+        {
+            return std::string();
+        }
+
+        std::size_t last = text.find_last_not_of(" \t");
+        return text.substr(first, last - first + 1);
+    }
+
+private:
+    /// The profiles by pool name
+    std::map<std::string, sizing_profile> m_profiles;
+};
+}
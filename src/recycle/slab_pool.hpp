@@ -0,0 +1,557 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "heap_arena.hpp"
+#include "no_locking_policy.hpp"
+
+namespace recycle
+{
+/// @brief The slab_pool stores its values in slabs of contiguous memory.
+///
+/// Instead of allocating every value on its own, the pool allocates a
+/// slab holding a number of values at once and hands out the values of
+/// the slab. Slabs whose values are all unused are deallocated by
+/// free_unused().
+///
+/// Values which are trivially default constructible, trivially copyable
+/// and trivially destructible, e.g. POD packet headers, take a fast path
+/// selected at compile time:
+///
+///   - No constructor is run, the values of a new slab are handed out
+///     as the arena provided them.
+///   - Destructors are never called, so free_unused() releases the slabs
+///     in bulk without a destructor loop.
+///   - Values are zeroed with memset only if requested with
+///     set_zero_on_recycle(). New slabs are then zeroed with a single
+///     memset and released values one by one, otherwise values are
+///     handed out again as they were.
+///
+/// A value with default member initializers is not trivially default
+/// constructible and therefore never takes the fast path.
+///
+/// Other values are default constructed the first time their slot is
+/// used and destroyed by free_unused().
+///
+/// The memory of the slabs is provided by the Arena, by default the
+/// heap_arena. The mmap_arena reserves the memory with mmap instead,
+/// optionally backed by huge pages and pre-faulted.
+///
+/// As for the local_pool, the pool state is kept alive by the resources
+/// handed out, so the pool may die before its resources.
+template <class Value, class LockingPolicy = no_locking_policy,
+          class Arena = heap_arena>
+class slab_pool
+{
+private:
+    /// Forward declare
+    struct deleter;
+    struct impl;
+
+public:
+    /// The type managed
+    using value_type = Value;
+
+    /// The pointer to the resource
+    using pool_ptr = std::unique_ptr<value_type, deleter>;
+
+    /// The locking policy mutex type
+    using mutex_type = typename LockingPolicy::mutex_type;
+
+    /// The locking policy lock type
+    using lock_type = typename LockingPolicy::lock_type;
+
+    /// The arena providing the memory of the slabs
+    using arena_type = Arena;
+
+    /// True if the values take the trivial fast path
+    static constexpr bool is_trivial =
+        std::is_trivially_default_constructible<Value>::value &&
+        std::is_trivially_copyable<Value>::value &&
+        std::is_trivially_destructible<Value>::value;
+
+    /// The default number of values in a slab
+    static constexpr std::size_t default_slab_capacity = 64;
+
+public:
+    /// Create a slab_pool
+    /// @param slab_capacity The number of values in each slab
+    /// @param arena The arena providing the memory of the slabs
+    explicit slab_pool(std::size_t slab_capacity = default_slab_capacity,
+                       arena_type arena = arena_type()) :
+        m_pool(new impl(slab_capacity, std::move(arena)))
+    {
+    }
+
+    /// The pool is not copyable
+    slab_pool(const slab_pool&) = delete;
+
+    /// The pool is not copyable
+    slab_pool& operator=(const slab_pool&) = delete;
+
+    /// Move constructor
+    slab_pool(slab_pool&& other) : m_pool(other.m_pool)
+    {
+        assert(m_pool);
+        other.m_pool = nullptr;
+    }
+
+    /// Move assignment
+    slab_pool& operator=(slab_pool&& other)
+    {
+        std::swap(m_pool, other.m_pool);
+        return *this;
+    }
+
+    /// Destructor
+    ~slab_pool()
+    {
+        if (m_pool)
+        {
+            m_pool->close();
+        }
+    }
+
+    /// Zero the memory of new slabs and of released values before they
+    /// are handed out. Only available for trivial values.
+    /// @param zero True to zero the values
+    void set_zero_on_recycle(bool zero)
+    {
+        static_assert(is_trivial, "Only trivial values can be zeroed");
+
+        assert(m_pool);
+        m_pool->set_zero_on_recycle(zero);
+    }
+
+    /// @returns the number of unused resources. For trivial values this
+    ///          includes the values of a slab not handed out yet.
+    std::size_t unused_resources() const
+    {
+        assert(m_pool);
+        return m_pool->unused_resources();
+    }
+
+    /// @returns the number of slabs allocated
+    std::size_t slabs() const
+    {
+        assert(m_pool);
+        return m_pool->slabs();
+    }
+
+    /// @returns the number of values in each slab
+    std::size_t slab_capacity() const
+    {
+        assert(m_pool);
+        return m_pool->slab_capacity();
+    }
+
+    /// Frees all unused resources and deallocates the slabs which are
+    /// no longer in use
+    void free_unused()
+    {
+        assert(m_pool);
+        m_pool->free_unused();
+    }
+
+    /// @return A resource from the pool.
+    pool_ptr allocate()
+    {
+        assert(m_pool);
+        return m_pool->allocate();
+    }
+
+    /// @return The mutex of the pool, e.g. to read the statistics of the
+    ///         instrumented_locking_policy
+    mutex_type& mutex()
+    {
+        assert(m_pool);
+        return m_pool->mutex();
+    }
+
+    /// @return The mutex of the pool, e.g. to read the statistics of the
+    ///         instrumented_locking_policy
+    const mutex_type& mutex() const
+    {
+        assert(m_pool);
+        return m_pool->mutex();
+    }
+
+private:
+    /// Selects the fast path at compile time
+    using trivial_tag = std::integral_constant<bool, is_trivial>;
+
+    /// The actual pool implementation. It is owned by the slab_pool
+    /// together with all the resources currently handed out, and is
+    /// deleted when the pool has been closed and the last outstanding
+    /// resource has been released.
+    struct impl
+    {
+        impl(std::size_t slab_capacity, arena_type arena) :
+            m_slab_capacity(slab_capacity), m_arena(std::move(arena))
+        {
+            static_assert(alignof(value_type) <= alignof(std::max_align_t),
+                          "Over-aligned values are not supported");
+
+            assert(m_slab_capacity > 0);
+        }
+
+        ~impl()
+        {
+            destroy(m_unused, trivial_tag());
+
+            for (value_type* slab : m_slabs)
+            {
+                deallocate_slab(slab);
+            }
+        }
+
+        /// Allocate a new value from the pool
+        pool_ptr allocate()
+        {
+            value_type* value = nullptr;
+
+            {
+                lock_type lock(m_mutex);
+
+                if (m_unused.empty() && m_raw.empty())
+                {
+                    add_slab(trivial_tag());
+                }
+
+                ++m_outstanding;
+
+                if (!m_unused.empty())
+                {
+                    value = m_unused.back();
+                    m_unused.pop_back();
+                    return pool_ptr(value, deleter(this));
+                }
+
+                value = m_raw.back();
+                m_raw.pop_back();
+            }
+
+            // Construct the value outside the lock, the slot is ours
+            construct(value);
+            return pool_ptr(value, deleter(this));
+        }
+
+        /// @copydoc slab_pool::set_zero_on_recycle()
+        void set_zero_on_recycle(bool zero)
+        {
+            lock_type lock(m_mutex);
+            m_zero_on_recycle = zero;
+        }
+
+        /// @copydoc slab_pool::unused_resources()
+        std::size_t unused_resources() const
+        {
+            lock_type lock(m_mutex);
+            return m_unused.size();
+        }
+
+        /// @copydoc slab_pool::slabs()
+        std::size_t slabs() const
+        {
+            lock_type lock(m_mutex);
+            return m_slabs.size();
+        }
+
+        /// @copydoc slab_pool::slab_capacity()
+        std::size_t slab_capacity() const
+        {
+            return m_slab_capacity;
+        }
+
+        /// @copydoc slab_pool::free_unused()
+        void free_unused()
+        {
+            lock_type lock(m_mutex);
+            free_unused(trivial_tag());
+        }
+
+        /// @copydoc slab_pool::mutex()
+        mutex_type& mutex() const
+        {
+            return m_mutex;
+        }
+
+        /// This function called when a resource has been released by
+        /// its pool_ptr
+        void release(value_type* value)
+        {
+            bool last = false;
+
+            {
+                lock_type lock(m_mutex);
+
+                assert(m_outstanding > 0);
+                --m_outstanding;
+
+                recycle(value, trivial_tag());
+                m_unused.push_back(value);
+
+                last = !m_open && m_outstanding == 0;
+            }
+
+            if (last)
+            {
+                delete this;
+            }
+        }
+
+        /// Called when the owning slab_pool is destroyed
+        void close()
+        {
+            bool last = false;
+
+            {
+                lock_type lock(m_mutex);
+                m_open = false;
+                last = m_outstanding == 0;
+            }
+
+            if (last)
+            {
+                delete this;
+            }
+        }
+
+    private:
+        /// Adds the values of a new slab, zeroed only if requested
+        void add_slab(std::true_type)
+        {
+            value_type* slab = allocate_slab();
+
+            if (m_zero_on_recycle)
+            {
+                std::memset(static_cast<void*>(slab), 0, slab_bytes());
+            }
+
+            for (std::size_t i = m_slab_capacity; i > 0; --i)
+            {
+                m_unused.push_back(slab + i - 1);
+            }
+        }
+
+        /// Adds the slots of a new slab, they are constructed when used
+        void add_slab(std::false_type)
+        {
+            value_type* slab = allocate_slab();
+
+            for (std::size_t i = m_slab_capacity; i > 0; --i)
+            {
+                m_raw.push_back(slab + i - 1);
+            }
+        }
+
+        void construct(value_type* value)
+        {
+            try
+            {
+                new (value) value_type();
+            }
+            catch (...)
+            {
+                lock_type lock(m_mutex);
+                --m_outstanding;
+                m_raw.push_back(value);
+                throw;
+            }
+        }
+
+        void recycle(value_type* value, std::true_type)
+        {
+            if (m_zero_on_recycle)
+            {
+                std::memset(static_cast<void*>(value), 0, sizeof(value_type));
+            }
+        }
+
+        void recycle(value_type*, std::false_type)
+        {
+        }
+
+        /// Trivial values need no destructor calls
+        void destroy(std::vector<value_type*>&, std::true_type)
+        {
+        }
+
+        void destroy(std::vector<value_type*>& values, std::false_type)
+        {
+            for (value_type* value : values)
+            {
+                value->~value_type();
+            }
+        }
+
+        void free_unused(std::true_type)
+        {
+            if (m_outstanding == 0)
+            {
+                // Nothing is in use, release all slabs in bulk
+                for (value_type* slab : m_slabs)
+                {
+                    deallocate_slab(slab);
+                }
+
+                m_slabs.clear();
+                m_unused.clear();
+                return;
+            }
+
+            release_empty_slabs(m_unused);
+        }
+
+        void free_unused(std::false_type)
+        {
+            destroy(m_unused, std::false_type());
+            m_raw.insert(m_raw.end(), m_unused.begin(), m_unused.end());
+            m_unused.clear();
+
+            release_empty_slabs(m_raw);
+        }
+
+        /// Deallocates the slabs whose slots are all in the free list
+        /// and removes their slots from it
+        void release_empty_slabs(std::vector<value_type*>& free)
+        {
+            std::less<value_type*> less;
+            std::sort(free.begin(), free.end(), less);
+            std::sort(m_slabs.begin(), m_slabs.end(), less);
+
+            std::vector<value_type*> keep_free;
+            std::vector<value_type*> keep_slabs;
+
+            auto slot = free.begin();
+
+            for (value_type* slab : m_slabs)
+            {
+                auto first = std::lower_bound(slot, free.end(), slab, less);
+                auto last = std::lower_bound(first, free.end(),
+                                             slab + m_slab_capacity, less);
+
+                keep_free.insert(keep_free.end(), slot, first);
+
+                if (static_cast<std::size_t>(last - first) == m_slab_capacity)
+                {
+                    deallocate_slab(slab);
+                }
+                else
+                {
+                    keep_free.insert(keep_free.end(), first, last);
+                    keep_slabs.push_back(slab);
+                }
+
+                slot = last;
+            }
+
+            keep_free.insert(keep_free.end(), slot, free.end());
+
+            free.swap(keep_free);
+            m_slabs.swap(keep_slabs);
+        }
+
+        value_type* allocate_slab()
+        {
+            void* memory = m_arena.allocate(slab_bytes());
+
+            value_type* slab = static_cast<value_type*>(memory);
+
+            try
+            {
+                m_slabs.push_back(slab);
+            }
+            catch (...)
+            {
+                m_arena.deallocate(memory, slab_bytes());
+                throw;
+            }
+
+            return slab;
+        }
+
+        void deallocate_slab(value_type* slab)
+        {
+            m_arena.deallocate(static_cast<void*>(slab), slab_bytes());
+        }
+
+        std::size_t slab_bytes() const
+        {
+            return m_slab_capacity * sizeof(value_type);
+        }
+
+    private:
+        /// The number of values in each slab
+        std::size_t m_slab_capacity;
+
+        /// The arena providing the memory of the slabs
+        arena_type m_arena;
+
+        /// The slabs allocated
+        std::vector<value_type*> m_slabs;
+
+        /// The unused values, ready to be handed out
+        std::vector<value_type*> m_unused;
+
+        /// The slots without a constructed value, only used for values
+        /// which are not trivial
+        std::vector<value_type*> m_raw;
+
+        /// The number of resources handed out and not yet released
+        std::size_t m_outstanding = 0;
+
+        /// True if new and released trivial values are zeroed
+        bool m_zero_on_recycle = false;
+
+        /// True as long as the owning slab_pool is alive
+        bool m_open = true;
+
+        /// Mutex used to coordinate access to the pool
+        mutable mutex_type m_mutex;
+    };
+
+    /// The custom deleter object used by the std::unique_ptr<T>
+    struct deleter
+    {
+        /// Constructor
+        deleter() = default;
+
+        /// @param pool The pool state
+        deleter(impl* pool) : m_pool(pool)
+        {
+            assert(m_pool);
+        }
+
+        /// Call operator called by std::unique_ptr<T> when
+        /// de-allocating the object.
+        void operator()(value_type* value)
+        {
+            assert(m_pool);
+            m_pool->release(value);
+        }
+
+        // Pointer to the pool needed for recycling
+        impl* m_pool = nullptr;
+    };
+
+private:
+    // The pool impl
+    impl* m_pool;
+};
+}
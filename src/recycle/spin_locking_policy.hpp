@@ -0,0 +1,91 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#include "cpu_relax.hpp"
+
+namespace recycle
+{
+/// Locking policy using a test-and-test-and-set spinlock.
+///
+/// The critical sections of the pools are only a few instructions long,
+/// so a waiting thread is usually better off spinning than going to
+/// sleep. While the lock is held the waiting threads only read it, which
+/// keeps the cache line shared, and back off exponentially using
+/// cpu_relax().
+///
+/// The spinlock never sleeps, so it should not be used when the number
+/// of threads contending for a pool exceeds the number of cores. The
+/// adaptive_locking_policy is a better fit in that case.
+struct spin_locking_policy
+{
+    /// The spinlock
+    class spin_mutex
+    {
+    public:
+        /// Creates the mutex in unlocked state
+        spin_mutex() = default;
+
+        /// The mutex is not copyable
+        spin_mutex(const spin_mutex&) = delete;
+
+        /// The mutex is not copyable
+        spin_mutex& operator=(const spin_mutex&) = delete;
+
+        /// Acquires the lock, spinning until it is available
+        void lock()
+        {
+            uint32_t backoff = 1;
+
+            while (m_locked.exchange(true, std::memory_order_acquire))
+            {
+                while (m_locked.load(std::memory_order_relaxed))
+                {
+                    for (uint32_t i = 0; i < backoff; ++i)
+                    {
+                        cpu_relax();
+                    }
+
+                    if (backoff < max_backoff)
+                    {
+                        backoff *= 2;
+                    }
+                }
+            }
+        }
+
+        /// @return True if the lock was acquired
+        bool try_lock()
+        {
+            return !m_locked.load(std::memory_order_relaxed) &&
+                   !m_locked.exchange(true, std::memory_order_acquire);
+        }
+
+        /// Releases the lock
+        void unlock()
+        {
+            m_locked.store(false, std::memory_order_release);
+        }
+
+    private:
+        /// The maximum number of cpu_relax() between two reads of the lock
+        static constexpr uint32_t max_backoff = 64;
+
+        /// True while the lock is held
+        std::atomic<bool> m_locked{false};
+    };
+
+    /// The locking policy mutex type
+    using mutex_type = spin_mutex;
+
+    /// The locking policy lock type
+    using lock_type = std::lock_guard<mutex_type>;
+};
+}
@@ -0,0 +1,231 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+#include "bit_operations.hpp"
+
+namespace recycle
+{
+/// @brief The static_pool is a fixed capacity pool which never allocates
+///        memory on the heap.
+///
+/// The pool stores its N values inline in aligned storage, so it can live
+/// on the stack, in a global or as a member of another object. Free slots
+/// are tracked in a bitmap, and the resources are handed out as a
+/// std::unique_ptr whose deleter only holds a pointer to the pool. No
+/// std::function, std::shared_ptr or list nodes are involved, so neither
+/// allocate() nor releasing a resource touches the heap.
+///
+/// The values are default constructed the first time their slot is
+/// used and are kept constructed while unused, like the unused resources
+/// of the other pools. Slots holding a constructed value are reused
+/// before untouched slots. When all N slots are in use, allocate()
+/// returns an empty pool_ptr.
+///
+/// The pool must outlive the resources it hands out, and it is neither
+/// copyable nor movable since the resources point into it. The pool is
+/// not thread safe.
+template <class Value, std::size_t N>
+class static_pool
+{
+private:
+    /// Forward declare
+    struct deleter;
+
+    static_assert(N > 0, "The pool must have at least one slot");
+
+public:
+    /// The type managed
+    using value_type = Value;
+
+    /// The pointer to the resource
+    using pool_ptr = std::unique_ptr<value_type, deleter>;
+
+    /// The number of slots
+    static constexpr std::size_t capacity = N;
+
+public:
+    /// Default constructor, all slots are free
+    static_pool()
+    {
+        static_assert(std::is_default_constructible<Value>::value,
+                      "The value type must be default constructible");
+
+        for (std::size_t i = 0; i < words; ++i)
+        {
+            m_free[i] = ~uint64_t{0};
+            m_constructed[i] = 0;
+        }
+
+        // Clear the bits beyond the last slot
+        if (N % 64 != 0)
+        {
+            m_free[words - 1] = (uint64_t{1} << (N % 64)) - 1;
+        }
+    }
+
+    /// The pool is not copyable
+    static_pool(const static_pool&) = delete;
+
+    /// The pool is not copyable
+    static_pool& operator=(const static_pool&) = delete;
+
+    /// Destructor, destroys the constructed values
+    ~static_pool()
+    {
+        assert(in_use() == 0 && "The pool must outlive its resources");
+        free_unused();
+    }
+
+    /// @return A resource from the pool or an empty pool_ptr if all
+    ///         slots are in use
+    pool_ptr allocate()
+    {
+        // Prefer slots with a constructed value
+        for (std::size_t i = 0; i < words; ++i)
+        {
+            uint64_t candidates = m_free[i] & m_constructed[i];
+
+            if (candidates != 0)
+            {
+                return take(i, count_trailing_zeros(candidates));
+            }
+        }
+
+        for (std::size_t i = 0; i < words; ++i)
+        {
+            if (m_free[i] != 0)
+            {
+                uint32_t bit = count_trailing_zeros(m_free[i]);
+
+                new (slot(i * 64 + bit)) value_type();
+                m_constructed[i] |= uint64_t{1} << bit;
+
+                return take(i, bit);
+            }
+        }
+
+        return pool_ptr();
+    }
+
+    /// @returns the number of unused resources, i.e. free slots holding
+    ///          a constructed value
+    std::size_t unused_resources() const
+    {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < words; ++i)
+        {
+            count += popcount(m_free[i] & m_constructed[i]);
+        }
+
+        return count;
+    }
+
+    /// @returns the number of resources currently in use
+    std::size_t in_use() const
+    {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i < words; ++i)
+        {
+            count += popcount(m_constructed[i] & ~m_free[i]);
+        }
+
+        return count;
+    }
+
+    /// Destroys all unused values, their slots stay available
+    void free_unused()
+    {
+        for (std::size_t i = 0; i < words; ++i)
+        {
+            uint64_t unused = m_free[i] & m_constructed[i];
+
+            while (unused != 0)
+            {
+                uint32_t bit = count_trailing_zeros(unused);
+                unused &= unused - 1;
+
+                slot(i * 64 + bit)->~value_type();
+                m_constructed[i] &= ~(uint64_t{1} << bit);
+            }
+        }
+    }
+
+private:
+    /// Marks a slot as in use and hands out its value
+    pool_ptr take(std::size_t word, uint32_t bit)
+    {
+        m_free[word] &= ~(uint64_t{1} << bit);
+        return pool_ptr(slot(word * 64 + bit), deleter(this));
+    }
+
+    /// Called by the deleter when a resource is released
+    void release(value_type* value)
+    {
+        std::size_t index = static_cast<std::size_t>(
+            reinterpret_cast<storage_type*>(value) - m_storage);
+        assert(index < N);
+
+        uint64_t mask = uint64_t{1} << (index % 64);
+        assert((m_free[index / 64] & mask) == 0);
+
+        m_free[index / 64] |= mask;
+    }
+
+    value_type* slot(std::size_t index)
+    {
+        assert(index < N);
+        return reinterpret_cast<value_type*>(&m_storage[index]);
+    }
+
+    /// The custom deleter object used by the std::unique_ptr<T>
+    struct deleter
+    {
+        /// Constructor
+        deleter() = default;
+
+        /// @param pool The pool the resource belongs to
+        deleter(static_pool* pool) : m_pool(pool)
+        {
+            assert(m_pool);
+        }
+
+        /// Call operator called by std::unique_ptr<T> when
+        /// de-allocating the object.
+        void operator()(value_type* value)
+        {
+            assert(m_pool);
+            m_pool->release(value);
+        }
+
+        /// The pool the resource belongs to
+        static_pool* m_pool = nullptr;
+    };
+
+private:
+    /// The storage of a single value
+    using storage_type =
+        typename std::aligned_storage<sizeof(Value), alignof(Value)>::type;
+
+    /// The number of 64 bit words in the bitmaps
+    static constexpr std::size_t words = (N + 63) / 64;
+
+    /// The values
+    storage_type m_storage[N];
+
+    /// Bit i is set if slot i is free
+    uint64_t m_free[words];
+
+    /// Bit i is set if slot i holds a constructed value
+    uint64_t m_constructed[words];
+};
+}
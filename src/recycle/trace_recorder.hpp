@@ -0,0 +1,433 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace recycle
+{
+/// The events recorded in a trace
+enum class trace_event_type : uint8_t
+{
+    /// A resource was handed out, the value is the unused resources left
+    allocate = 1,
+
+    /// The pool had no unused resource and called the allocate function
+    miss = 2,
+
+    /// A resource was released, the value is the unused resources after
+    release = 3,
+
+    /// Unused resources were freed, the value is the number freed
+    free_unused = 4
+};
+
+/// An event as stored in the trace file
+struct trace_event
+{
+    /// The position of the event in the trace plus one, zero if the slot
+    /// has not been written
+    uint64_t m_sequence;
+
+    /// The time of the event in nanoseconds since the trace was created
+    uint64_t m_time;
+
+    /// The thread which caused the event, see trace_thread_id()
+    uint32_t m_thread;
+
+    /// The pool id given to trace_recorder::attach()
+    uint32_t m_pool;
+
+    /// The value of the event, see trace_event_type
+    uint32_t m_value;
+
+    /// The type of the event
+    trace_event_type m_type;
+
+    /// Padding, always zero
+    uint8_t m_reserved[3];
+};
+
+static_assert(sizeof(trace_event) == 32, "The file format needs 32 bytes");
+
+/// The header at the start of the trace file
+struct trace_header
+{
+    /// The magic bytes identifying a trace file
+    char m_magic[8];
+
+    /// The version of the file format
+    uint32_t m_version;
+
+    /// The size of an event, for sanity checking
+    uint32_t m_event_size;
+
+    /// The number of events in the ring, a power of two
+    uint64_t m_capacity;
+
+    /// The number of events recorded, the next position in the ring
+    std::atomic<uint64_t> m_next;
+
+    /// Reserved for future use, always zero
+    uint64_t m_reserved[4];
+};
+
+static_assert(sizeof(trace_header) == 64, "The file format needs 64 bytes");
+
+/// The magic bytes at the start of a trace file
+static const char trace_magic[8] = {'R', 'C', 'Y', 'T', 'R', 'A', 'C', 'E'};
+
+/// The version of the trace file format
+static const uint32_t trace_version = 1;
+
+/// @return A small id of the calling thread. Threads are numbered in the
+///         order in which they first record an event.
+inline uint32_t trace_thread_id()
+{
+    static std::atomic<uint32_t> next_id{0};
+    thread_local uint32_t id = next_id.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+/// @brief Records events into a ring buffer stored in a file.
+///
+/// The file is mapped into memory, so recording an event is a single
+/// atomic increment followed by a 32 byte store, and the events written
+/// so far survive a crash of the process. When the ring is full the
+/// oldest events are overwritten, so the file keeps the most recent
+/// events and never grows.
+///
+/// The writer is thread safe and is typically shared by the
+/// trace_recorder observers of several pools.
+class trace_writer
+{
+public:
+    /// Creates or truncates the trace file
+    /// @param path The path of the file
+    /// @param capacity The number of events in the ring, rounded up to a
+    ///        power of two
+    trace_writer(const std::string& path, std::size_t capacity) :
+        m_start(std::chrono::steady_clock::now())
+    {
+        assert(capacity > 0);
+
+        std::size_t ring = 1;
+        while (ring < capacity)
+        {
+            ring <<= 1;
+        }
+
+        m_mask = ring - 1;
+        m_size = sizeof(trace_header) + ring * sizeof(trace_event);
+
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+        if (fd < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "open");
+        }
+
+        if (::ftruncate(fd, static_cast<off_t>(m_size)) != 0)
+        {
+            int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(),
+                                    "ftruncate");
+        }
+
+        void* memory = ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE,
+                              MAP_SHARED, fd, 0);
+        int error = errno;
+        ::close(fd);
+
+        if (memory == MAP_FAILED)
+        {
+            throw std::system_error(error, std::generic_category(), "mmap");
+        }
+
+        // The file is zero filled by ftruncate, so all the slots read as
+        // not written
+        m_header = new (memory) trace_header();
+        std::memcpy(m_header->m_magic, trace_magic, sizeof(trace_magic));
+        m_header->m_version = trace_version;
+        m_header->m_event_size = sizeof(trace_event);
+        m_header->m_capacity = ring;
+
+        m_events = reinterpret_cast<trace_event*>(m_header + 1);
+    }
+
+    /// The writer is not copyable
+    trace_writer(const trace_writer&) = delete;
+
+    /// The writer is not copyable
+    trace_writer& operator=(const trace_writer&) = delete;
+
+    /// Destructor, unmaps the file
+    ~trace_writer()
+    {
+        ::munmap(static_cast<void*>(m_header), m_size);
+    }
+
+    /// Records an event
+    /// @param type The type of the event
+    /// @param pool The id of the pool
+    /// @param value The value of the event
+    void record(trace_event_type type, uint32_t pool, uint64_t value)
+    {
+        auto now = std::chrono::steady_clock::now();
+        auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            now - m_start);
+
+        uint64_t index =
+            m_header->m_next.fetch_add(1, std::memory_order_relaxed);
+
+        trace_event& event = m_events[index & m_mask];
+
+        event.m_sequence = 0;
+        std::atomic_thread_fence(std::memory_order_release);
+
+        event.m_time = static_cast<uint64_t>(time.count());
+        event.m_thread = trace_thread_id();
+        event.m_pool = pool;
+        event.m_value = value > UINT32_MAX ? UINT32_MAX
+                                           : static_cast<uint32_t>(value);
+        event.m_type = type;
+
+        // The sequence is written last, a slot with the wrong sequence
+        // was overwritten or is still being written
+        std::atomic_thread_fence(std::memory_order_release);
+        event.m_sequence = index + 1;
+    }
+
+    /// @return The number of events recorded, including the ones which
+    ///         have been overwritten
+    uint64_t recorded() const
+    {
+        return m_header->m_next.load(std::memory_order_relaxed);
+    }
+
+    /// @return The number of events in the ring
+    std::size_t capacity() const
+    {
+        return m_mask + 1;
+    }
+
+private:
+    /// The time the trace was created
+    std::chrono::steady_clock::time_point m_start;
+
+    /// The mask giving the slot of an event in the ring
+    std::size_t m_mask = 0;
+
+    /// The size of the mapping
+    std::size_t m_size = 0;
+
+    /// The header at the start of the mapping
+    trace_header* m_header = nullptr;
+
+    /// The ring of events following the header
+    trace_event* m_events = nullptr;
+};
+
+/// The events read from a trace file
+struct trace_contents
+{
+    /// The events in the order they were recorded, oldest first
+    std::vector<trace_event> m_events;
+
+    /// The number of events which were overwritten or not completely
+    /// written when the file was read
+    uint64_t m_lost = 0;
+};
+
+/// Reads a trace file written by the trace_writer. The file may be read
+/// while it is still being written.
+/// @param path The path of the file
+/// @return The events of the trace
+inline trace_contents read_trace(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file)
+    {
+        throw std::runtime_error("Cannot open trace file: " + path);
+    }
+
+    trace_header header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+    if (!file || std::memcmp(header.m_magic, trace_magic,
+                             sizeof(trace_magic)) != 0)
+    {
+        throw std::runtime_error("Not a trace file: " + path);
+    }
+
+    if (header.m_version != trace_version ||
+        header.m_event_size != sizeof(trace_event) ||
+        header.m_capacity == 0 ||
+        (header.m_capacity & (header.m_capacity - 1)) != 0)
+    {
+        throw std::runtime_error("Unsupported trace file: " + path);
+    }
+
+    std::vector<trace_event> ring(header.m_capacity);
+    file.read(reinterpret_cast<char*>(ring.data()),
+              ring.size() * sizeof(trace_event));
+
+    if (!file)
+    {
+        throw std::runtime_error("Truncated trace file: " + path);
+    }
+
+    uint64_t next = header.m_next.load();
+    uint64_t first = next > ring.size() ? next - ring.size() : 0;
+
+    trace_contents contents;
+    contents.m_lost = first;
+
+    for (uint64_t index = first; index < next; ++index)
+    {
+        const trace_event& event = ring[index & (ring.size() - 1)];
+
+        if (event.m_sequence == index + 1)
+        {
+            contents.m_events.push_back(event);
+        }
+        else
+        {
+            ++contents.m_lost;
+        }
+    }
+
+    return contents;
+}
+
+/// @brief Observer policy recording the events of a pool into a trace.
+///
+/// The recorder is opt-in: until a trace_writer is attached the events
+/// cost a single branch. Several pools may share the same writer, their
+/// events are told apart by the pool id given when attaching. A copy of
+/// a pool does not record until a writer is attached to it, otherwise
+/// the events of both pools would be recorded under the same id.
+///
+/// Example:
+///
+///     auto writer = std::make_shared<recycle::trace_writer>(
+///         "/tmp/pool.trace", 1 << 20);
+///
+///     recycle::unique_pool<heavy_object, lock_policy,
+///                          recycle::trace_recorder> pool;
+///     pool.observer().attach(writer, 1);
+///
+/// The trace can be replayed against other pool configurations with the
+/// pool_simulator or the recycle_trace_replay tool.
+class trace_recorder
+{
+public:
+    /// Default constructor, not recording
+    trace_recorder() = default;
+
+    /// Copy constructor, the copy belongs to a new pool and does not
+    /// record until a writer is attached
+    trace_recorder(const trace_recorder&)
+    {
+    }
+
+    /// Copy assignment, stops recording like the copy constructor
+    trace_recorder& operator=(const trace_recorder&)
+    {
+        detach();
+        return *this;
+    }
+
+    /// Move constructor, the recording moves along with the pool
+    trace_recorder(trace_recorder&&) = default;
+
+    /// Move assignment, the recording moves along with the pool
+    trace_recorder& operator=(trace_recorder&&) = default;
+
+    /// Start recording the events of the pool. Attach before the pool is
+    /// used from several threads.
+    /// @param writer The writer to record into
+    /// @param pool The id of the pool in the trace
+    void attach(std::shared_ptr<trace_writer> writer, uint32_t pool)
+    {
+        assert(writer);
+
+        m_writer = std::move(writer);
+        m_pool = pool;
+    }
+
+    /// Stop recording the events of the pool. Like attach(), only detach
+    /// while no thread uses the pool.
+    void detach()
+    {
+        m_writer.reset();
+    }
+
+    /// @return True if a writer is attached
+    bool is_attached() const
+    {
+        return static_cast<bool>(m_writer);
+    }
+
+    /// Called when a resource has been handed out by the pool
+    void on_allocate(const void*, std::size_t unused)
+    {
+        record(trace_event_type::allocate, unused);
+    }
+
+    /// Called before the allocate function is invoked on a miss
+    void on_miss(const void*)
+    {
+        record(trace_event_type::miss, 0);
+    }
+
+    /// Called when a resource has been released back to the pool
+    void on_recycle(const void*, std::size_t unused)
+    {
+        record(trace_event_type::release, unused);
+    }
+
+    /// Called when unused resources have been freed
+    void on_free_unused(const void*, std::size_t freed)
+    {
+        record(trace_event_type::free_unused, freed);
+    }
+
+private:
+    void record(trace_event_type type, std::size_t value)
+    {
+        if (m_writer)
+        {
+            m_writer->record(type, m_pool, value);
+        }
+    }
+
+private:
+    /// The writer, empty while not recording
+    std::shared_ptr<trace_writer> m_writer;
+
+    /// The id of the pool in the trace
+    uint32_t m_pool = 0;
+};
+}
@@ -9,12 +9,16 @@
 #include <cassert>
 #include <cstdint>
 #include <functional>
+#include <limits>
 #include <list>
 #include <memory>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
+#include "growth_policy.hpp"
 #include "no_locking_policy.hpp"
+#include "no_observer.hpp"
 
 namespace recycle
 {
@@ -29,7 +33,12 @@ namespace recycle
 /// you allocate are thread safe. The default locking policy
 /// is no_locking_policy which means that the pool is not thread
 /// safe.
-template <class Value, class LockingPolicy = no_locking_policy>
+///
+/// An observer policy can be used to get notified about the events
+/// happening inside the pool, e.g. for tracing. The default observer
+/// is no_observer which does nothing and adds no overhead.
+template <class Value, class LockingPolicy = no_locking_policy,
+          class Observer = no_observer>
 class unique_pool
 {
 private:
@@ -51,19 +60,136 @@ public:
     /// Should take no arguments and return an std::unique_ptr to the Value
     using allocate_function = std::function<value_ptr()>;
 
+    /// The batch allocate function type
+    /// Should return at least one and at most the given number of newly
+    /// created resources, see set_batch_allocate_function()
+    using batch_allocate_function =
+        std::function<std::vector<value_ptr>(std::size_t)>;
+
     /// The recycle function type
     /// If specified the recycle function will be called every time a
     /// resource gets recycled into the pool. This allows temporary
     /// resources, e.g., file handles to be closed when an object is longer
-    /// used.
+    /// used. If the recycle function resets the resource, it is destroyed
+    /// instead of being put back into the pool.
     using recycle_function = std::function<void(value_ptr&)>;
 
+    /// The size function type
+    /// Should return the number of bytes of memory retained by a value.
+    /// Used to account for the memory held by the unused resources, e.g.
+    /// for a buffer this would typically be its capacity.
+    using size_function = std::function<std::size_t(const value_type&)>;
+
     /// The locking policy mutex type
     using mutex_type = typename LockingPolicy::mutex_type;
 
     /// The locking policy lock type
     using lock_type = typename LockingPolicy::lock_type;
 
+    /// The observer type
+    using observer_type = Observer;
+
+    /// @brief RAII wrapper of a resource from acquire_scoped().
+    ///
+    /// Unlike the pool_ptr it only holds plain pointers to the resource
+    /// and the pool state, so it is cheap to create and destroy but must
+    /// not outlive the pool.
+    class scoped_ptr
+    {
+    public:
+        /// Default constructor, holds no resource
+        scoped_ptr() = default;
+
+        /// @param pool The pool state
+        /// @param value The resource
+        scoped_ptr(impl* pool, value_type* value) :
+            m_pool(pool), m_value(value)
+        {
+            assert(m_pool);
+            assert(m_value);
+        }
+
+        /// The scoped_ptr is not copyable
+        scoped_ptr(const scoped_ptr&) = delete;
+
+        /// The scoped_ptr is not copyable
+        scoped_ptr& operator=(const scoped_ptr&) = delete;
+
+        /// Move constructor
+        scoped_ptr(scoped_ptr&& other) :
+            m_pool(other.m_pool), m_value(other.m_value)
+        {
+            other.m_value = nullptr;
+        }
+
+        /// Move assignment
+        scoped_ptr& operator=(scoped_ptr&& other)
+        {
+            std::swap(m_pool, other.m_pool);
+            std::swap(m_value, other.m_value);
+            return *this;
+        }
+
+        /// Destructor, releases the resource
+        ~scoped_ptr()
+        {
+            reset();
+        }
+
+        /// Releases the resource back to the pool
+        void reset()
+        {
+            if (m_value)
+            {
+                m_pool->release(m_value);
+                m_value = nullptr;
+            }
+        }
+
+        /// Gives up the ownership of the resource, which must then be
+        /// given back with unique_pool::release()
+        /// @return The resource
+        value_type* release()
+        {
+            value_type* value = m_value;
+            m_value = nullptr;
+            return value;
+        }
+
+        /// @return The resource
+        value_type* get() const
+        {
+            return m_value;
+        }
+
+        /// @return The resource
+        value_type& operator*() const
+        {
+            assert(m_value);
+            return *m_value;
+        }
+
+        /// @return The resource
+        value_type* operator->() const
+        {
+            assert(m_value);
+            return m_value;
+        }
+
+        /// @return True if a resource is held
+        explicit operator bool() const
+        {
+            return m_value != nullptr;
+        }
+
+    private:
+        /// The pool state
+        impl* m_pool = nullptr;
+
+        /// The resource
+        value_type* m_value = nullptr;
+    };
+
 public:
     /// Default constructor, we only want this to be available
     /// i.e. the unique_pool to be default constructible if the
@@ -140,6 +266,82 @@ public:
         return m_pool->unused_resources();
     }
 
+    /// @returns the number of bytes retained by the unused resources as
+    ///          reported by the size function
+    std::size_t unused_bytes() const
+    {
+        assert(m_pool);
+        return m_pool->unused_bytes();
+    }
+
+    /// @returns a histogram of the sizes of the unused resources as
+    ///          reported by the size function. Element i counts the
+    ///          resources of at least 2^i and less than 2^(i+1) bytes.
+    std::vector<std::size_t> size_classes() const
+    {
+        assert(m_pool);
+        return m_pool->size_classes();
+    }
+
+    /// Set the function used to compute the size in bytes of a resource.
+    /// By default the size of a resource is sizeof(value_type).
+    /// The size function is always called without holding the pool lock.
+    /// The unused resources are measured again with the new size function
+    /// one at a time, the others stay in the pool meanwhile.
+    /// @param size_of Size function. If used in a threaded environment
+    ///        the size function should be thread safe.
+    void set_size_function(size_function size_of)
+    {
+        assert(m_pool);
+        m_pool->set_size_function(std::move(size_of));
+    }
+
+    /// Set the function used to create a batch of resources when the
+    /// pool misses, see set_growth_policy(). Creating many resources at
+    /// once can amortize setup costs, e.g. one large allocation split
+    /// into many buffers. It is used whenever more than one resource is
+    /// needed, a single resource is always created with the allocate
+    /// function. Null resources it returns are dropped and if it returns
+    /// none, the allocate function is used instead. Without a batch
+    /// allocate function the allocate function is called once for every
+    /// resource of a batch.
+    /// @param batch_allocate Batch allocate function. If used in a
+    ///        threaded environment it should be thread safe.
+    void set_batch_allocate_function(batch_allocate_function batch_allocate)
+    {
+        assert(m_pool);
+        m_pool->set_batch_allocate_function(std::move(batch_allocate));
+    }
+
+    /// Set the policy deciding how many resources are created when the
+    /// pool misses. One of them is handed out and the others are put in
+    /// the free list, within the byte budget. By default a single
+    /// resource is created.
+    /// @param growth The growth policy
+    void set_growth_policy(const growth_policy& growth)
+    {
+        assert(m_pool);
+        m_pool->set_growth_policy(growth);
+    }
+
+    /// Set the maximum number of bytes the unused resources may retain.
+    /// Resources recycled while the budget is exhausted are destroyed
+    /// instead of being put back into the pool. Resources already in
+    /// the pool are not affected. By default the budget is unlimited.
+    /// @param max_unused_bytes The byte budget for the unused resources
+    void set_max_unused_bytes(std::size_t max_unused_bytes)
+    {
+        assert(m_pool);
+        m_pool->set_max_unused_bytes(max_unused_bytes);
+    }
+
+    /// @returns the maximum number of bytes the unused resources may retain
+    std::size_t max_unused_bytes() const
+    {
+        assert(m_pool);
+        return m_pool->max_unused_bytes();
+    }
+
     /// Frees all unused resources
     void free_unused()
     {
@@ -147,6 +349,77 @@ public:
         m_pool->free_unused();
     }
 
+    /// Frees unused resources until at most the given number of unused
+    /// resources are left in the pool. The resources which have been
+    /// unused for the longest time are freed first.
+    /// @param unused The number of unused resources to keep
+    /// @return The number of resources freed
+    std::size_t shrink_to(std::size_t unused)
+    {
+        assert(m_pool);
+        return m_pool->shrink_to(unused);
+    }
+
+    /// Frees at most max_items unused resources. The resources which have
+    /// been unused for the longest time are freed first. This bounds the
+    /// work done per call, so the pool can be shrunk gradually, e.g. from
+    /// a periodic housekeeping task.
+    /// @param max_items The maximum number of resources to free
+    /// @return The number of resources freed
+    std::size_t trim(std::size_t max_items)
+    {
+        assert(m_pool);
+        return m_pool->trim(max_items);
+    }
+
+    /// Creates resources until the pool holds at least the given number
+    /// of unused resources, e.g. to prepare for an expected burst of
+    /// allocations. The byte budget is respected.
+    /// @param unused The number of unused resources wanted
+    /// @return The number of resources created
+    std::size_t prewarm(std::size_t unused)
+    {
+        assert(m_pool);
+        return m_pool->prewarm(unused);
+    }
+
+    /// Creates resources with the given allocate function instead of the
+    /// one of the pool until the pool holds at least the given number of
+    /// unused resources, e.g. to prewarm it with resources of a certain
+    /// size, see apply_profile(). The byte budget is respected.
+    /// @param unused The number of unused resources wanted
+    /// @param allocate Allocation function
+    /// @return The number of resources created
+    std::size_t prewarm(std::size_t unused, const allocate_function& allocate)
+    {
+        assert(m_pool);
+        assert(allocate);
+        return m_pool->prewarm(unused, allocate);
+    }
+
+    /// Takes a number of resources out of the pool at once, locking the
+    /// pool only once. The most recently recycled resources are taken
+    /// first and the rest are created. This is used by the child_pool to
+    /// refill in batches.
+    /// @param count The number of resources wanted
+    /// @return The resources, which should be given back with give_back()
+    std::vector<value_ptr> borrow(std::size_t count)
+    {
+        assert(m_pool);
+        return m_pool->borrow(count);
+    }
+
+    /// Puts a number of resources back into the pool at once, locking the
+    /// pool only once. The recycle function is called for every resource
+    /// and the resources which it resets or which do not fit in the byte
+    /// budget are destroyed.
+    /// @param resources The resources obtained with borrow()
+    void give_back(std::vector<value_ptr> resources)
+    {
+        assert(m_pool);
+        m_pool->give_back(std::move(resources));
+    }
+
     /// @return A resource from the pool.
     pool_ptr allocate()
     {
@@ -154,6 +427,63 @@ public:
         return m_pool->allocate();
     }
 
+    /// Acquires a resource without wrapping it in a pool_ptr, which
+    /// avoids the deleter and the reference counting of the pool state.
+    /// The resource must be given back with release() while the pool is
+    /// alive. See acquire_scoped() for an RAII wrapper.
+    /// @return A resource from the pool
+    value_type* acquire()
+    {
+        assert(m_pool);
+        return m_pool->acquire();
+    }
+
+    /// Gives back a resource obtained with acquire()
+    /// @param value The resource
+    void release(value_type* value)
+    {
+        assert(m_pool);
+        m_pool->release(value);
+    }
+
+    /// @return A resource from the pool which is released when the
+    ///         scoped_ptr is destroyed. The pool must outlive it.
+    scoped_ptr acquire_scoped()
+    {
+        assert(m_pool);
+        return scoped_ptr(m_pool.get(), m_pool->acquire());
+    }
+
+    /// @return The observer notified about the events of the pool
+    observer_type& observer()
+    {
+        assert(m_pool);
+        return m_pool->observer();
+    }
+
+    /// @return The observer notified about the events of the pool
+    const observer_type& observer() const
+    {
+        assert(m_pool);
+        return m_pool->observer();
+    }
+
+    /// @return The mutex of the pool, e.g. to read the statistics of the
+    ///         instrumented_locking_policy
+    mutex_type& mutex()
+    {
+        assert(m_pool);
+        return m_pool->mutex();
+    }
+
+    /// @return The mutex of the pool, e.g. to read the statistics of the
+    ///         instrumented_locking_policy
+    const mutex_type& mutex() const
+    {
+        assert(m_pool);
+        return m_pool->mutex();
+    }
+
 private:
     /// The actual pool implementation. We use the
     /// enable_shared_from_this helper to make sure we can pass a
@@ -162,6 +492,15 @@ private:
     /// into the pool once they go out of scope.
     struct impl : public std::enable_shared_from_this<impl>
     {
+        /// The size function shared between the pool and the threads
+        /// calling it
+        using size_function_ptr = std::shared_ptr<const size_function>;
+
+        /// The batch allocate function shared between the pool and the
+        /// threads calling it
+        using batch_allocate_function_ptr =
+            std::shared_ptr<const batch_allocate_function>;
+
         /// @copydoc unique_pool::unique_pool(allocate_function)
         impl(allocate_function allocate) : m_allocate(std::move(allocate))
         {
@@ -180,12 +519,21 @@ private:
         /// Copy constructor
         impl(const impl& other) :
             std::enable_shared_from_this<impl>(other),
-            m_allocate(other.m_allocate), m_recycle(other.m_recycle)
+            m_allocate(other.m_allocate), m_recycle(other.m_recycle),
+            m_size_of(other.current_size_function()),
+            m_batch_allocate(other.m_batch_allocate),
+            m_growth(other.m_growth), m_batch(other.m_growth.m_initial_batch),
+            m_max_unused_bytes(other.max_unused_bytes()),
+            m_observer(other.m_observer)
         {
             std::size_t size = other.unused_resources();
             for (std::size_t i = 0; i < size; ++i)
             {
-                m_free_list.push_back(m_allocate());
+                value_ptr resource = m_allocate();
+                std::size_t bytes = size_of(m_size_of, *resource);
+
+                m_free_list.push_back({std::move(resource), bytes, 0});
+                m_unused_bytes += bytes;
             }
         }
 
@@ -194,7 +542,14 @@ private:
             std::enable_shared_from_this<impl>(other),
             m_allocate(std::move(other.m_allocate)),
             m_recycle(std::move(other.m_recycle)),
-            m_free_list(std::move(other.m_free_list))
+            m_size_of(std::move(other.m_size_of)),
+            m_size_version(other.m_size_version),
+            m_batch_allocate(std::move(other.m_batch_allocate)),
+            m_growth(other.m_growth), m_batch(other.m_batch),
+            m_free_list(std::move(other.m_free_list)),
+            m_unused_bytes(other.m_unused_bytes),
+            m_max_unused_bytes(other.m_max_unused_bytes),
+            m_observer(std::move(other.m_observer))
         {
         }
 
@@ -211,30 +566,22 @@ private:
         {
             m_allocate = std::move(other.m_allocate);
             m_recycle = std::move(other.m_recycle);
+            m_size_of = std::move(other.m_size_of);
+            m_size_version = other.m_size_version;
+            m_batch_allocate = std::move(other.m_batch_allocate);
+            m_growth = other.m_growth;
+            m_batch = other.m_batch;
             m_free_list = std::move(other.m_free_list);
+            m_unused_bytes = other.m_unused_bytes;
+            m_max_unused_bytes = other.m_max_unused_bytes;
+            m_observer = std::move(other.m_observer);
             return *this;
         }
 
         /// Allocate a new value from the pool
         pool_ptr allocate()
         {
-            value_ptr resource;
-
-            {
-                lock_type lock(m_mutex);
-
-                if (m_free_list.size() > 0)
-                {
-                    resource = std::move(m_free_list.back());
-                    m_free_list.pop_back();
-                }
-            }
-
-            if (!resource)
-            {
-                assert(m_allocate);
-                resource = m_allocate();
-            }
+            value_ptr resource = take();
 
             auto pool = impl::shared_from_this();
 
@@ -256,11 +603,187 @@ private:
             return pool_ptr(naked_ptr, deleter(pool, std::move(resource)));
         }
 
+        /// @copydoc unique_pool::acquire()
+        value_type* acquire()
+        {
+            return take().release();
+        }
+
+        /// @copydoc unique_pool::release(value_type*)
+        void release(value_type* value)
+        {
+            assert(value);
+            recycle(value_ptr(value));
+        }
+
         /// @copydoc unique_pool::free_unused()
         void free_unused()
         {
-            lock_type lock(m_mutex);
-            m_free_list.clear();
+            release_unused(0, std::numeric_limits<std::size_t>::max());
+        }
+
+        /// @copydoc unique_pool::shrink_to(std::size_t)
+        std::size_t shrink_to(std::size_t unused)
+        {
+            return release_unused(unused,
+                                  std::numeric_limits<std::size_t>::max());
+        }
+
+        /// @copydoc unique_pool::trim(std::size_t)
+        std::size_t trim(std::size_t max_items)
+        {
+            return release_unused(0, max_items);
+        }
+
+        /// @copydoc unique_pool::prewarm(std::size_t)
+        std::size_t prewarm(std::size_t unused)
+        {
+            return prewarm(unused, m_allocate);
+        }
+
+        /// @copydoc unique_pool::prewarm(std::size_t, const allocate_function&)
+        std::size_t prewarm(std::size_t unused,
+                            const allocate_function& allocate)
+        {
+            std::size_t created = 0;
+
+            while (true)
+            {
+                size_function_ptr size_of_function;
+
+                {
+                    lock_type lock(m_mutex);
+
+                    if (m_free_list.size() >= unused)
+                    {
+                        break;
+                    }
+
+                    size_of_function = m_size_of;
+                }
+
+                // The resources are created without holding the lock
+                value_ptr resource = allocate();
+                std::size_t bytes = size_of(size_of_function, *resource);
+
+                {
+                    lock_type lock(m_mutex);
+
+                    if (m_unused_bytes > m_max_unused_bytes ||
+                        bytes > m_max_unused_bytes - m_unused_bytes)
+                    {
+                        break;
+                    }
+
+                    m_free_list.push_back({std::move(resource), bytes,
+                                           size_version(size_of_function)});
+                    m_unused_bytes += bytes;
+                }
+
+                ++created;
+            }
+
+            return created;
+        }
+
+        /// @copydoc unique_pool::borrow(std::size_t)
+        std::vector<value_ptr> borrow(std::size_t count)
+        {
+            std::vector<value_ptr> resources;
+            resources.reserve(count);
+            std::size_t unused = 0;
+            batch_allocate_function_ptr batch_allocate;
+
+            {
+                lock_type lock(m_mutex);
+
+                while (resources.size() < count && m_free_list.size() > 0)
+                {
+                    auto& last = m_free_list.back();
+                    resources.push_back(std::move(last.m_resource));
+                    m_unused_bytes -= last.m_size;
+                    m_free_list.pop_back();
+                }
+
+                unused = m_free_list.size();
+                batch_allocate = m_batch_allocate;
+            }
+
+            for (std::size_t i = resources.size(); i < count; ++i)
+            {
+                m_observer.on_miss(this);
+            }
+
+            // The missing resources are created without holding the lock
+            while (resources.size() < count)
+            {
+                std::vector<value_ptr> created =
+                    create(count - resources.size(), batch_allocate);
+
+                for (auto& resource : created)
+                {
+                    resources.push_back(std::move(resource));
+                }
+            }
+
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                m_observer.on_allocate(this, unused);
+            }
+
+            return resources;
+        }
+
+        /// @copydoc unique_pool::give_back(std::vector<value_ptr>)
+        void give_back(std::vector<value_ptr> resources)
+        {
+            std::vector<std::size_t> sizes;
+            sizes.reserve(resources.size());
+
+            size_function_ptr size_of_function = current_size_function();
+
+            for (auto& resource : resources)
+            {
+                assert(resource);
+
+                if (m_recycle)
+                {
+                    m_recycle(resource);
+                }
+
+                sizes.push_back(
+                    resource ? size_of(size_of_function, *resource) : 0);
+            }
+
+            std::size_t unused = 0;
+
+            {
+                lock_type lock(m_mutex);
+
+                // The resources which the recycle function dropped or which
+                // do not fit in the byte budget are destroyed when we
+                // return, after the lock has been released
+                for (std::size_t i = 0; i < resources.size(); ++i)
+                {
+                    if (!resources[i] ||
+                        m_unused_bytes > m_max_unused_bytes ||
+                        sizes[i] > m_max_unused_bytes - m_unused_bytes)
+                    {
+                        continue;
+                    }
+
+                    m_free_list.push_back({std::move(resources[i]), sizes[i],
+                                           size_version(size_of_function)});
+                    m_unused_bytes += sizes[i];
+                }
+
+                unused = m_free_list.size();
+            }
+
+            for (std::size_t i = 0; i < resources.size(); ++i)
+            {
+                m_observer.on_recycle(this, unused);
+            }
         }
 
         /// @copydoc unique_pool::unused_resources()
@@ -270,6 +793,136 @@ private:
             return m_free_list.size();
         }
 
+        /// @copydoc unique_pool::unused_bytes()
+        std::size_t unused_bytes() const
+        {
+            lock_type lock(m_mutex);
+            return m_unused_bytes;
+        }
+
+        /// @copydoc unique_pool::size_classes()
+        std::vector<std::size_t> size_classes() const
+        {
+            std::vector<std::size_t> classes;
+
+            lock_type lock(m_mutex);
+
+            for (const auto& unused : m_free_list)
+            {
+                std::size_t size_class = 0;
+                for (std::size_t bytes = unused.m_size; bytes > 1; bytes >>= 1)
+                {
+                    ++size_class;
+                }
+
+                if (classes.size() <= size_class)
+                {
+                    classes.resize(size_class + 1);
+                }
+
+                ++classes[size_class];
+            }
+
+            return classes;
+        }
+
+        /// @copydoc unique_pool::set_size_function(size_function)
+        void set_size_function(size_function function)
+        {
+            size_function_ptr size_of_function;
+            if (function)
+            {
+                size_of_function =
+                    std::make_shared<const size_function>(std::move(function));
+            }
+
+            uint64_t version = 0;
+
+            {
+                lock_type lock(m_mutex);
+                m_size_of = size_of_function;
+                version = ++m_size_version;
+            }
+
+            // The resources already in the pool must be accounted for
+            // using the new size function. They are measured one at a time
+            // without holding the lock, so that all the others stay
+            // available to the users of the pool meanwhile.
+            std::list<unused_resource> measured;
+
+            while (true)
+            {
+                {
+                    lock_type lock(m_mutex);
+
+                    auto stale = std::find_if(
+                        m_free_list.begin(), m_free_list.end(),
+                        [version](const unused_resource& unused)
+                        { return unused.m_version != version; });
+
+                    if (!measured.empty())
+                    {
+                        // Put it back where it was, i.e. after the
+                        // resources measured before it
+                        m_unused_bytes += measured.front().m_size;
+                        m_free_list.splice(stale, measured);
+                    }
+
+                    // Done, or a newer size function has been set, which
+                    // measures the resources again
+                    if (stale == m_free_list.end() ||
+                        version != m_size_version)
+                    {
+                        return;
+                    }
+
+                    m_unused_bytes -= stale->m_size;
+                    measured.splice(measured.begin(), m_free_list, stale);
+                }
+
+                unused_resource& unused = measured.front();
+                unused.m_size = size_of(size_of_function, *unused.m_resource);
+                unused.m_version = version;
+            }
+        }
+
+        /// @copydoc unique_pool::set_batch_allocate_function(
+        ///     batch_allocate_function)
+        void set_batch_allocate_function(batch_allocate_function batch_allocate)
+        {
+            batch_allocate_function_ptr function;
+            if (batch_allocate)
+            {
+                function = std::make_shared<const batch_allocate_function>(
+                    std::move(batch_allocate));
+            }
+
+            lock_type lock(m_mutex);
+            m_batch_allocate = std::move(function);
+        }
+
+        /// @copydoc unique_pool::set_growth_policy(const growth_policy&)
+        void set_growth_policy(const growth_policy& growth)
+        {
+            lock_type lock(m_mutex);
+            m_growth = growth;
+            m_batch = growth.m_initial_batch;
+        }
+
+        /// @copydoc unique_pool::set_max_unused_bytes(std::size_t)
+        void set_max_unused_bytes(std::size_t max_unused_bytes)
+        {
+            lock_type lock(m_mutex);
+            m_max_unused_bytes = max_unused_bytes;
+        }
+
+        /// @copydoc unique_pool::max_unused_bytes()
+        std::size_t max_unused_bytes() const
+        {
+            lock_type lock(m_mutex);
+            return m_max_unused_bytes;
+        }
+
         /// This function called when a resource should be added
         /// back into the pool
         void recycle(value_ptr resource)
@@ -279,10 +932,281 @@ private:
                 m_recycle(resource);
             }
 
+            std::size_t unused = 0;
+            std::size_t bytes = 0;
+            size_function_ptr size_of_function = current_size_function();
+
+            if (resource)
+            {
+                bytes = size_of(size_of_function, *resource);
+            }
+
+            {
+                lock_type lock(m_mutex);
+
+                // If the recycle function dropped the resource or it does
+                // not fit in the byte budget we drop it. It is destroyed
+                // when we return, i.e. after the lock has been released.
+                if (resource && m_unused_bytes <= m_max_unused_bytes &&
+                    bytes <= m_max_unused_bytes - m_unused_bytes)
+                {
+                    m_free_list.push_back({std::move(resource), bytes,
+                                           size_version(size_of_function)});
+                    m_unused_bytes += bytes;
+                }
+
+                unused = m_free_list.size();
+            }
+
+            // The observer is notified also if the resource was dropped,
+            // so that it can keep track of the resources in use
+            m_observer.on_recycle(this, unused);
+        }
+
+        /// @copydoc unique_pool::observer()
+        observer_type& observer()
+        {
+            return m_observer;
+        }
+
+        /// @copydoc unique_pool::mutex()
+        mutex_type& mutex() const
+        {
+            return m_mutex;
+        }
+
+    private:
+        /// Frees unused resources from the front of the free list, i.e.
+        /// the ones which have been unused for the longest time.
+        ///
+        /// The resources are detached from the free list while holding
+        /// the lock but destroyed after releasing it. Destroying many
+        /// large objects may take a while and we do not want to block
+        /// concurrent allocate() and recycle() calls meanwhile.
+        ///
+        /// @param keep The number of unused resources to keep
+        /// @param max_items The maximum number of resources to free
+        /// @return The number of resources freed
+        std::size_t release_unused(std::size_t keep, std::size_t max_items)
+        {
+            std::list<unused_resource> victims;
+
+            {
+                lock_type lock(m_mutex);
+
+                std::size_t size = m_free_list.size();
+                std::size_t count = size > keep ? size - keep : 0;
+                count = std::min(count, max_items);
+
+                auto last = m_free_list.begin();
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    m_unused_bytes -= last->m_size;
+                    ++last;
+                }
+
+                // Shrinking starts the growth over
+                if (count > 0)
+                {
+                    m_batch = m_growth.m_initial_batch;
+                }
+
+                victims.splice(victims.end(), m_free_list,
+                               m_free_list.begin(), last);
+            }
+
+            std::size_t freed = victims.size();
+            victims.clear();
+
+            m_observer.on_free_unused(this, freed);
+            return freed;
+        }
+
+        /// Takes the most recently recycled resource from the free list or
+        /// allocates a new one on a miss
+        value_ptr take()
+        {
+            value_ptr resource;
+            std::size_t unused = 0;
+            std::size_t batch = 1;
+            batch_allocate_function_ptr batch_allocate;
+
+            {
+                lock_type lock(m_mutex);
+
+                if (m_free_list.size() > 0)
+                {
+                    resource = std::move(m_free_list.back().m_resource);
+                    m_unused_bytes -= m_free_list.back().m_size;
+                    m_free_list.pop_back();
+                }
+                else
+                {
+                    batch = m_batch;
+                    m_batch = m_growth.grow(m_batch);
+                    batch_allocate = m_batch_allocate;
+                }
+
+                unused = m_free_list.size();
+            }
+
+            if (!resource)
+            {
+                assert(m_allocate);
+                m_observer.on_miss(this);
+
+                if (batch > 1)
+                {
+                    resource = allocate_batch(batch, batch_allocate, unused);
+                }
+                else
+                {
+                    resource = m_allocate();
+                }
+            }
+
+            m_observer.on_allocate(this, unused);
+
+            return resource;
+        }
+
+        /// Creates a batch of resources on a miss. The first resource is
+        /// returned and the others are put in the free list.
+        /// @param batch The number of resources to create
+        /// @param batch_allocate The batch allocate function or nullptr
+        /// @param unused Set to the number of unused resources after
+        /// @return The resource to hand out
+        value_ptr allocate_batch(
+            std::size_t batch,
+            const batch_allocate_function_ptr& batch_allocate,
+            std::size_t& unused)
+        {
+            std::vector<value_ptr> created = create(batch, batch_allocate);
+
+            size_function_ptr size_of_function = current_size_function();
+
+            std::vector<std::size_t> sizes;
+            sizes.reserve(created.size());
+            for (const auto& resource : created)
+            {
+                assert(resource);
+                sizes.push_back(size_of(size_of_function, *resource));
+            }
+
+            {
+                lock_type lock(m_mutex);
+
+                // The extra resources which do not fit in the byte budget
+                // are destroyed when we return, after the lock has been
+                // released
+                for (std::size_t i = 1; i < created.size(); ++i)
+                {
+                    if (m_unused_bytes > m_max_unused_bytes ||
+                        sizes[i] > m_max_unused_bytes - m_unused_bytes)
+                    {
+                        break;
+                    }
+
+                    m_free_list.push_back({std::move(created[i]), sizes[i],
+                                           size_version(size_of_function)});
+                    m_unused_bytes += sizes[i];
+                }
+
+                unused = m_free_list.size();
+            }
+
+            return std::move(created.front());
+        }
+
+        /// Creates at least one and at most the given number of resources,
+        /// with the batch allocate function if one is set and more than
+        /// one resource is wanted. Null resources
+        /// returned by it are dropped, and if it returns none the allocate
+        /// function is used instead.
+        /// @param count The number of resources wanted
+        /// @param batch_allocate The batch allocate function or nullptr
+        /// @return The resources created
+        std::vector<value_ptr>
+        create(std::size_t count,
+               const batch_allocate_function_ptr& batch_allocate)
+        {
+            assert(count > 0);
+
+            std::vector<value_ptr> created;
+
+            if (batch_allocate && count > 1)
+            {
+                created = (*batch_allocate)(count);
+                created.erase(
+                    std::remove(created.begin(), created.end(), nullptr),
+                    created.end());
+
+                if (created.size() > count)
+                {
+                    created.resize(count);
+                }
+            }
+
+            if (created.empty())
+            {
+                assert(m_allocate);
+
+                created.reserve(count);
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    created.push_back(m_allocate());
+                }
+            }
+
+            return created;
+        }
+
+        /// @return The size function. It is read under the lock, so that
+        ///         it can be called without holding the lock.
+        size_function_ptr current_size_function() const
+        {
             lock_type lock(m_mutex);
-            m_free_list.push_back(std::move(resource));
+            return m_size_of;
+        }
+
+        /// @param size_of_function The size function a resource was
+        ///        measured with, must be called with the lock held
+        /// @return The version to record for the resource. If the size
+        ///         function has been set meanwhile, a set_size_function()
+        ///         call in progress measures the resource again.
+        uint64_t size_version(const size_function_ptr& size_of_function) const
+        {
+            return size_of_function == m_size_of ? m_size_version
+                                                 : m_size_version - 1;
+        }
+
+        /// @param size_function The size function or nullptr
+        /// @param resource The resource
+        /// @return The size in bytes of the resource
+        static std::size_t size_of(const size_function_ptr& size_of_function,
+                                   const value_type& resource)
+        {
+            if (size_of_function)
+            {
+                return (*size_of_function)(resource);
+            }
+
+            return sizeof(value_type);
         }
 
+        /// An unused resource together with its size in bytes
+        struct unused_resource
+        {
+            /// The resource
+            value_ptr m_resource;
+
+            /// The size of the resource in bytes
+            std::size_t m_size;
+
+            /// The version of the size function it was measured with
+            uint64_t m_version;
+        };
+
     private:
         /// The allocator to use
         allocate_function m_allocate;
@@ -290,8 +1214,32 @@ private:
         /// The recycle function
         recycle_function m_recycle;
 
+        /// The size function, shared so that it can be copied cheaply
+        /// under the lock and called without holding it
+        size_function_ptr m_size_of;
+
+        /// Incremented every time the size function is set
+        uint64_t m_size_version = 0;
+
+        /// The batch allocate function, shared so that it can be copied
+        /// cheaply under the lock and called without holding it
+        batch_allocate_function_ptr m_batch_allocate;
+
+        /// The growth policy
+        growth_policy m_growth;
+
+        /// The number of resources to create on the next miss
+        std::size_t m_batch = 1;
+
         /// Stores all the free resources
-        std::list<value_ptr> m_free_list;
+        std::list<unused_resource> m_free_list;
+
+        /// The number of bytes retained by the free resources
+        std::size_t m_unused_bytes = 0;
+
+        /// The maximum number of bytes the free resources may retain
+        std::size_t m_max_unused_bytes =
+            std::numeric_limits<std::size_t>::max();
 
         /// Mutex used to coordinate access to the pool. We had to
         /// make it mutable as we have to lock in the
@@ -300,6 +1248,9 @@ private:
         /// threads releases a resource into the free list while
         /// another tries to read its size.
         mutable mutex_type m_mutex;
+
+        /// The observer notified about the events of the pool
+        observer_type m_observer;
     };
 
     /// The custom deleter object used by the std::unique_ptr<T>
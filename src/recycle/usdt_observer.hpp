@@ -0,0 +1,94 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <cstddef>
+
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>) && !defined(RECYCLE_DISABLE_USDT)
+#include <sys/sdt.h>
+#define RECYCLE_HAS_USDT 1
+#endif
+#endif
+
+#if !defined(RECYCLE_HAS_USDT)
+#define RECYCLE_HAS_USDT 0
+#endif
+
+namespace recycle
+{
+/// Observer policy exposing the pool events as USDT (user statically
+/// defined tracing) probes.
+///
+/// A USDT probe compiles to a single nop instruction plus a note in the
+/// ELF file. Tools such as perf, bpftrace or SystemTap can attach to the
+/// probes of a running process without rebuilding it, e.g.:
+///
+///     bpftrace -e 'usdt:./my_app:recycle:miss { @[arg0] = count(); }'
+///
+/// The following probes are defined in the "recycle" provider:
+///
+///     allocate(pool, unused)
+///     miss(pool)
+///     recycle(pool, unused)
+///     free_unused(pool, freed)
+///
+/// The probes are only available if the <sys/sdt.h> header (usually
+/// provided by the systemtap-sdt-dev package) is found at compile time.
+/// Otherwise, or if RECYCLE_DISABLE_USDT is defined, the observer does
+/// nothing. RECYCLE_HAS_USDT tells which is the case.
+///
+/// Example:
+///
+///     recycle::unique_pool<heavy_object, recycle::no_locking_policy,
+///                          recycle::usdt_observer> pool;
+///
+struct usdt_observer
+{
+    /// Fires the recycle:allocate probe
+    void on_allocate(const void* pool, std::size_t unused)
+    {
+#if RECYCLE_HAS_USDT
+        DTRACE_PROBE2(recycle, allocate, pool, unused);
+#else
+        (void)pool;
+        (void)unused;
+#endif
+    }
+
+    /// Fires the recycle:miss probe
+    void on_miss(const void* pool)
+    {
+#if RECYCLE_HAS_USDT
+        DTRACE_PROBE1(recycle, miss, pool);
+#else
+        (void)pool;
+#endif
+    }
+
+    /// Fires the recycle:recycle probe
+    void on_recycle(const void* pool, std::size_t unused)
+    {
+#if RECYCLE_HAS_USDT
+        DTRACE_PROBE2(recycle, recycle, pool, unused);
+#else
+        (void)pool;
+        (void)unused;
+#endif
+    }
+
+    /// Fires the recycle:free_unused probe
+    void on_free_unused(const void* pool, std::size_t freed)
+    {
+#if RECYCLE_HAS_USDT
+        DTRACE_PROBE2(recycle, free_unused, pool, freed);
+#else
+        (void)pool;
+        (void)freed;
+#endif
+    }
+};
+}
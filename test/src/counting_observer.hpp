@@ -0,0 +1,42 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#pragma once
+
+#include <cstddef>
+
+/// Observer counting the pool events, shared by the tests of the pools.
+/// It is the same type in every translation unit including it, so it is
+/// not put in an anonymous namespace.
+struct counting_observer
+{
+    void on_allocate(const void*, std::size_t unused)
+    {
+        ++m_allocations;
+        m_unused = unused;
+    }
+
+    void on_miss(const void*)
+    {
+        ++m_misses;
+    }
+
+    void on_recycle(const void*, std::size_t unused)
+    {
+        ++m_recycles;
+        m_unused = unused;
+    }
+
+    void on_free_unused(const void*, std::size_t freed)
+    {
+        m_freed += freed;
+    }
+
+    std::size_t m_allocations = 0;
+    std::size_t m_misses = 0;
+    std::size_t m_recycles = 0;
+    std::size_t m_freed = 0;
+    std::size_t m_unused = 0;
+};
@@ -0,0 +1,87 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#include <recycle/atomic_bitmap.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+/// Test claiming and releasing all slots
+TEST(test_atomic_bitmap, claim_release)
+{
+    recycle::atomic_bitmap<70> bitmap;
+    EXPECT_EQ(bitmap.available(), 70U);
+
+    std::set<std::size_t> slots;
+    for (std::size_t i = 0; i < 70; ++i)
+    {
+        std::size_t slot = bitmap.claim();
+        ASSERT_LT(slot, 70U);
+        slots.insert(slot);
+    }
+
+    EXPECT_EQ(slots.size(), 70U);
+    EXPECT_EQ(bitmap.available(), 0U);
+    EXPECT_EQ(bitmap.claim(), recycle::atomic_bitmap<70>::npos);
+
+    bitmap.release(42);
+    EXPECT_EQ(bitmap.available(), 1U);
+    EXPECT_EQ(bitmap.claim(), 42U);
+}
+
+/// Test that concurrent threads never hold the same slot
+TEST(test_atomic_bitmap, concurrent)
+{
+    const std::size_t threads = 4;
+    const std::size_t rounds = 2000;
+
+    recycle::atomic_bitmap<128> bitmap;
+    std::vector<std::atomic<uint32_t>> owners(128);
+
+    std::vector<std::thread> workers;
+    for (std::size_t t = 0; t < threads; ++t)
+    {
+        workers.emplace_back(
+            [&, t]()
+            {
+                std::vector<std::size_t> held;
+
+                for (std::size_t r = 0; r < rounds; ++r)
+                {
+                    for (std::size_t i = 0; i < 16; ++i)
+                    {
+                        std::size_t slot = bitmap.claim();
+                        ASSERT_NE(slot, recycle::atomic_bitmap<128>::npos);
+
+                        // Nobody else may hold the slot
+                        auto owner = static_cast<uint32_t>(t + 1);
+                        uint32_t previous = owners[slot].exchange(owner);
+                        EXPECT_EQ(previous, 0U);
+                        held.push_back(slot);
+                    }
+
+                    for (std::size_t slot : held)
+                    {
+                        owners[slot].store(0);
+                        bitmap.release(slot);
+                    }
+
+                    held.clear();
+                }
+            });
+    }
+
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    EXPECT_EQ(bitmap.available(), 128U);
+}
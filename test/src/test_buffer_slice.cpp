@@ -0,0 +1,115 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#include <recycle/buffer_slice.hpp>
+
+#include <recycle/shared_pool.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+TEST(test_buffer_slice, empty)
+{
+    recycle::buffer_slice s;
+
+    EXPECT_TRUE(s.empty());
+    EXPECT_EQ(s.size(), 0U);
+    EXPECT_EQ(s.data(), nullptr);
+}
+
+/// Test that the buffer only returns to the pool when the last slice
+/// has been destroyed
+TEST(test_buffer_slice, packetize)
+{
+    recycle::shared_pool<std::vector<uint8_t>> pool;
+
+    const std::size_t mtu = 1500;
+    std::vector<recycle::buffer_slice> packets;
+
+    {
+        auto buffer = pool.allocate();
+        buffer->resize(4000);
+
+        for (std::size_t i = 0; i < buffer->size(); ++i)
+        {
+            (*buffer)[i] = static_cast<uint8_t>(i);
+        }
+
+        for (std::size_t offset = 0; offset < buffer->size(); offset += mtu)
+        {
+            std::size_t size = std::min(mtu, buffer->size() - offset);
+            packets.push_back(recycle::slice(buffer, offset, size));
+        }
+
+        ASSERT_EQ(packets.size(), 3U);
+        EXPECT_EQ(packets[0].data(), buffer->data());
+        EXPECT_EQ(packets[1].data(), buffer->data() + 1500);
+        EXPECT_EQ(packets[2].size(), 1000U);
+        EXPECT_EQ(packets[2].data()[0], static_cast<uint8_t>(3000));
+    }
+
+    // The slices keep the buffer out of the pool
+    EXPECT_EQ(pool.unused_resources(), 0U);
+    EXPECT_EQ(packets[0].use_count(), 3);
+
+    packets[0].reset();
+    packets[1].reset();
+    EXPECT_EQ(pool.unused_resources(), 0U);
+
+    packets.clear();
+    EXPECT_EQ(pool.unused_resources(), 1U);
+}
+
+/// Test taking slices of slices
+TEST(test_buffer_slice, slice_of_slice)
+{
+    recycle::shared_pool<std::vector<uint8_t>> pool;
+
+    recycle::buffer_slice inner;
+
+    {
+        auto buffer = pool.allocate();
+        buffer->assign({0, 1, 2, 3, 4, 5, 6, 7, 8, 9});
+
+        auto whole = recycle::slice(buffer);
+        EXPECT_EQ(whole.size(), 10U);
+
+        auto outer = whole.slice(2, 6);
+        inner = outer.slice(1, 3);
+    }
+
+    EXPECT_EQ(pool.unused_resources(), 0U);
+
+    ASSERT_EQ(inner.size(), 3U);
+    EXPECT_EQ(inner.data()[0], 3U);
+    EXPECT_EQ(inner.data()[2], 5U);
+
+    inner.reset();
+    EXPECT_EQ(pool.unused_resources(), 1U);
+}
+
+/// Test that the offsets and sizes are in bytes also for buffers of
+/// larger elements, and that const buffers can be sliced
+TEST(test_buffer_slice, element_size)
+{
+    auto words = std::make_shared<std::vector<uint32_t>>(4, 0x01010101U);
+
+    auto whole = recycle::slice(words);
+    EXPECT_EQ(whole.size(), 16U);
+
+    auto last = recycle::slice(words, 12, 4);
+    EXPECT_EQ(static_cast<const void*>(last.data()),
+              static_cast<const void*>(words->data() + 3));
+
+    std::shared_ptr<const std::vector<uint32_t>> constant = words;
+    auto tail = recycle::slice(constant, 8, 8);
+    EXPECT_EQ(tail.size(), 8U);
+    EXPECT_EQ(tail.data()[7], 0x01U);
+    EXPECT_EQ(words.use_count(), 5);
+}
@@ -0,0 +1,308 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#include <recycle/child_pool.hpp>
+#include <recycle/mutex_locking_policy.hpp>
+#include <recycle/shared_pool.hpp>
+#include <recycle/unique_pool.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+// Put tests classes in an anonymous namespace to avoid violations of
+// ODF (one-definition-rule) in other translation units
+namespace
+{
+// Default constructible dummy object
+struct dummy_one
+{
+    dummy_one()
+    {
+        ++m_count;
+    }
+
+    ~dummy_one()
+    {
+        --m_count;
+    }
+
+    // Counter which will check how many object have been allocate
+    // and deallocated
+    static int32_t m_count;
+
+    // Set by the recycle functions
+    bool m_recycled = false;
+};
+
+int32_t dummy_one::m_count = 0;
+}
+
+/// Test refilling from and giving back to a unique_pool
+TEST(test_child_pool, unique_pool)
+{
+    {
+        using parent_type = recycle::unique_pool<dummy_one>;
+        using child_type = recycle::child_pool<parent_type>;
+
+        static_assert(
+            std::is_same<child_type::pool_ptr::pointer, dummy_one*>::value,
+            "The child hands out unique pointers");
+
+        parent_type parent;
+        child_type child(parent, 4);
+        EXPECT_EQ(child.batch(), 4U);
+        EXPECT_EQ(&child.parent(), &parent);
+
+        // The first allocation borrows a whole batch
+        auto d1 = child.allocate();
+        EXPECT_EQ(child.unused_resources(), 3U);
+        EXPECT_EQ(parent.unused_resources(), 0U);
+        EXPECT_EQ(dummy_one::m_count, 4);
+
+        d1.reset();
+        EXPECT_EQ(child.unused_resources(), 4U);
+
+        // A burst borrows more batches
+        std::vector<child_type::pool_ptr> burst;
+        for (uint32_t i = 0; i < 10; ++i)
+        {
+            burst.push_back(child.allocate());
+        }
+
+        EXPECT_EQ(child.unused_resources(), 2U);
+        EXPECT_EQ(dummy_one::m_count, 12);
+
+        // Once the child holds more than two batches it keeps one and
+        // gives the rest back to the parent
+        burst.clear();
+        EXPECT_EQ(child.unused_resources(), 7U);
+        EXPECT_EQ(parent.unused_resources(), 5U);
+
+        // The next refill comes from the parent
+        child.flush();
+        EXPECT_EQ(child.unused_resources(), 0U);
+        EXPECT_EQ(parent.unused_resources(), 12U);
+
+        auto d2 = child.allocate();
+        EXPECT_EQ(child.unused_resources(), 3U);
+        EXPECT_EQ(parent.unused_resources(), 8U);
+        EXPECT_EQ(dummy_one::m_count, 12);
+    }
+
+    EXPECT_EQ(dummy_one::m_count, 0);
+}
+
+/// Test refilling from and giving back to a shared_pool
+TEST(test_child_pool, shared_pool)
+{
+    {
+        using parent_type = recycle::shared_pool<dummy_one>;
+        using child_type = recycle::child_pool<parent_type>;
+
+        static_assert(std::is_same<child_type::pool_ptr,
+                                   std::shared_ptr<dummy_one>>::value,
+                      "The child hands out shared pointers");
+
+        parent_type parent;
+
+        {
+            child_type child(parent, 2);
+
+            std::shared_ptr<dummy_one> d1 = child.allocate();
+            std::shared_ptr<dummy_one> d2 = d1;
+            EXPECT_EQ(child.unused_resources(), 1U);
+
+            d1.reset();
+            EXPECT_EQ(child.unused_resources(), 1U);
+
+            d2.reset();
+            EXPECT_EQ(child.unused_resources(), 2U);
+            EXPECT_EQ(parent.unused_resources(), 0U);
+        }
+
+        // The destroyed child gave back its free list
+        EXPECT_EQ(parent.unused_resources(), 2U);
+        EXPECT_EQ(dummy_one::m_count, 2);
+    }
+
+    EXPECT_EQ(dummy_one::m_count, 0);
+}
+
+/// Test that the parent's byte budget bounds what a child gives back
+TEST(test_child_pool, budget)
+{
+    {
+        recycle::unique_pool<dummy_one> parent;
+        parent.set_max_unused_bytes(2 * sizeof(dummy_one));
+
+        {
+            recycle::child_pool<recycle::unique_pool<dummy_one>> child(parent,
+                                                                       8);
+
+            std::vector<decltype(child)::pool_ptr> burst;
+            for (uint32_t i = 0; i < 20; ++i)
+            {
+                burst.push_back(child.allocate());
+            }
+
+            EXPECT_EQ(dummy_one::m_count, 24);
+            burst.clear();
+
+            EXPECT_EQ(child.unused_resources(), 15U);
+            EXPECT_EQ(parent.unused_resources(), 2U);
+            EXPECT_EQ(dummy_one::m_count, 17);
+        }
+
+        // The burst did not inflate the parent
+        EXPECT_EQ(parent.unused_resources(), 2U);
+        EXPECT_EQ(dummy_one::m_count, 2);
+    }
+
+    EXPECT_EQ(dummy_one::m_count, 0);
+}
+
+/// Test that resources outliving the child go back to the parent
+TEST(test_child_pool, child_die_before_object)
+{
+    {
+        recycle::unique_pool<dummy_one> parent;
+        recycle::child_pool<recycle::unique_pool<dummy_one>>::pool_ptr d1;
+
+        {
+            recycle::child_pool<recycle::unique_pool<dummy_one>> child(parent,
+                                                                       2);
+            d1 = child.allocate();
+
+            // Moving the child keeps the resources valid
+            auto moved = std::move(child);
+            EXPECT_EQ(moved.unused_resources(), 1U);
+        }
+
+        EXPECT_EQ(parent.unused_resources(), 1U);
+
+        d1.reset();
+        EXPECT_EQ(parent.unused_resources(), 2U);
+        EXPECT_EQ(dummy_one::m_count, 2);
+    }
+
+    EXPECT_EQ(dummy_one::m_count, 0);
+}
+
+/// Test the recycle functions of the child and the parent
+TEST(test_child_pool, recycle)
+{
+    uint32_t child_recycled = 0;
+    uint32_t parent_recycled = 0;
+
+    auto make = []() { return std::make_unique<dummy_one>(); };
+
+    recycle::unique_pool<dummy_one> parent(
+        make,
+        [&parent_recycled](std::unique_ptr<dummy_one>& d)
+        {
+            d->m_recycled = false;
+            ++parent_recycled;
+        });
+
+    {
+        recycle::child_pool<recycle::unique_pool<dummy_one>> child(
+            parent, 2,
+            [&child_recycled](std::unique_ptr<dummy_one>& d)
+            {
+                d->m_recycled = true;
+                ++child_recycled;
+            });
+
+        child.allocate();
+        EXPECT_EQ(child_recycled, 1U);
+        EXPECT_EQ(parent_recycled, 0U);
+
+        auto d1 = child.allocate();
+        EXPECT_TRUE(d1->m_recycled);
+    }
+
+    EXPECT_EQ(child_recycled, 2U);
+    EXPECT_EQ(parent_recycled, 2U);
+
+    auto d2 = parent.allocate();
+    EXPECT_FALSE(d2->m_recycled);
+}
+
+/// Test that the resources reset by the child's recycle function are
+/// destroyed instead of being kept
+TEST(test_child_pool, recycle_drop)
+{
+    {
+        recycle::unique_pool<dummy_one> parent;
+
+        recycle::child_pool<recycle::unique_pool<dummy_one>> child(
+            parent, 2, [](std::unique_ptr<dummy_one>& d) { d.reset(); });
+
+        auto d1 = child.allocate();
+        EXPECT_EQ(child.unused_resources(), 1U);
+        EXPECT_EQ(dummy_one::m_count, 2);
+
+        d1.reset();
+        EXPECT_EQ(child.unused_resources(), 1U);
+        EXPECT_EQ(dummy_one::m_count, 1);
+
+        auto d2 = child.allocate();
+        auto d3 = child.allocate();
+        EXPECT_TRUE(d2);
+        EXPECT_TRUE(d3);
+        EXPECT_EQ(dummy_one::m_count, 3);
+    }
+
+    EXPECT_EQ(dummy_one::m_count, 0);
+}
+
+/// Test children on several threads sharing a parent
+TEST(test_child_pool, threads)
+{
+    using parent_type =
+        recycle::unique_pool<dummy_one, recycle::mutex_locking_policy>;
+
+    {
+        parent_type parent;
+        std::vector<std::thread> threads;
+
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            threads.emplace_back(
+                [&parent]()
+                {
+                    recycle::child_pool<parent_type> child(parent, 8);
+                    std::vector<recycle::child_pool<parent_type>::pool_ptr>
+                        held;
+
+                    for (uint32_t j = 0; j < 1000; ++j)
+                    {
+                        held.push_back(child.allocate());
+
+                        if (held.size() == 20)
+                        {
+                            held.clear();
+                        }
+                    }
+                });
+        }
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        // Every resource created ended up back in the parent
+        EXPECT_EQ(parent.unused_resources(),
+                  static_cast<std::size_t>(dummy_one::m_count));
+    }
+
+    EXPECT_EQ(dummy_one::m_count, 0);
+}
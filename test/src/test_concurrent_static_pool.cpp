@@ -0,0 +1,102 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#include <recycle/concurrent_static_pool.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+// Put tests classes in an anonymous namespace to avoid violations of
+// ODF (one-definition-rule) in other translation units
+namespace
+{
+// Default constructible dummy object
+struct dummy_one
+{
+    dummy_one()
+    {
+        ++m_count;
+    }
+
+    ~dummy_one()
+    {
+        --m_count;
+    }
+
+    // Counter which will check how many object have been allocate
+    // and deallocated
+    static std::atomic<int32_t> m_count;
+
+    uint32_t m_value = 0;
+};
+
+std::atomic<int32_t> dummy_one::m_count{0};
+}
+
+/// Test the basic API construct and free some objects
+TEST(test_concurrent_static_pool, api)
+{
+    {
+        recycle::concurrent_static_pool<dummy_one, 2> pool;
+        EXPECT_EQ(pool.available(), 2U);
+        EXPECT_EQ(dummy_one::m_count, 0);
+
+        auto d1 = pool.allocate();
+        auto d2 = pool.allocate();
+        ASSERT_TRUE(d1 && d2);
+        EXPECT_EQ(dummy_one::m_count, 2);
+        EXPECT_EQ(pool.available(), 0U);
+
+        EXPECT_FALSE(pool.allocate());
+
+        d1.reset();
+        EXPECT_EQ(pool.available(), 1U);
+
+        // The value is reused, not constructed again
+        auto d3 = pool.allocate();
+        EXPECT_EQ(dummy_one::m_count, 2);
+    }
+
+    EXPECT_EQ(dummy_one::m_count, 0);
+}
+
+/// Test allocating and releasing from many threads
+TEST(test_concurrent_static_pool, concurrent)
+{
+    recycle::concurrent_static_pool<dummy_one, 64> pool;
+
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < 4; ++t)
+    {
+        threads.emplace_back(
+            [&pool, t]()
+            {
+                for (uint32_t i = 0; i < 5000; ++i)
+                {
+                    auto a = pool.allocate();
+                    auto b = pool.allocate();
+                    ASSERT_TRUE(a && b);
+
+                    a->m_value = t;
+                    b->m_value = t;
+                    std::this_thread::yield();
+                    EXPECT_EQ(a->m_value, t);
+                    EXPECT_EQ(b->m_value, t);
+                }
+            });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    EXPECT_EQ(pool.available(), 64U);
+    EXPECT_LE(dummy_one::m_count, 64);
+}
@@ -0,0 +1,188 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#include <recycle/demand_tracker.hpp>
+#include <recycle/no_locking_policy.hpp>
+#include <recycle/shared_pool.hpp>
+#include <recycle/unique_pool.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+using pool_type = recycle::unique_pool<uint32_t, recycle::no_locking_policy,
+                                       recycle::demand_tracker>;
+
+/// Allocates the given number of resources at once and releases them
+void burst(pool_type& pool, std::size_t count)
+{
+    std::vector<pool_type::pool_ptr> values;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        values.push_back(pool.allocate());
+    }
+}
+}
+
+/// Test that the resources in use and their peak are tracked
+TEST(test_demand_tracker, peak)
+{
+    pool_type pool;
+    auto& tracker = pool.observer();
+
+    {
+        auto v1 = pool.allocate();
+        auto v2 = pool.allocate();
+        EXPECT_EQ(tracker.in_use(), 2U);
+    }
+
+    EXPECT_EQ(tracker.in_use(), 0U);
+
+    tracker.tick();
+    EXPECT_DOUBLE_EQ(tracker.peak(), 2.0);
+    EXPECT_DOUBLE_EQ(tracker.miss_rate(), 1.0);
+    EXPECT_EQ(tracker.recommended_unused(), 2U);
+
+    // The second window only hits
+    burst(pool, 2);
+    tracker.tick();
+    EXPECT_DOUBLE_EQ(tracker.peak(), 2.0);
+    EXPECT_DOUBLE_EQ(tracker.miss_rate(), 0.75);
+}
+
+/// Test that releases dropped by the byte budget are tracked
+TEST(test_demand_tracker, byte_budget)
+{
+    pool_type pool;
+    pool.set_max_unused_bytes(sizeof(uint32_t));
+
+    burst(pool, 3);
+    EXPECT_EQ(pool.unused_resources(), 1U);
+    EXPECT_EQ(pool.observer().in_use(), 0U);
+}
+
+/// Test that sustained misses prewarm the pool
+TEST(test_demand_tracker, prewarm)
+{
+    pool_type pool;
+    pool.observer().set_sustain(2);
+
+    // Hold on to the resources so the pool keeps missing
+    std::vector<pool_type::pool_ptr> held;
+
+    for (std::size_t i = 0; i < 10; ++i)
+    {
+        held.push_back(pool.allocate());
+    }
+
+    EXPECT_EQ(recycle::adapt(pool), recycle::demand_tracker::action::none);
+
+    for (std::size_t i = 0; i < 10; ++i)
+    {
+        held.push_back(pool.allocate());
+    }
+
+    held.resize(5);
+    EXPECT_EQ(pool.unused_resources(), 15U);
+    pool.free_unused();
+
+    EXPECT_EQ(recycle::adapt(pool), recycle::demand_tracker::action::prewarm);
+
+    // Enough to bring the 5 resources in use up to the average peak
+    auto& tracker = pool.observer();
+    std::size_t peak = static_cast<std::size_t>(std::round(tracker.peak()));
+    EXPECT_EQ(pool.unused_resources(), peak - 5);
+}
+
+/// Test that sustained low demand shrinks the pool
+TEST(test_demand_tracker, shrink)
+{
+    pool_type pool;
+    pool.observer().set_sustain(2);
+    pool.observer().set_alpha(0.5);
+
+    burst(pool, 100);
+    EXPECT_EQ(recycle::adapt(pool), recycle::demand_tracker::action::none);
+    EXPECT_EQ(pool.unused_resources(), 100U);
+
+    // Demand drops to 10 resources
+    burst(pool, 10);
+    EXPECT_EQ(recycle::adapt(pool), recycle::demand_tracker::action::none);
+
+    burst(pool, 10);
+    EXPECT_EQ(recycle::adapt(pool), recycle::demand_tracker::action::shrink);
+
+    // The average peak after the windows 100, 10 and 10 is 32.5
+    EXPECT_DOUBLE_EQ(pool.observer().peak(), 32.5);
+    EXPECT_EQ(pool.unused_resources(), 33U);
+
+    // Eventually the pool retains what is needed at the trough
+    for (std::size_t i = 0; i < 20; ++i)
+    {
+        burst(pool, 10);
+        recycle::adapt(pool);
+    }
+
+    EXPECT_EQ(pool.unused_resources(), 10U);
+}
+
+/// Test the tracker with the shared_pool
+TEST(test_demand_tracker, shared_pool)
+{
+    recycle::shared_pool<uint32_t, recycle::no_locking_policy,
+                         recycle::demand_tracker>
+        pool;
+
+    auto v1 = pool.allocate();
+    auto v2 = v1;
+    EXPECT_EQ(pool.observer().in_use(), 1U);
+
+    v1.reset();
+    v2.reset();
+    EXPECT_EQ(pool.observer().in_use(), 0U);
+
+    // The released resource is already in the pool
+    EXPECT_EQ(pool.prewarm(4), 3U);
+    EXPECT_EQ(pool.unused_resources(), 4U);
+    EXPECT_EQ(pool.prewarm(2), 0U);
+}
+
+/// Test that a copied pool does not count the resources of the original
+TEST(test_demand_tracker, copy)
+{
+    pool_type pool;
+    pool.observer().set_sustain(5);
+
+    auto v1 = pool.allocate();
+    auto v2 = pool.allocate();
+    pool.observer().tick();
+    EXPECT_EQ(pool.observer().in_use(), 2U);
+
+    pool_type copy(pool);
+    EXPECT_EQ(copy.observer().in_use(), 0U);
+    EXPECT_DOUBLE_EQ(copy.observer().peak(), 0.0);
+
+    v1.reset();
+    v2.reset();
+    EXPECT_EQ(pool.observer().in_use(), 0U);
+
+    // The configuration is copied, the learned state is not
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        auto v = copy.allocate();
+        recycle::adapt(copy);
+    }
+    EXPECT_FALSE(copy.observer().should_prewarm());
+    EXPECT_EQ(copy.observer().in_use(), 0U);
+    EXPECT_EQ(copy.observer().recommended_unused(), 1U);
+
+    copy = pool;
+    EXPECT_EQ(copy.observer().in_use(), 0U);
+    EXPECT_DOUBLE_EQ(copy.observer().peak(), 0.0);
+}
@@ -0,0 +1,262 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#include <recycle/fixed_buffer_pool.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#if RECYCLE_HAS_IO_URING
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
+TEST(test_fixed_buffer_pool, api)
+{
+    recycle::fixed_buffer_pool<> pool(1000, 4);
+
+    EXPECT_EQ(pool.buffer_size(), 1000U);
+    EXPECT_EQ(pool.buffers(), 4U);
+    EXPECT_EQ(pool.unused_resources(), 4U);
+    ASSERT_EQ(pool.iovecs().size(), 4U);
+
+    for (const auto& iov : pool.iovecs())
+    {
+        EXPECT_EQ(iov.iov_len, 1000U);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(iov.iov_base) %
+                      recycle::fixed_buffer_pool<>::alignment,
+                  0U);
+    }
+
+    {
+        std::vector<recycle::fixed_buffer_pool<>::pool_ptr> buffers;
+
+        for (std::size_t i = 0; i < 4; ++i)
+        {
+            buffers.push_back(pool.allocate());
+
+            auto& b = buffers.back();
+            ASSERT_TRUE(b->is_registered());
+            EXPECT_EQ(b->size(), 1000U);
+            EXPECT_EQ(b->data(), pool.iovecs()[b->index()].iov_base);
+        }
+
+        // All registered buffers are in use, so we get a heap buffer
+        auto extra = pool.allocate();
+        EXPECT_FALSE(extra->is_registered());
+        EXPECT_EQ(extra->index(),
+                  recycle::fixed_buffer_pool<>::buffer::unregistered);
+        EXPECT_EQ(extra->size(), 1000U);
+    }
+
+    // The heap buffer is not kept in the pool
+    EXPECT_EQ(pool.unused_resources(), 4U);
+
+    // Only registered buffers are handed out while any is free
+    std::vector<recycle::fixed_buffer_pool<>::pool_ptr> buffers;
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+        buffers.push_back(pool.allocate());
+        EXPECT_TRUE(buffers.back()->is_registered());
+    }
+}
+
+/// Test that the indices of freed buffers are reused
+TEST(test_fixed_buffer_pool, free_unused)
+{
+    recycle::fixed_buffer_pool<> pool(100, 2);
+
+    auto b1 = pool.allocate();
+    int index = b1->index();
+
+    pool.free_unused();
+    EXPECT_EQ(pool.unused_resources(), 0U);
+
+    b1.reset();
+    EXPECT_EQ(pool.unused_resources(), 1U);
+
+    pool.free_unused();
+    EXPECT_EQ(pool.unused_resources(), 0U);
+
+    // The freed buffers are created again with their indices
+    auto b2 = pool.allocate();
+    auto b3 = pool.allocate();
+    EXPECT_TRUE(b2->is_registered());
+    EXPECT_TRUE(b3->is_registered());
+    EXPECT_TRUE(b2->index() == index || b3->index() == index);
+}
+
+#if RECYCLE_HAS_IO_URING
+namespace
+{
+/// Minimal io_uring instance using the raw system calls, so that the
+/// test does not depend on liburing
+struct ring
+{
+    bool setup()
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+
+        m_fd = static_cast<int>(::syscall(__NR_io_uring_setup, 4, &params));
+        if (m_fd < 0)
+        {
+            return false;
+        }
+
+        m_sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        m_cq_size =
+            params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+        {
+            m_sq_size = m_cq_size = std::max(m_sq_size, m_cq_size);
+        }
+
+        m_sq = ::mmap(nullptr, m_sq_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+        m_cq = m_sq;
+
+        if (!(params.features & IORING_FEAT_SINGLE_MMAP))
+        {
+            m_cq = ::mmap(nullptr, m_cq_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+        }
+
+        m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        m_sqes = static_cast<io_uring_sqe*>(
+            ::mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES));
+
+        uint8_t* sq = static_cast<uint8_t*>(m_sq);
+        m_sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        m_sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        m_sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+        uint8_t* cq = static_cast<uint8_t*>(m_cq);
+        m_cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        m_cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        return true;
+    }
+
+    ~ring()
+    {
+        if (m_fd < 0)
+        {
+            return;
+        }
+
+        ::munmap(m_sqes, m_sqes_size);
+        if (m_cq != m_sq)
+        {
+            ::munmap(m_cq, m_cq_size);
+        }
+        ::munmap(m_sq, m_sq_size);
+        ::close(m_fd);
+    }
+
+    /// Submits a read_fixed and waits for its completion
+    /// @return The result of the read
+    int read_fixed(int fd, uint8_t* data, std::size_t size, int index)
+    {
+        unsigned tail = *m_sq_tail;
+        unsigned slot = tail & *m_sq_mask;
+
+        io_uring_sqe* sqe = &m_sqes[slot];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(data);
+        sqe->len = static_cast<uint32_t>(size);
+        sqe->off = 0;
+        sqe->buf_index = static_cast<uint16_t>(index);
+
+        m_sq_array[slot] = slot;
+        __atomic_store_n(m_sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+        ::syscall(__NR_io_uring_enter, m_fd, 1, 1, IORING_ENTER_GETEVENTS,
+                  nullptr, 0);
+
+        unsigned head = __atomic_load_n(m_cq_head, __ATOMIC_ACQUIRE);
+        int result = m_cqes[head & *m_cq_mask].res;
+        __atomic_store_n(m_cq_head, head + 1, __ATOMIC_RELEASE);
+
+        return result;
+    }
+
+    int m_fd = -1;
+
+    void* m_sq = nullptr;
+    void* m_cq = nullptr;
+    io_uring_sqe* m_sqes = nullptr;
+
+    std::size_t m_sq_size = 0;
+    std::size_t m_cq_size = 0;
+    std::size_t m_sqes_size = 0;
+
+    unsigned* m_sq_tail = nullptr;
+    unsigned* m_sq_mask = nullptr;
+    unsigned* m_sq_array = nullptr;
+    unsigned* m_cq_head = nullptr;
+    unsigned* m_cq_mask = nullptr;
+    io_uring_cqe* m_cqes = nullptr;
+};
+}
+
+/// Test that a local file can be read into a registered buffer
+TEST(test_fixed_buffer_pool, read_fixed)
+{
+    ring r;
+    if (!r.setup())
+    {
+        GTEST_SKIP() << "io_uring is not available";
+    }
+
+    recycle::fixed_buffer_pool<> pool(4096, 8);
+
+    if (pool.register_buffers(r.m_fd) != 0)
+    {
+        GTEST_SKIP() << "Registering buffers is not permitted";
+    }
+
+    std::string path = testing::TempDir() + "recycle_test_read_fixed";
+    std::string content(3000, 'x');
+    for (std::size_t i = 0; i < content.size(); ++i)
+    {
+        content[i] = static_cast<char>('a' + i % 26);
+    }
+
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << content;
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    ASSERT_GE(fd, 0);
+
+    auto b1 = pool.allocate();
+    auto b2 = pool.allocate();
+    ASSERT_TRUE(b2->is_registered());
+
+    int read = r.read_fixed(fd, b2->data(), b2->size(), b2->index());
+
+    ASSERT_EQ(read, static_cast<int>(content.size()));
+    EXPECT_EQ(std::memcmp(b2->data(), content.data(), content.size()), 0);
+
+    ::close(fd);
+    std::remove(path.c_str());
+
+    EXPECT_EQ(pool.unregister_buffers(r.m_fd), 0);
+}
+#endif
@@ -0,0 +1,123 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#include <recycle/frame_pool.hpp>
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+// Counts the live objects
+struct counted
+{
+    counted()
+    {
+        ++m_count;
+    }
+
+    ~counted()
+    {
+        --m_count;
+    }
+
+    uint32_t m_value = 0;
+
+    static int32_t m_count;
+};
+
+int32_t counted::m_count = 0;
+}
+
+/// Test allocating values within a frame
+TEST(test_frame_pool, allocate)
+{
+    recycle::frame_pool<std::string> pool(4);
+    EXPECT_EQ(pool.chunk_capacity(), 4U);
+    EXPECT_EQ(pool.chunks(), 0U);
+
+    std::set<std::string*> values;
+    for (std::size_t i = 0; i < 10; ++i)
+    {
+        std::string* value = pool.allocate();
+        EXPECT_TRUE(value->empty());
+        value->assign("value");
+        values.insert(value);
+    }
+
+    EXPECT_EQ(values.size(), 10U);
+    EXPECT_EQ(pool.in_use(), 10U);
+    EXPECT_EQ(pool.unused_resources(), 0U);
+    EXPECT_EQ(pool.chunks(), 3U);
+}
+
+/// Test that reset returns all values at once
+TEST(test_frame_pool, reset)
+{
+    {
+        recycle::frame_pool<counted> pool(4);
+        EXPECT_EQ(pool.epoch(), 0U);
+
+        std::vector<counted*> first;
+        for (uint32_t i = 0; i < 6; ++i)
+        {
+            first.push_back(pool.allocate());
+            first.back()->m_value = i;
+        }
+
+        pool.reset();
+        EXPECT_EQ(pool.epoch(), 1U);
+        EXPECT_EQ(pool.in_use(), 0U);
+        EXPECT_EQ(pool.unused_resources(), 6U);
+        EXPECT_EQ(counted::m_count, 6);
+
+        // The values are handed out again in the same order as they were
+        for (uint32_t i = 0; i < 6; ++i)
+        {
+            counted* value = pool.allocate();
+            EXPECT_EQ(value, first[i]);
+            EXPECT_EQ(value->m_value, i);
+        }
+
+        // Only new values are constructed
+        pool.allocate();
+        EXPECT_EQ(counted::m_count, 7);
+        EXPECT_EQ(pool.chunks(), 2U);
+    }
+
+    EXPECT_EQ(counted::m_count, 0);
+}
+
+/// Test freeing the values not in use
+TEST(test_frame_pool, free_unused)
+{
+    recycle::frame_pool<counted> pool(4);
+
+    for (uint32_t i = 0; i < 10; ++i)
+    {
+        pool.allocate();
+    }
+
+    pool.reset();
+    pool.allocate();
+
+    pool.free_unused();
+    EXPECT_EQ(counted::m_count, 1);
+    EXPECT_EQ(pool.unused_resources(), 0U);
+    EXPECT_EQ(pool.chunks(), 1U);
+
+    pool.reset();
+    pool.free_unused();
+    EXPECT_EQ(counted::m_count, 0);
+    EXPECT_EQ(pool.chunks(), 0U);
+
+    // The pool is still usable
+    EXPECT_EQ(pool.allocate()->m_value, 0U);
+    EXPECT_EQ(counted::m_count, 1);
+}
@@ -0,0 +1,41 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#include <recycle/growth_policy.hpp>
+
+#include <gtest/gtest.h>
+
+/// Test that the default policy creates one resource at a time
+TEST(test_growth_policy, default)
+{
+    recycle::growth_policy growth;
+    EXPECT_EQ(growth.m_initial_batch, 1U);
+    EXPECT_EQ(growth.grow(1), 1U);
+}
+
+/// Test that the batch grows geometrically up to the maximum
+TEST(test_growth_policy, geometric)
+{
+    recycle::growth_policy growth;
+    growth.m_initial_batch = 4;
+    growth.m_factor = 1.5;
+    growth.m_max_batch = 20;
+
+    EXPECT_EQ(growth.grow(4), 6U);
+    EXPECT_EQ(growth.grow(6), 9U);
+    EXPECT_EQ(growth.grow(9), 14U);
+    EXPECT_EQ(growth.grow(14), 20U);
+    EXPECT_EQ(growth.grow(20), 20U);
+}
+
+/// Test a fixed batch size
+TEST(test_growth_policy, fixed)
+{
+    recycle::growth_policy growth;
+    growth.m_initial_batch = 8;
+
+    // The maximum never limits the initial batch
+    EXPECT_EQ(growth.grow(8), 8U);
+}
@@ -0,0 +1,239 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#include <recycle/handle_pool.hpp>
+
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+// Put tests classes in an anonymous namespace to avoid violations of
+// ODF (one-definition-rule) in other translation units
+namespace
+{
+// Default constructible dummy object
+struct dummy_one
+{
+    dummy_one()
+    {
+        ++m_count;
+    }
+
+    dummy_one(const dummy_one&)
+    {
+        ++m_count;
+    }
+
+    ~dummy_one()
+    {
+        --m_count;
+    }
+
+    uint32_t m_value = 0;
+
+    // Counter which will check how many object have been allocate
+    // and deallocated
+    static int32_t m_count;
+};
+
+int32_t dummy_one::m_count = 0;
+
+struct lock_policy
+{
+    using mutex_type = std::mutex;
+    using lock_type = std::lock_guard<mutex_type>;
+};
+}
+
+TEST(test_handle_pool, handle_size)
+{
+    EXPECT_EQ(sizeof(recycle::handle_pool<dummy_one>::handle), 8U);
+}
+
+/// Test the basic API construct and free some objects
+TEST(test_handle_pool, api)
+{
+    {
+        recycle::handle_pool<dummy_one> pool;
+
+        EXPECT_EQ(pool.unused_resources(), 0U);
+
+        auto h1 = pool.allocate();
+        auto h2 = pool.allocate();
+
+        EXPECT_NE(h1, h2);
+        EXPECT_EQ(dummy_one::m_count, 2);
+
+        ASSERT_NE(pool.get(h1), nullptr);
+        pool.get(h1)->m_value = 42;
+
+        EXPECT_TRUE(pool.release(h1));
+        EXPECT_EQ(pool.unused_resources(), 1U);
+
+        // The value is recycled, not destroyed
+        EXPECT_EQ(dummy_one::m_count, 2);
+
+        auto h3 = pool.allocate();
+        EXPECT_EQ(h3.m_index, h1.m_index);
+        EXPECT_EQ(pool.get(h3)->m_value, 42U);
+        EXPECT_EQ(pool.unused_resources(), 0U);
+
+        EXPECT_TRUE(pool.release(h2));
+        pool.free_unused();
+
+        EXPECT_EQ(dummy_one::m_count, 1);
+        EXPECT_EQ(pool.unused_resources(), 1U);
+
+        // Slot memory is reused and a new value constructed
+        auto h4 = pool.allocate();
+        EXPECT_EQ(h4.m_index, h2.m_index);
+        EXPECT_EQ(dummy_one::m_count, 2);
+    }
+
+    // Outstanding values are destroyed with the pool
+    EXPECT_EQ(dummy_one::m_count, 0);
+}
+
+/// Test that stale handles are detected
+TEST(test_handle_pool, stale_handle)
+{
+    recycle::handle_pool<dummy_one> pool;
+
+    recycle::handle_pool<dummy_one>::handle empty;
+    EXPECT_FALSE(pool.valid(empty));
+    EXPECT_EQ(pool.get(empty), nullptr);
+
+    auto h1 = pool.allocate();
+    EXPECT_TRUE(pool.valid(h1));
+
+    EXPECT_TRUE(pool.release(h1));
+    EXPECT_FALSE(pool.valid(h1));
+    EXPECT_EQ(pool.get(h1), nullptr);
+    EXPECT_FALSE(pool.release(h1));
+
+    // The slot is reused with a new generation
+    auto h2 = pool.allocate();
+    EXPECT_EQ(h2.m_index, h1.m_index);
+    EXPECT_NE(h2.m_generation, h1.m_generation);
+    EXPECT_FALSE(pool.valid(h1));
+    EXPECT_TRUE(pool.valid(h2));
+}
+
+/// Test that the pool grows across pages
+TEST(test_handle_pool, pages)
+{
+    using pool_type = recycle::handle_pool<uint32_t>;
+    pool_type pool;
+
+    std::vector<pool_type::handle> handles;
+
+    for (uint32_t i = 0; i < 3 * pool_type::page_size; ++i)
+    {
+        handles.push_back(pool.allocate());
+        *pool.get(handles.back()) = i;
+    }
+
+    for (uint32_t i = 0; i < handles.size(); ++i)
+    {
+        EXPECT_EQ(handles[i].m_index, i);
+        EXPECT_EQ(*pool.get(handles[i]), i);
+    }
+
+    for (auto& h : handles)
+    {
+        EXPECT_TRUE(pool.release(h));
+    }
+
+    EXPECT_EQ(pool.unused_resources(), handles.size());
+}
+
+/// Test that the recycle functionality works
+TEST(test_handle_pool, recycle)
+{
+    std::size_t recycled = 0;
+
+    auto recycle = [&recycled](uint32_t& value)
+    {
+        value = 0;
+        ++recycled;
+    };
+
+    recycle::handle_pool<uint32_t> pool([]() { return 7U; }, recycle);
+
+    auto h1 = pool.allocate();
+    EXPECT_EQ(*pool.get(h1), 7U);
+
+    pool.release(h1);
+    EXPECT_EQ(recycled, 1U);
+
+    auto h2 = pool.allocate();
+    EXPECT_EQ(*pool.get(h2), 0U);
+}
+
+/// Test that a slot is not lost when the allocate function throws
+TEST(test_handle_pool, allocate_throws)
+{
+    bool fail = true;
+
+    recycle::handle_pool<uint32_t> pool(
+        [&fail]()
+        {
+            if (fail)
+            {
+                throw std::runtime_error("allocate failed");
+            }
+            return 7U;
+        });
+
+    EXPECT_THROW(pool.allocate(), std::runtime_error);
+    EXPECT_EQ(pool.unused_resources(), 1U);
+
+    // The slot is reused once the allocate function succeeds
+    fail = false;
+    auto h = pool.allocate();
+    EXPECT_EQ(h.m_index, 0U);
+    EXPECT_EQ(*pool.get(h), 7U);
+    EXPECT_EQ(pool.unused_resources(), 0U);
+}
+
+/// Test that we are thread safe
+TEST(test_handle_pool, thread)
+{
+    recycle::handle_pool<uint32_t, lock_policy> pool;
+
+    auto run = [&pool]()
+    {
+        for (uint32_t i = 0; i < 1000; ++i)
+        {
+            auto h1 = pool.allocate();
+            auto h2 = pool.allocate();
+
+            *pool.get(h1) = i;
+            *pool.get(h2) = i;
+
+            EXPECT_TRUE(pool.release(h1));
+            EXPECT_TRUE(pool.release(h2));
+        }
+    };
+
+    const std::size_t number_threads = 8;
+    std::thread t[number_threads];
+
+    for (std::size_t i = 0; i < number_threads; ++i)
+    {
+        t[i] = std::thread(run);
+    }
+
+    for (std::size_t i = 0; i < number_threads; ++i)
+    {
+        t[i].join();
+    }
+
+    EXPECT_LE(pool.unused_resources(), 2 * number_threads);
+}
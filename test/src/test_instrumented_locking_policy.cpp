@@ -0,0 +1,146 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#include <recycle/instrumented_locking_policy.hpp>
+#include <recycle/mutex_locking_policy.hpp>
+#include <recycle/no_locking_policy.hpp>
+#include <recycle/unique_pool.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+/// The number of times a lock of the counting_locking_policy has started
+/// to acquire its mutex
+std::atomic<uint32_t> lock_attempts{0};
+
+/// Locking policy counting the attempts to lock, so a test can tell when
+/// a thread is about to block
+struct counting_locking_policy
+{
+    using mutex_type = std::mutex;
+
+    class lock_type
+    {
+    public:
+        lock_type(mutex_type& mutex) : m_mutex(mutex)
+        {
+            ++lock_attempts;
+            m_mutex.lock();
+        }
+
+        ~lock_type()
+        {
+            m_mutex.unlock();
+        }
+
+    private:
+        mutex_type& m_mutex;
+    };
+};
+}
+
+/// Test that uncontended acquisitions are counted
+TEST(test_instrumented_locking_policy, uncontended)
+{
+    using policy =
+        recycle::instrumented_locking_policy<recycle::no_locking_policy>;
+
+    policy::mutex_type mutex;
+
+    for (uint32_t i = 0; i < 10; ++i)
+    {
+        policy::lock_type lock(mutex);
+    }
+
+    auto stats = mutex.statistics();
+    EXPECT_EQ(stats.m_acquisitions, 10U);
+    EXPECT_EQ(stats.m_contended, 0U);
+    EXPECT_EQ(stats.m_wait_ns, 0U);
+    EXPECT_EQ(stats.m_wait_histogram[0], 10U);
+
+    mutex.reset();
+    EXPECT_EQ(mutex.statistics().m_acquisitions, 0U);
+}
+
+/// Test that waiting for a held lock is recorded
+TEST(test_instrumented_locking_policy, contended)
+{
+    using policy =
+        recycle::instrumented_locking_policy<counting_locking_policy>;
+
+    policy::mutex_type mutex;
+    std::thread waiter;
+
+    {
+        policy::lock_type lock(mutex);
+        uint32_t attempts = lock_attempts.load();
+
+        waiter = std::thread([&mutex]() { policy::lock_type inner(mutex); });
+
+        // The waiter has checked whether the lock is held once it
+        // attempts to acquire the inner lock
+        while (lock_attempts.load() == attempts)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    waiter.join();
+
+    auto stats = mutex.statistics();
+    EXPECT_EQ(stats.m_acquisitions, 2U);
+    EXPECT_EQ(stats.m_contended, 1U);
+    EXPECT_GT(stats.m_wait_ns, 0U);
+
+    uint64_t total = std::accumulate(stats.m_wait_histogram.begin(),
+                                     stats.m_wait_histogram.end(),
+                                     uint64_t{0});
+    EXPECT_EQ(total, 2U);
+}
+
+/// Test the policy with a pool
+TEST(test_instrumented_locking_policy, pool)
+{
+    using policy =
+        recycle::instrumented_locking_policy<recycle::mutex_locking_policy>;
+
+    recycle::unique_pool<uint32_t, policy> pool;
+    recycle::unique_pool<uint32_t, policy> other;
+
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < 4; ++t)
+    {
+        threads.emplace_back(
+            [&pool]()
+            {
+                for (uint32_t i = 0; i < 1000; ++i)
+                {
+                    auto value = pool.allocate();
+                }
+            });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    auto stats = pool.mutex().statistics();
+
+    // Every allocation and every recycle takes the lock
+    EXPECT_GE(stats.m_acquisitions, 8000U);
+    EXPECT_LE(stats.m_contended, stats.m_acquisitions);
+
+    // The statistics are kept per pool
+    EXPECT_EQ(other.mutex().statistics().m_acquisitions, 0U);
+}
@@ -0,0 +1,250 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#include <recycle/local_pool.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+#include <gtest/gtest.h>
+
+// Put tests classes in an anonymous namespace to avoid violations of
+// ODF (one-definition-rule) in other translation units
+namespace
+{
+// Default constructible dummy object
+struct dummy_one
+{
+    dummy_one()
+    {
+        ++m_count;
+    }
+
+    ~dummy_one()
+    {
+        --m_count;
+    }
+
+    // Counter which will check how many object have been allocate
+    // and deallocated
+    static int32_t m_count;
+};
+
+int32_t dummy_one::m_count = 0;
+
+// Non Default constructible dummy object
+struct dummy_two
+{
+    dummy_two(std::size_t)
+    {
+        ++m_count;
+    }
+
+    ~dummy_two()
+    {
+        --m_count;
+    }
+
+    static int32_t m_count;
+};
+
+int32_t dummy_two::m_count = 0;
+
+template <class T>
+struct is_regular
+    : std::integral_constant<bool, std::is_default_constructible<T>::value &&
+                                       std::is_copy_constructible<T>::value &&
+                                       std::is_move_constructible<T>::value &&
+                                       std::is_copy_assignable<T>::value &&
+                                       std::is_move_assignable<T>::value>
+{
+};
+}
+
+TEST(test_local_pool, regular_type)
+{
+    EXPECT_TRUE(is_regular<recycle::local_pool<dummy_one>>::value);
+    EXPECT_FALSE(is_regular<recycle::local_pool<dummy_two>>::value);
+}
+
+/// The pool_ptr only carries a plain pointer to the pool besides the
+/// pointer to the resource
+TEST(test_local_pool, pool_ptr_size)
+{
+    EXPECT_EQ(sizeof(recycle::local_pool<dummy_one>::pool_ptr),
+              2 * sizeof(void*));
+}
+
+/// Test the basic API construct and free some objects
+TEST(test_local_pool, api)
+{
+    {
+        recycle::local_pool<dummy_one> pool;
+
+        EXPECT_EQ(pool.unused_resources(), 0U);
+
+        {
+            auto d1 = pool.allocate();
+            EXPECT_EQ(pool.unused_resources(), 0U);
+        }
+
+        EXPECT_EQ(pool.unused_resources(), 1U);
+
+        auto d2 = pool.allocate();
+        auto d3 = pool.allocate();
+
+        EXPECT_EQ(pool.unused_resources(), 0U);
+        EXPECT_EQ(dummy_one::m_count, 2);
+
+        d2.reset();
+        EXPECT_EQ(pool.unused_resources(), 1U);
+
+        pool.free_unused();
+
+        EXPECT_EQ(pool.unused_resources(), 0U);
+        EXPECT_EQ(dummy_one::m_count, 1);
+    }
+
+    EXPECT_EQ(dummy_one::m_count, 0);
+}
+
+/// Test that everything works even if the pool dies before the
+/// objects allocated
+TEST(test_local_pool, pool_die_before_object)
+{
+    {
+        recycle::local_pool<dummy_one>::pool_ptr d1;
+        recycle::local_pool<dummy_one>::pool_ptr d2;
+
+        {
+            recycle::local_pool<dummy_one> pool;
+
+            d1 = pool.allocate();
+            d2 = pool.allocate();
+
+            {
+                auto d3 = pool.allocate();
+            }
+
+            EXPECT_EQ(dummy_one::m_count, 3);
+        }
+
+        // The unused object is freed with the pool
+        EXPECT_EQ(dummy_one::m_count, 2);
+
+        d1.reset();
+        EXPECT_EQ(dummy_one::m_count, 1);
+    }
+
+    EXPECT_EQ(dummy_one::m_count, 0);
+}
+
+/// Test that the recycle functionality works
+TEST(test_local_pool, recycle)
+{
+    std::size_t recycled = 0;
+
+    auto recycle = [&recycled](std::unique_ptr<dummy_two>& o)
+    {
+        EXPECT_TRUE((bool)o);
+        ++recycled;
+    };
+
+    auto make = []() -> std::unique_ptr<dummy_two>
+    { return std::make_unique<dummy_two>(3U); };
+
+    {
+        recycle::local_pool<dummy_two> pool(make, recycle);
+
+        auto o1 = pool.allocate();
+        o1.reset();
+
+        EXPECT_EQ(recycled, 1U);
+        EXPECT_EQ(dummy_two::m_count, 1);
+    }
+
+    EXPECT_EQ(dummy_two::m_count, 0);
+}
+
+/// Test that the resources reset by the recycle function are destroyed
+/// instead of being put back into the pool
+TEST(test_local_pool, recycle_drop)
+{
+    dummy_two* drop = nullptr;
+
+    auto recycle = [&drop](std::unique_ptr<dummy_two>& o)
+    {
+        if (o.get() == drop)
+        {
+            o.reset();
+        }
+    };
+
+    auto make = []() -> std::unique_ptr<dummy_two>
+    { return std::make_unique<dummy_two>(3U); };
+
+    recycle::local_pool<dummy_two>::pool_ptr o3;
+
+    {
+        recycle::local_pool<dummy_two> pool(make, recycle);
+
+        auto o1 = pool.allocate();
+        auto o2 = pool.allocate();
+        drop = o2.get();
+
+        o1.reset();
+        o2.reset();
+
+        EXPECT_EQ(pool.unused_resources(), 1U);
+        EXPECT_EQ(dummy_two::m_count, 1);
+
+        o1 = pool.allocate();
+        o3 = pool.allocate();
+        EXPECT_TRUE(o1);
+        EXPECT_TRUE(o3);
+        EXPECT_EQ(dummy_two::m_count, 2);
+    }
+
+    // The pool is kept alive by o3 until it is released
+    EXPECT_EQ(dummy_two::m_count, 1);
+    o3.reset();
+    EXPECT_EQ(dummy_two::m_count, 0);
+}
+
+/// Test that copying and moving the pool works
+TEST(test_local_pool, copy_and_move)
+{
+    {
+        recycle::local_pool<dummy_one> pool;
+
+        auto o1 = pool.allocate();
+        auto o2 = pool.allocate();
+
+        o1.reset();
+
+        recycle::local_pool<dummy_one> copy(pool);
+
+        EXPECT_EQ(pool.unused_resources(), 1U);
+        EXPECT_EQ(copy.unused_resources(), 1U);
+        EXPECT_EQ(dummy_one::m_count, 3);
+
+        recycle::local_pool<dummy_one> moved(std::move(pool));
+
+        o2.reset();
+
+        EXPECT_EQ(moved.unused_resources(), 2U);
+
+        recycle::local_pool<dummy_one> assigned;
+        assigned = copy;
+        EXPECT_EQ(assigned.unused_resources(), 1U);
+        EXPECT_EQ(dummy_one::m_count, 4);
+
+        assigned = std::move(moved);
+        EXPECT_EQ(assigned.unused_resources(), 2U);
+    }
+
+    EXPECT_EQ(dummy_one::m_count, 0);
+}
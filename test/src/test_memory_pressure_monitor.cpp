@@ -0,0 +1,144 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#include <recycle/memory_pressure_monitor.hpp>
+
+#include <recycle/unique_pool.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+void write_file(const std::string& path, const std::string& content)
+{
+    std::ofstream file(path, std::ios::trunc);
+    file << content;
+}
+
+/// Fill the pool with count unused objects
+void fill(recycle::unique_pool<std::vector<uint8_t>>& pool, std::size_t count)
+{
+    std::vector<recycle::unique_pool<std::vector<uint8_t>>::pool_ptr> objects;
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        objects.push_back(pool.allocate());
+    }
+}
+}
+
+TEST(test_memory_pressure_monitor, psi)
+{
+    std::string path = testing::TempDir() + "recycle_test_psi";
+
+    recycle::unique_pool<std::vector<uint8_t>> pool;
+    recycle::pool_registry registry;
+    auto registration = registry.add("pool", pool);
+
+    recycle::memory_pressure_monitor monitor(registry);
+    monitor.watch_psi(path, 10.0);
+
+    // A missing file never signals pressure
+    std::remove(path.c_str());
+    fill(pool, 4);
+    EXPECT_FALSE(monitor.poll());
+    EXPECT_EQ(pool.unused_resources(), 4U);
+
+    write_file(path, "some avg10=2.50 avg60=1.00 avg300=0.50 total=100\n"
+                     "full avg10=0.00 avg60=0.00 avg300=0.00 total=0\n");
+    EXPECT_FALSE(monitor.poll());
+    EXPECT_EQ(pool.unused_resources(), 4U);
+
+    write_file(path, "some avg10=12.00 avg60=3.00 avg300=1.00 total=900\n"
+                     "full avg10=5.00 avg60=1.00 avg300=0.10 total=100\n");
+    EXPECT_TRUE(monitor.poll());
+    EXPECT_EQ(pool.unused_resources(), 0U);
+    EXPECT_EQ(monitor.pressure_events(), 1U);
+
+    std::remove(path.c_str());
+}
+
+TEST(test_memory_pressure_monitor, cgroup)
+{
+    std::string directory = testing::TempDir();
+    std::string prefix = directory + "/memory.";
+
+    write_file(prefix + "current", "500\n");
+    write_file(prefix + "max", "max\n");
+    write_file(prefix + "high", "1000\n");
+    write_file(prefix + "events", "low 0\nhigh 3\nmax 0\noom 0\n");
+
+    recycle::unique_pool<std::vector<uint8_t>> pool;
+    recycle::pool_registry registry;
+    auto registration = registry.add("pool", pool);
+
+    recycle::memory_pressure_monitor monitor(registry);
+    monitor.watch_cgroup(directory, 0.9);
+    monitor.set_release_fraction(0.5);
+
+    fill(pool, 4);
+    EXPECT_FALSE(monitor.poll());
+
+    // Usage close to memory.high
+    write_file(prefix + "current", "950\n");
+    EXPECT_TRUE(monitor.poll());
+    EXPECT_EQ(pool.unused_resources(), 2U);
+
+    // The "high" event counter increases
+    write_file(prefix + "current", "500\n");
+    EXPECT_FALSE(monitor.poll());
+    write_file(prefix + "events", "low 0\nhigh 4\nmax 0\noom 0\n");
+    EXPECT_TRUE(monitor.poll());
+    EXPECT_EQ(pool.unused_resources(), 1U);
+    EXPECT_FALSE(monitor.poll());
+
+    // With both limits set, the pressure is measured against the smaller
+    write_file(prefix + "max", "2000\n");
+    write_file(prefix + "current", "950\n");
+    EXPECT_TRUE(monitor.poll());
+
+    write_file(prefix + "high", "4000\n");
+    EXPECT_FALSE(monitor.poll());
+    write_file(prefix + "current", "1900\n");
+    EXPECT_TRUE(monitor.poll());
+
+    for (const char* name : {"current", "max", "high", "events"})
+    {
+        std::remove((prefix + name).c_str());
+    }
+}
+
+TEST(test_memory_pressure_monitor, background_thread)
+{
+    std::string path = testing::TempDir() + "recycle_test_psi_thread";
+    write_file(path, "some avg10=50.00 avg60=3.00 avg300=1.00 total=900\n");
+
+    recycle::unique_pool<std::vector<uint8_t>> pool;
+    recycle::pool_registry registry;
+    auto registration = registry.add("pool", pool);
+
+    {
+        recycle::memory_pressure_monitor monitor(registry);
+        monitor.watch_psi(path);
+        monitor.start(std::chrono::milliseconds(1));
+
+        while (monitor.pressure_events() == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        monitor.stop();
+    }
+
+    std::remove(path.c_str());
+}
@@ -0,0 +1,162 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#include <recycle/mmap_arena.hpp>
+#include <recycle/slab_pool.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <system_error>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace
+{
+struct header
+{
+    uint32_t m_sequence;
+    uint8_t m_data[60];
+};
+
+recycle::mmap_arena::options no_huge_pages()
+{
+    recycle::mmap_arena::options options;
+    options.m_huge_pages = false;
+    return options;
+}
+
+/// @return The number of resident pages of the memory
+std::size_t resident_pages(void* memory, std::size_t bytes)
+{
+    std::size_t page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    std::vector<unsigned char> pages((bytes + page_size - 1) / page_size);
+
+    if (::mincore(memory, bytes, pages.data()) != 0)
+    {
+        return 0;
+    }
+
+    std::size_t resident = 0;
+    for (unsigned char page : pages)
+    {
+        resident += page & 1;
+    }
+    return resident;
+}
+}
+
+/// Test allocating, decommitting and reusing slabs
+TEST(test_mmap_arena, allocate_deallocate)
+{
+    recycle::mmap_arena arena(1 << 20);
+    EXPECT_EQ(arena.reserved_bytes(), 1U << 20);
+    EXPECT_EQ(arena.committed_bytes(), 0U);
+
+    void* s1 = arena.allocate(100);
+    void* s2 = arena.allocate(5000);
+    EXPECT_TRUE(arena.contains(s1));
+    EXPECT_TRUE(arena.contains(s2));
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(s1) %
+                  recycle::mmap_arena::huge_page_size,
+              0U);
+
+    std::memset(s1, 0xff, 100);
+    EXPECT_GT(arena.committed_bytes(), 0U);
+
+    // The decommitted slab is reused and reads as zero
+    arena.deallocate(s1, 100);
+    void* s3 = arena.allocate(100);
+    EXPECT_EQ(s3, s1);
+    EXPECT_EQ(static_cast<uint8_t*>(s3)[0], 0U);
+
+    arena.deallocate(s2, 5000);
+    arena.deallocate(s3, 100);
+    EXPECT_EQ(arena.committed_bytes(), 0U);
+}
+
+/// Test that an exhausted arena throws
+TEST(test_mmap_arena, exhausted)
+{
+    recycle::mmap_arena arena(8192, no_huge_pages());
+
+    arena.allocate(4096);
+    arena.allocate(4096);
+    EXPECT_THROW(arena.allocate(4096), std::bad_alloc);
+}
+
+/// Test pre-faulting and locking the memory
+TEST(test_mmap_arena, populate_and_lock)
+{
+    recycle::mmap_arena::options options = no_huge_pages();
+    options.m_populate = true;
+    options.m_lock = true;
+
+    recycle::mmap_arena arena(1 << 16, options);
+
+    void* slab = nullptr;
+    try
+    {
+        slab = arena.allocate(4096);
+    }
+    catch (const std::system_error& error)
+    {
+        GTEST_SKIP() << "mlock is not permitted: " << error.what();
+    }
+
+    std::memset(slab, 1, 4096);
+    arena.deallocate(slab, 4096);
+}
+
+/// Test that pre-faulted slabs are faulted in again when reused
+TEST(test_mmap_arena, populate_reused)
+{
+    recycle::mmap_arena::options options = no_huge_pages();
+    options.m_populate = true;
+
+    recycle::mmap_arena arena(1 << 16, options);
+
+    void* slab = arena.allocate(1 << 14);
+    std::size_t pages = resident_pages(slab, 1 << 14);
+    EXPECT_GT(pages, 0U);
+
+    arena.deallocate(slab, 1 << 14);
+    EXPECT_EQ(resident_pages(slab, 1 << 14), 0U);
+
+    void* reused = arena.allocate(1 << 14);
+    EXPECT_EQ(reused, slab);
+    EXPECT_EQ(resident_pages(reused, 1 << 14), pages);
+}
+
+/// Test the arena with a slab_pool
+TEST(test_mmap_arena, slab_pool)
+{
+    using pool_type = recycle::slab_pool<header, recycle::no_locking_policy,
+                                         recycle::mmap_arena>;
+
+    pool_type pool(64, recycle::mmap_arena(1 << 24));
+
+    std::vector<pool_type::pool_ptr> headers;
+    for (uint32_t i = 0; i < 200; ++i)
+    {
+        headers.push_back(pool.allocate());
+        headers.back()->m_sequence = i;
+    }
+
+    EXPECT_EQ(pool.slabs(), 4U);
+
+    headers.clear();
+    pool.free_unused();
+    EXPECT_EQ(pool.slabs(), 0U);
+
+    // Decommitted slabs are reused
+    auto h = pool.allocate();
+    EXPECT_EQ(h->m_sequence, 0U);
+    EXPECT_EQ(pool.slabs(), 1U);
+}
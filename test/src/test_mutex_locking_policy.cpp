@@ -0,0 +1,74 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#include <recycle/mutex_locking_policy.hpp>
+#include <recycle/shared_pool.hpp>
+#include <recycle/unique_pool.hpp>
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+/// Test that the lock provides mutual exclusion
+TEST(test_mutex_locking_policy, mutual_exclusion)
+{
+    using policy = recycle::mutex_locking_policy;
+
+    policy::mutex_type mutex;
+    uint64_t counter = 0;
+
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < 4; ++t)
+    {
+        threads.emplace_back(
+            [&]()
+            {
+                for (uint32_t i = 0; i < 10000; ++i)
+                {
+                    policy::lock_type lock(mutex);
+                    ++counter;
+                }
+            });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    EXPECT_EQ(counter, 40000U);
+}
+
+/// Test that the policy works with the pools
+TEST(test_mutex_locking_policy, pools)
+{
+    recycle::shared_pool<uint32_t, recycle::mutex_locking_policy> shared;
+    recycle::unique_pool<uint32_t, recycle::mutex_locking_policy> unique;
+
+    auto run = [&]()
+    {
+        for (uint32_t i = 0; i < 1000; ++i)
+        {
+            auto a = shared.allocate();
+            auto b = unique.allocate();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < 4; ++t)
+    {
+        threads.emplace_back(run);
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    EXPECT_LE(shared.unused_resources(), 4U);
+    EXPECT_LE(unique.unused_resources(), 4U);
+}
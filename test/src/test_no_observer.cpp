@@ -0,0 +1,46 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#include <recycle/no_observer.hpp>
+
+#include <recycle/shared_pool.hpp>
+#include <recycle/unique_pool.hpp>
+
+#include <type_traits>
+
+#include <gtest/gtest.h>
+
+// The no_observer holds no state, so it adds nothing to the pools
+static_assert(std::is_empty<recycle::no_observer>::value,
+              "The no_observer must be empty");
+
+// The pools use the no_observer unless told otherwise
+static_assert(std::is_same<recycle::unique_pool<int>::observer_type,
+                           recycle::no_observer>::value,
+              "The unique_pool must default to the no_observer");
+static_assert(std::is_same<recycle::shared_pool<int>::observer_type,
+                           recycle::no_observer>::value,
+              "The shared_pool must default to the no_observer");
+
+/// Test that the events can be sent to the observer of a pool
+TEST(test_no_observer, events)
+{
+    recycle::unique_pool<int> pool;
+
+    recycle::no_observer& observer = pool.observer();
+    observer.on_allocate(&pool, 0);
+    observer.on_miss(&pool);
+    observer.on_recycle(&pool, 1);
+    observer.on_free_unused(&pool, 1);
+
+    // The pool itself is not affected
+    EXPECT_EQ(pool.unused_resources(), 0U);
+
+    {
+        auto o1 = pool.allocate();
+    }
+
+    EXPECT_EQ(pool.unused_resources(), 1U);
+}
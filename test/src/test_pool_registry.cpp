@@ -0,0 +1,204 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#include <recycle/pool_registry.hpp>
+
+#include <recycle/mutex_locking_policy.hpp>
+#include <recycle/shared_pool.hpp>
+#include <recycle/unique_pool.hpp>
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+using buffer = std::vector<uint8_t>;
+
+std::size_t buffer_size(const buffer& b)
+{
+    return b.size();
+}
+
+/// Fill the pool with count unused buffers of the given size
+template <class Pool>
+void fill(Pool& pool, std::size_t count, std::size_t size)
+{
+    std::vector<decltype(pool.allocate())> buffers;
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        buffers.push_back(pool.allocate());
+        buffers.back()->resize(size);
+    }
+}
+}
+
+TEST(test_pool_registry, statistics)
+{
+    recycle::unique_pool<buffer> small;
+    recycle::shared_pool<buffer> large;
+
+    small.set_size_function(buffer_size);
+    large.set_size_function(buffer_size);
+
+    recycle::pool_registry registry;
+
+    {
+        auto r1 = registry.add("small", small);
+        auto r2 = registry.add("large", large);
+
+        EXPECT_EQ(registry.pools(), 2U);
+
+        fill(small, 4, 10);
+        fill(large, 2, 1000);
+
+        EXPECT_EQ(registry.unused_resources(), 6U);
+        EXPECT_EQ(registry.unused_bytes(), 2040U);
+
+        auto stats = registry.statistics();
+        ASSERT_EQ(stats.size(), 2U);
+        EXPECT_EQ(stats[0].m_name, "small");
+        EXPECT_EQ(stats[0].m_unused_resources, 4U);
+        EXPECT_EQ(stats[0].m_unused_bytes, 40U);
+        EXPECT_EQ(stats[1].m_name, "large");
+        EXPECT_EQ(stats[1].m_unused_resources, 2U);
+        EXPECT_EQ(stats[1].m_unused_bytes, 2000U);
+
+        r1.reset();
+        EXPECT_EQ(registry.pools(), 1U);
+    }
+
+    EXPECT_EQ(registry.pools(), 0U);
+}
+
+TEST(test_pool_registry, largest_first)
+{
+    recycle::unique_pool<buffer> small;
+    recycle::unique_pool<buffer> large;
+
+    small.set_size_function(buffer_size);
+    large.set_size_function(buffer_size);
+
+    recycle::pool_registry registry;
+    auto r1 = registry.add("small", small);
+    auto r2 = registry.add("large", large);
+
+    fill(small, 10, 10);
+    fill(large, 10, 100);
+
+    // Within the budget nothing happens
+    registry.set_max_unused_bytes(2000);
+    EXPECT_EQ(registry.enforce_budget(), 0U);
+
+    registry.set_max_unused_bytes(700);
+    EXPECT_EQ(registry.enforce_budget(), 400U);
+
+    EXPECT_EQ(small.unused_resources(), 10U);
+    EXPECT_EQ(large.unused_resources(), 6U);
+    EXPECT_LE(registry.unused_bytes(), 700U);
+
+    registry.free_unused();
+    EXPECT_EQ(registry.unused_bytes(), 0U);
+}
+
+TEST(test_pool_registry, least_recently_used)
+{
+    recycle::unique_pool<buffer> idle;
+    recycle::unique_pool<buffer> busy;
+
+    idle.set_size_function(buffer_size);
+    busy.set_size_function(buffer_size);
+
+    recycle::pool_registry registry;
+    registry.set_trim_order(recycle::pool_registry::order::least_recently_used);
+
+    auto r1 = registry.add("idle", idle);
+    auto r2 = registry.add("busy", busy);
+
+    fill(idle, 5, 10);
+    EXPECT_EQ(registry.enforce_budget(), 0U);
+
+    // Only the busy pool is used since the last call
+    fill(busy, 5, 100);
+
+    registry.set_max_unused_bytes(500);
+    EXPECT_EQ(registry.enforce_budget(), 50U);
+
+    EXPECT_EQ(idle.unused_resources(), 0U);
+    EXPECT_EQ(busy.unused_resources(), 5U);
+}
+
+/// Test that a pool handing out and taking back the same number of
+/// resources between two trims is seen as used when it counts its uses
+TEST(test_pool_registry, use_counter)
+{
+    using pool_type =
+        recycle::unique_pool<buffer, recycle::mutex_locking_policy,
+                             recycle::pool_registry::use_counter>;
+
+    pool_type idle;
+    pool_type hot;
+
+    idle.set_size_function(buffer_size);
+    hot.set_size_function(buffer_size);
+
+    recycle::pool_registry registry;
+    registry.set_trim_order(recycle::pool_registry::order::least_recently_used);
+
+    auto r1 = registry.add("idle", idle);
+    auto r2 = registry.add("hot", hot);
+
+    fill(idle, 5, 100);
+    fill(hot, 5, 100);
+    EXPECT_EQ(registry.enforce_budget(), 0U);
+
+    // The number of unused resources of the hot pool does not change
+    fill(hot, 5, 100);
+    EXPECT_EQ(hot.unused_resources(), 5U);
+    EXPECT_EQ(hot.observer().uses(), 10U);
+
+    registry.set_max_unused_bytes(500);
+    EXPECT_EQ(registry.enforce_budget(), 500U);
+
+    EXPECT_EQ(idle.unused_resources(), 0U);
+    EXPECT_EQ(hot.unused_resources(), 5U);
+
+    // A copy of a pool has not been used
+    pool_type copy(hot);
+    EXPECT_EQ(copy.observer().uses(), 0U);
+}
+
+/// Test that pools may be used and unregistered while being trimmed
+TEST(test_pool_registry, trim_concurrently)
+{
+    using pool_type =
+        recycle::unique_pool<buffer, recycle::mutex_locking_policy>;
+
+    recycle::pool_registry registry;
+
+    std::thread trimmer(
+        [&registry]()
+        {
+            for (uint32_t i = 0; i < 1000; ++i)
+            {
+                registry.free_unused();
+            }
+        });
+
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        pool_type pool;
+        pool.set_size_function(buffer_size);
+        auto registration = registry.add("pool", pool);
+        fill(pool, 4, 10);
+        EXPECT_LE(registry.unused_bytes(), 40U);
+    }
+
+    trimmer.join();
+    EXPECT_EQ(registry.pools(), 0U);
+}
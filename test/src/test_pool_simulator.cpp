@@ -0,0 +1,154 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#include <recycle/pool_simulator.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+/// Builds a trace by hand
+struct trace_builder
+{
+    void allocate(uint32_t thread, uint32_t pool = 0)
+    {
+        add(recycle::trace_event_type::allocate, thread, pool);
+    }
+
+    void release(uint32_t thread, uint32_t pool = 0)
+    {
+        add(recycle::trace_event_type::release, thread, pool);
+    }
+
+    void add(recycle::trace_event_type type, uint32_t thread, uint32_t pool)
+    {
+        recycle::trace_event event = {};
+        event.m_sequence = m_events.size() + 1;
+        event.m_thread = thread;
+        event.m_pool = pool;
+        event.m_type = type;
+        m_events.push_back(event);
+    }
+
+    std::vector<recycle::trace_event> m_events;
+};
+
+/// Two bursts of four allocations on one thread
+std::vector<recycle::trace_event> bursts()
+{
+    trace_builder trace;
+
+    for (uint32_t burst = 0; burst < 2; ++burst)
+    {
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            trace.allocate(0);
+        }
+
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            trace.release(0);
+        }
+    }
+
+    return trace.m_events;
+}
+}
+
+/// Test the default configuration, which retains everything
+TEST(test_pool_simulator, unlimited)
+{
+    recycle::simulation_config config;
+    config.m_resource_bytes = 100;
+
+    recycle::simulation_result result = recycle::simulate(bursts(), config);
+
+    EXPECT_EQ(result.m_allocations, 8U);
+    EXPECT_EQ(result.m_releases, 8U);
+    EXPECT_EQ(result.m_hits, 4U);
+    EXPECT_EQ(result.m_misses, 4U);
+    EXPECT_EQ(result.m_dropped, 0U);
+    EXPECT_DOUBLE_EQ(result.hit_rate(), 0.5);
+    EXPECT_EQ(result.m_peak_resources, 4U);
+    EXPECT_EQ(result.m_peak_bytes, 400U);
+    EXPECT_EQ(result.m_lock_acquisitions, 16U);
+}
+
+/// Test that the retention limit drops released resources
+TEST(test_pool_simulator, retention)
+{
+    recycle::simulation_config config;
+    config.m_max_unused = 2;
+
+    recycle::simulation_result result = recycle::simulate(bursts(), config);
+
+    EXPECT_EQ(result.m_hits, 2U);
+    EXPECT_EQ(result.m_misses, 6U);
+    EXPECT_EQ(result.m_dropped, 4U);
+    EXPECT_EQ(result.m_peak_resources, 4U);
+}
+
+/// Test that the thread cache avoids the lock
+TEST(test_pool_simulator, thread_cache)
+{
+    recycle::simulation_config config;
+    config.m_thread_cache = 2;
+
+    recycle::simulation_result result = recycle::simulate(bursts(), config);
+
+    EXPECT_EQ(result.m_hits, 4U);
+
+    // The first burst takes the lock 4 times to allocate and twice to
+    // release, the second twice to allocate and twice to release
+    EXPECT_EQ(result.m_lock_acquisitions, 10U);
+}
+
+/// Test that resources released to another shard are not found
+TEST(test_pool_simulator, shards)
+{
+    // Allocate on thread 0 and release on thread 1
+    trace_builder trace;
+
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        trace.allocate(0);
+        trace.release(1);
+    }
+
+    recycle::simulation_config config;
+
+    recycle::simulation_result shared = recycle::simulate(trace.m_events,
+                                                          config);
+    EXPECT_EQ(shared.m_misses, 1U);
+
+    config.m_shards = 2;
+    recycle::simulation_result sharded = recycle::simulate(trace.m_events,
+                                                           config);
+    EXPECT_EQ(sharded.m_misses, 4U);
+    EXPECT_EQ(sharded.m_peak_resources, 4U);
+}
+
+/// Test that pools are simulated separately and untracked releases are
+/// ignored
+TEST(test_pool_simulator, pools)
+{
+    trace_builder trace;
+    trace.release(0, 1);
+    trace.allocate(0, 1);
+    trace.allocate(0, 2);
+    trace.release(0, 1);
+    trace.allocate(0, 2);
+
+    recycle::simulation_config config;
+    recycle::simulation_result result = recycle::simulate(trace.m_events,
+                                                          config);
+
+    EXPECT_EQ(result.m_releases, 1U);
+    EXPECT_EQ(result.m_misses, 3U);
+    EXPECT_EQ(result.m_peak_resources, 3U);
+}
@@ -0,0 +1,252 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#include <recycle/remote_free_pool.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+// Put tests classes in an anonymous namespace to avoid violations of
+// ODF (one-definition-rule) in other translation units
+namespace
+{
+// Default constructible dummy object
+struct dummy_one
+{
+    dummy_one()
+    {
+        ++m_count;
+    }
+
+    ~dummy_one()
+    {
+        --m_count;
+    }
+
+    // Counter which will check how many object have been allocate
+    // and deallocated
+    static std::atomic<int32_t> m_count;
+};
+
+std::atomic<int32_t> dummy_one::m_count{0};
+}
+
+/// Test the basic API construct and free some objects
+TEST(test_remote_free_pool, api)
+{
+    {
+        recycle::remote_free_pool<dummy_one> pool;
+
+        EXPECT_EQ(pool.unused_resources(), 0U);
+
+        {
+            auto d1 = pool.allocate();
+            EXPECT_EQ(pool.unused_resources(), 0U);
+        }
+
+        EXPECT_EQ(pool.unused_resources(), 1U);
+
+        auto d2 = pool.allocate();
+        EXPECT_EQ(pool.unused_resources(), 0U);
+
+        auto d3 = pool.allocate();
+        EXPECT_EQ(dummy_one::m_count, 2);
+
+        d2.reset();
+        d3.reset();
+        EXPECT_EQ(pool.unused_resources(), 2U);
+
+        pool.free_unused();
+        EXPECT_EQ(pool.unused_resources(), 0U);
+        EXPECT_EQ(dummy_one::m_count, 0);
+    }
+
+    EXPECT_EQ(dummy_one::m_count, 0);
+}
+
+/// Test that the allocate and recycle functions are used
+TEST(test_remote_free_pool, allocate_and_recycle_function)
+{
+    uint32_t allocated = 0;
+    std::atomic<uint32_t> recycled{0};
+
+    auto make = [&allocated]()
+    {
+        ++allocated;
+        return std::make_unique<int>(42);
+    };
+
+    auto recycle = [&recycled](std::unique_ptr<int>& value)
+    {
+        ++recycled;
+        *value = 0;
+    };
+
+    recycle::remote_free_pool<int> pool(make, recycle);
+
+    {
+        auto v = pool.allocate();
+        EXPECT_EQ(*v, 42);
+    }
+
+    auto v = pool.allocate();
+    EXPECT_EQ(*v, 0);
+    EXPECT_EQ(allocated, 1U);
+    EXPECT_EQ(recycled, 1U);
+}
+
+/// Test that the resources reset by the recycle function are destroyed
+/// instead of being put back into the pool, also when released remotely
+TEST(test_remote_free_pool, recycle_drop)
+{
+    {
+        recycle::remote_free_pool<dummy_one> pool(
+            std::make_unique<dummy_one>,
+            [](std::unique_ptr<dummy_one>& d) { d.reset(); });
+
+        auto d1 = pool.allocate();
+        auto d2 = pool.allocate();
+        EXPECT_EQ(dummy_one::m_count, 2);
+
+        d1.reset();
+        std::thread([&d2]() { d2.reset(); }).join();
+
+        EXPECT_EQ(pool.unused_resources(), 0U);
+        EXPECT_EQ(dummy_one::m_count, 0);
+
+        auto d3 = pool.allocate();
+        EXPECT_TRUE(d3);
+        EXPECT_EQ(dummy_one::m_count, 1);
+    }
+
+    EXPECT_EQ(dummy_one::m_count, 0);
+}
+
+/// Test that resources released on other threads are reused by the owner
+TEST(test_remote_free_pool, remote_release)
+{
+    recycle::remote_free_pool<dummy_one> pool;
+
+    std::vector<recycle::remote_free_pool<dummy_one>::pool_ptr> handles;
+    for (std::size_t i = 0; i < 100; ++i)
+    {
+        handles.push_back(pool.allocate());
+    }
+
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < 4; ++t)
+    {
+        threads.emplace_back(
+            [&handles, t]()
+            {
+                for (std::size_t i = t; i < handles.size(); i += 4)
+                {
+                    handles[i].reset();
+                }
+            });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    // The remote free list is taken over by the owner
+    EXPECT_EQ(pool.unused_resources(), 100U);
+
+    for (auto& handle : handles)
+    {
+        handle = pool.allocate();
+    }
+
+    EXPECT_EQ(dummy_one::m_count, 100);
+    EXPECT_EQ(pool.unused_resources(), 0U);
+
+    handles.clear();
+    pool.free_unused();
+    EXPECT_EQ(dummy_one::m_count, 0);
+}
+
+/// Test a producer allocating while a consumer releases concurrently
+TEST(test_remote_free_pool, producer_consumer)
+{
+    const uint32_t operations = 10000;
+
+    recycle::remote_free_pool<dummy_one> pool;
+    std::vector<recycle::remote_free_pool<dummy_one>::pool_ptr> handles(
+        operations);
+    std::atomic<uint32_t> produced{0};
+
+    std::thread consumer(
+        [&]()
+        {
+            for (uint32_t i = 0; i < operations; ++i)
+            {
+                while (produced.load(std::memory_order_acquire) <= i)
+                {
+                    std::this_thread::yield();
+                }
+
+                handles[i].reset();
+            }
+        });
+
+    for (uint32_t i = 0; i < operations; ++i)
+    {
+        handles[i] = pool.allocate();
+        produced.store(i + 1, std::memory_order_release);
+    }
+
+    consumer.join();
+
+    // All objects created have been returned to the pool
+    auto unused = static_cast<int32_t>(pool.unused_resources());
+    EXPECT_EQ(dummy_one::m_count, unused);
+    EXPECT_LE(pool.unused_resources(), operations);
+
+    pool.free_unused();
+    EXPECT_EQ(dummy_one::m_count, 0);
+}
+
+/// Test that resources can be released after the pool is destroyed
+TEST(test_remote_free_pool, pool_die_before_object)
+{
+    recycle::remote_free_pool<dummy_one>::pool_ptr d1;
+    recycle::remote_free_pool<dummy_one>::pool_ptr d2;
+
+    {
+        recycle::remote_free_pool<dummy_one> pool;
+
+        d1 = pool.allocate();
+        d2 = pool.allocate();
+        EXPECT_EQ(dummy_one::m_count, 2);
+    }
+
+    EXPECT_EQ(dummy_one::m_count, 2);
+
+    std::thread remote([&d2]() { d2.reset(); });
+    remote.join();
+    EXPECT_EQ(dummy_one::m_count, 1);
+
+    d1.reset();
+    EXPECT_EQ(dummy_one::m_count, 0);
+}
+
+/// Test that the pool can be moved
+TEST(test_remote_free_pool, move)
+{
+    recycle::remote_free_pool<dummy_one> pool;
+    auto d1 = pool.allocate();
+
+    recycle::remote_free_pool<dummy_one> other(std::move(pool));
+    d1.reset();
+
+    EXPECT_EQ(other.unused_resources(), 1U);
+}
@@ -11,9 +11,12 @@
 #include <mutex>
 #include <thread>
 #include <type_traits>
+#include <vector>
 
 #include <gtest/gtest.h>
 
+#include "counting_observer.hpp"
+
 // Put tests classes in an anonymous namespace to avoid violations of
 // ODF (one-definition-rule) in other translation units
 namespace
@@ -488,3 +491,232 @@ TEST(test_shared_pool, enable_shared_from_this)
 
     EXPECT_EQ(dummy_three::m_count, 0);
 }
+
+/// Test that the observer gets notified about the pool events
+TEST(test_shared_pool, observer)
+{
+    recycle::shared_pool<dummy_one, recycle::no_locking_policy,
+                         counting_observer>
+        pool;
+
+    {
+        auto o1 = pool.allocate();
+        auto o2 = pool.allocate();
+    }
+
+    EXPECT_EQ(pool.observer().m_allocations, 2U);
+    EXPECT_EQ(pool.observer().m_misses, 2U);
+    EXPECT_EQ(pool.observer().m_recycles, 2U);
+    EXPECT_EQ(pool.observer().m_unused, 2U);
+
+    auto o3 = pool.allocate();
+
+    EXPECT_EQ(pool.observer().m_allocations, 3U);
+    EXPECT_EQ(pool.observer().m_misses, 2U);
+    EXPECT_EQ(pool.observer().m_unused, 1U);
+
+    pool.free_unused();
+
+    EXPECT_EQ(pool.observer().m_freed, 1U);
+}
+
+/// Test that the byte budget limits the memory retained by the pool
+TEST(test_shared_pool, byte_budget)
+{
+    recycle::shared_pool<std::vector<uint8_t>> pool;
+
+    // By default the size of a resource is its sizeof
+    {
+        auto o1 = pool.allocate();
+    }
+
+    EXPECT_EQ(pool.unused_bytes(), sizeof(std::vector<uint8_t>));
+
+    pool.set_size_function([](const std::vector<uint8_t>& v)
+                           { return v.capacity(); });
+
+    EXPECT_EQ(pool.unused_bytes(), 0U);
+    pool.free_unused();
+
+    pool.set_max_unused_bytes(1500U);
+    EXPECT_EQ(pool.max_unused_bytes(), 1500U);
+
+    {
+        auto o1 = pool.allocate();
+        auto o2 = pool.allocate();
+        auto o3 = pool.allocate();
+
+        o1->reserve(1000U);
+        o2->reserve(1000U);
+        o3->reserve(200U);
+    }
+
+    // o3 and o2 are recycled first, o1 does not fit in the budget
+    EXPECT_EQ(pool.unused_resources(), 2U);
+    EXPECT_EQ(pool.unused_bytes(), 1200U);
+
+    {
+        auto o1 = pool.allocate();
+        EXPECT_EQ(pool.unused_bytes(), 200U);
+    }
+
+    EXPECT_EQ(pool.unused_bytes(), 1200U);
+
+    pool.free_unused();
+    EXPECT_EQ(pool.unused_resources(), 0U);
+    EXPECT_EQ(pool.unused_bytes(), 0U);
+}
+
+/// Test that the resources stay in the pool while they are measured with
+/// a new size function
+TEST(test_resource_pool, set_size_function_keeps_resources)
+{
+    recycle::shared_pool<std::vector<uint8_t>> pool;
+
+    {
+        auto o1 = pool.allocate();
+        auto o2 = pool.allocate();
+        auto o3 = pool.allocate();
+
+        o1->reserve(100U);
+        o2->reserve(100U);
+        o3->reserve(100U);
+    }
+
+    std::vector<std::size_t> seen;
+
+    pool.set_size_function(
+        [&pool, &seen](const std::vector<uint8_t>& v)
+        {
+            // Only the resource being measured is taken out of the pool
+            seen.push_back(pool.unused_resources());
+            return v.capacity();
+        });
+
+    std::vector<std::size_t> expected = {2, 2, 2};
+    EXPECT_EQ(seen, expected);
+    EXPECT_EQ(pool.unused_resources(), 3U);
+    EXPECT_EQ(pool.unused_bytes(), 300U);
+}
+
+/// Test that the pool can be shrunk incrementally
+TEST(test_shared_pool, shrink_to_and_trim)
+{
+    recycle::shared_pool<std::vector<uint8_t>> pool;
+
+    {
+        std::vector<recycle::shared_pool<std::vector<uint8_t>>::value_ptr>
+            objects;
+
+        for (std::size_t i = 0; i < 10; ++i)
+        {
+            objects.push_back(pool.allocate());
+            objects.back()->resize(i);
+        }
+
+        // Recycle the objects in order, i.e. the object of size zero has
+        // been unused the longest
+        for (auto& o : objects)
+        {
+            o.reset();
+        }
+    }
+
+    EXPECT_EQ(pool.unused_resources(), 10U);
+
+    EXPECT_EQ(pool.trim(3U), 3U);
+    EXPECT_EQ(pool.unused_resources(), 7U);
+
+    EXPECT_EQ(pool.shrink_to(8U), 0U);
+    EXPECT_EQ(pool.shrink_to(2U), 5U);
+    EXPECT_EQ(pool.unused_resources(), 2U);
+
+    // The most recently recycled objects are kept
+    auto o1 = pool.allocate();
+    auto o2 = pool.allocate();
+    EXPECT_EQ(o1->size(), 9U);
+    EXPECT_EQ(o2->size(), 8U);
+
+    EXPECT_EQ(pool.trim(10U), 0U);
+}
+
+/// Test that misses create batches of resources
+TEST(test_shared_pool, growth_policy)
+{
+    using pool_type = recycle::shared_pool<dummy_one>;
+
+    pool_type pool;
+    pool.set_batch_allocate_function(
+        [](std::size_t n)
+        {
+            std::vector<pool_type::value_ptr> batch;
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                batch.push_back(std::make_shared<dummy_one>());
+            }
+            return batch;
+        });
+
+    recycle::growth_policy growth;
+    growth.m_initial_batch = 3;
+    pool.set_growth_policy(growth);
+
+    {
+        auto o1 = pool.allocate();
+        EXPECT_EQ(pool.unused_resources(), 2U);
+        EXPECT_EQ(dummy_one::m_count, 3);
+
+        auto o2 = pool.allocate();
+        auto o3 = pool.allocate();
+        EXPECT_EQ(pool.unused_resources(), 0U);
+
+        auto o4 = pool.allocate();
+        EXPECT_EQ(pool.unused_resources(), 2U);
+    }
+
+    EXPECT_EQ(pool.unused_resources(), 6U);
+
+    pool.free_unused();
+    EXPECT_EQ(dummy_one::m_count, 0);
+}
+
+/// Test taking and putting back several resources at once
+TEST(test_shared_pool, borrow_give_back)
+{
+    using pool_type = recycle::shared_pool<dummy_one>;
+
+    uint32_t recycled = 0;
+    pool_type pool(make_dummy_one,
+                   [&recycled](pool_type::value_ptr) { ++recycled; });
+
+    pool.set_batch_allocate_function(
+        [](std::size_t n)
+        {
+            // Create fewer than asked, the pool asks again
+            std::vector<pool_type::value_ptr> batch;
+            batch.push_back(std::make_shared<dummy_one>());
+
+            if (n > 1)
+            {
+                batch.push_back(std::make_shared<dummy_one>());
+            }
+
+            return batch;
+        });
+
+    auto resources = pool.borrow(3);
+    EXPECT_EQ(resources.size(), 3U);
+    EXPECT_EQ(dummy_one::m_count, 3);
+
+    pool.give_back(std::move(resources));
+    EXPECT_EQ(pool.unused_resources(), 3U);
+    EXPECT_EQ(recycled, 3U);
+
+    resources = pool.borrow(2);
+    EXPECT_EQ(pool.unused_resources(), 1U);
+    EXPECT_EQ(dummy_one::m_count, 3);
+
+    resources.clear();
+    pool.free_unused();
+    EXPECT_EQ(dummy_one::m_count, 0);
+}
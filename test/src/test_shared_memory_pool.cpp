@@ -0,0 +1,243 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#include <recycle/shared_memory_pool.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+struct packet
+{
+    uint32_t m_size;
+    uint8_t m_data[60];
+};
+
+using pool_type = recycle::shared_memory_pool<packet>;
+
+/// Runs the function in a child process
+/// @return The exit code of the child
+template <class Function>
+int run_child(Function function)
+{
+    pid_t pid = ::fork();
+
+    if (pid == 0)
+    {
+        int code = 1;
+
+        try
+        {
+            code = function();
+        }
+        catch (...)
+        {
+        }
+
+        ::_exit(code);
+    }
+
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+}
+
+/// Test allocating and releasing in one process
+TEST(test_shared_memory_pool, api)
+{
+    pool_type pool = pool_type::create(3);
+    EXPECT_EQ(pool.capacity(), 3U);
+    EXPECT_EQ(pool.unused_resources(), 3U);
+
+    {
+        auto p1 = pool.allocate();
+        auto p2 = pool.allocate();
+        auto p3 = pool.allocate();
+        ASSERT_TRUE(p1 && p2 && p3);
+
+        // The values start out zeroed
+        EXPECT_EQ(p1->m_size, 0U);
+        EXPECT_EQ(p3->m_data[59], 0U);
+
+        EXPECT_FALSE(pool.allocate());
+        EXPECT_EQ(pool.unused_resources(), 0U);
+
+        p1->m_size = 42;
+        pool_type::index_type index = pool.to_index(std::move(p1));
+        EXPECT_EQ(pool.unused_resources(), 0U);
+
+        auto p4 = pool.from_index(index);
+        EXPECT_EQ(p4->m_size, 42U);
+
+        // An index from a misbehaving peer is rejected
+        EXPECT_THROW(pool.from_index(3), std::out_of_range);
+        EXPECT_THROW(pool.from_index(pool_type::npos), std::out_of_range);
+    }
+
+    EXPECT_EQ(pool.unused_resources(), 3U);
+
+    // The pool can be moved while its resources are in use
+    auto p = pool.allocate();
+    pool_type moved = std::move(pool);
+    p.reset();
+    EXPECT_EQ(moved.unused_resources(), 3U);
+
+    // The capacity must be addressable by an index
+    EXPECT_THROW(pool_type::create(0), std::invalid_argument);
+    EXPECT_THROW(pool_type::create(pool_type::npos), std::invalid_argument);
+}
+
+/// Test handing a value to another process which releases it
+TEST(test_shared_memory_pool, fork)
+{
+    pool_type pool = pool_type::create(4);
+
+    auto p = pool.allocate();
+    ASSERT_TRUE(p);
+    p->m_size = 5;
+    std::memcpy(p->m_data, "hello", 5);
+
+    pool_type::index_type index = pool.to_index(std::move(p));
+    EXPECT_EQ(pool.unused_resources(), 3U);
+
+    int code = run_child(
+        [&pool, index]()
+        {
+            // Map the segment again, at a different address
+            pool_type child = pool_type::open(pool.fd());
+
+            auto value = child.from_index(index);
+            bool valid = value->m_size == 5 &&
+                         std::memcmp(value->m_data, "hello", 5) == 0;
+
+            value->m_size = 6;
+            return valid ? 0 : 2;
+        });
+
+    EXPECT_EQ(code, 0);
+    EXPECT_EQ(pool.unused_resources(), 4U);
+
+    // The change made by the child is visible
+    auto value = pool.from_index(index);
+    EXPECT_EQ(value->m_size, 6U);
+    pool.to_index(std::move(value));
+}
+
+/// Test opening a named segment
+TEST(test_shared_memory_pool, named)
+{
+    std::string name = "/recycle_test_" + std::to_string(::getpid());
+
+    pool_type::unlink(name);
+    EXPECT_THROW(pool_type::open(name), std::system_error);
+
+    pool_type pool = pool_type::create(name, 2);
+    EXPECT_THROW(pool_type::create(name, 2), std::system_error);
+
+    int code = run_child(
+        [&name]()
+        {
+            pool_type child = pool_type::open(name);
+            auto value = child.allocate();
+            if (!value)
+            {
+                return 3;
+            }
+            value->m_size = 7;
+            child.to_index(std::move(value));
+
+            return child.unused_resources() == 1 ? 0 : 2;
+        });
+
+    EXPECT_EQ(code, 0);
+    EXPECT_EQ(pool.unused_resources(), 1U);
+
+    // The value allocated by the child is released here
+    auto value = pool.from_index(0);
+    EXPECT_EQ(value->m_size, 7U);
+    value.reset();
+    EXPECT_EQ(pool.unused_resources(), 2U);
+
+    pool_type::unlink(name);
+
+    // The segment must hold packets
+    EXPECT_THROW(recycle::shared_memory_pool<uint64_t>::open(pool.fd()),
+                 std::runtime_error);
+}
+
+/// Test allocating and releasing from several processes at once
+TEST(test_shared_memory_pool, concurrent)
+{
+    pool_type pool = pool_type::create(8);
+    std::vector<pid_t> children;
+
+    for (uint32_t child = 0; child < 3; ++child)
+    {
+        pid_t pid = ::fork();
+
+        if (pid == 0)
+        {
+            int code = 0;
+
+            for (uint32_t i = 0; i < 20000; ++i)
+            {
+                auto value = pool.allocate();
+
+                if (!value)
+                {
+                    continue;
+                }
+
+                // Nobody else may use the value while we hold it
+                uint32_t mark = (child << 24) | i;
+                volatile uint32_t* size = &value->m_size;
+                *size = mark;
+
+                for (uint32_t spin = 0; spin < 10; ++spin)
+                {
+                    if (*size != mark)
+                    {
+                        code = 2;
+                    }
+                }
+            }
+
+            ::_exit(code);
+        }
+
+        children.push_back(pid);
+    }
+
+    for (pid_t pid : children)
+    {
+        int status = 0;
+        ::waitpid(pid, &status, 0);
+        EXPECT_TRUE(WIFEXITED(status));
+        EXPECT_EQ(WEXITSTATUS(status), 0);
+    }
+
+    EXPECT_EQ(pool.unused_resources(), 8U);
+
+    // Every value is in the free list exactly once
+    std::vector<pool_type::pool_ptr> values;
+    while (auto value = pool.allocate())
+    {
+        values.push_back(std::move(value));
+    }
+
+    EXPECT_EQ(values.size(), 8U);
+}
@@ -0,0 +1,243 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#include <recycle/sizing_profile.hpp>
+
+#include <recycle/demand_tracker.hpp>
+#include <recycle/no_locking_policy.hpp>
+#include <recycle/shared_pool.hpp>
+#include <recycle/unique_pool.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+using buffer_type = std::vector<uint8_t>;
+
+using pool_type = recycle::unique_pool<buffer_type, recycle::no_locking_policy,
+                                       recycle::demand_tracker>;
+
+/// Allocates the given number of buffers at once and releases them
+void burst(pool_type& pool, std::size_t count)
+{
+    std::vector<pool_type::pool_ptr> values;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        values.push_back(pool.allocate());
+        values.back()->resize(100);
+    }
+}
+
+std::size_t buffer_size(const buffer_type& buffer)
+{
+    return buffer.capacity();
+}
+}
+
+/// Test the size class histogram of the pools
+TEST(test_sizing_profile, size_classes)
+{
+    recycle::shared_pool<buffer_type> pool;
+    pool.set_size_function(buffer_size);
+
+    EXPECT_TRUE(pool.size_classes().empty());
+
+    {
+        auto b1 = pool.allocate();
+        auto b2 = pool.allocate();
+        auto b3 = pool.allocate();
+        b1->reserve(1);
+        b2->reserve(100);
+        b3->reserve(127);
+    }
+
+    // Both 100 and 127 bytes fall in [64, 128)
+    std::vector<std::size_t> expected = {1, 0, 0, 0, 0, 0, 2};
+    EXPECT_EQ(pool.size_classes(), expected);
+}
+
+/// Test capturing and applying a profile
+TEST(test_sizing_profile, capture_apply)
+{
+    pool_type pool;
+    pool.set_size_function(buffer_size);
+
+    burst(pool, 8);
+    recycle::adapt(pool);
+
+    recycle::sizing_profile profile = recycle::capture_profile(pool);
+    EXPECT_DOUBLE_EQ(profile.m_peak, 8.0);
+    EXPECT_EQ(profile.m_recommended_unused, 8U);
+    ASSERT_EQ(profile.m_size_classes.size(), 7U);
+    EXPECT_EQ(profile.m_size_classes[6], 8U);
+
+    // A restarted pool is prewarmed and keeps the learned peak
+    pool_type restarted;
+    EXPECT_EQ(recycle::apply_profile(restarted, profile), 8U);
+    EXPECT_EQ(restarted.unused_resources(), 8U);
+    EXPECT_DOUBLE_EQ(restarted.observer().peak(), 8.0);
+
+    // The first window is averaged with the saved peak
+    burst(restarted, 4);
+    restarted.observer().tick();
+    EXPECT_DOUBLE_EQ(restarted.observer().peak(), 7.0);
+}
+
+/// Test prewarming a pool per size class
+TEST(test_sizing_profile, apply_size_classes)
+{
+    recycle::sizing_profile profile;
+    profile.m_peak = 6.0;
+    profile.m_recommended_unused = 6;
+    profile.m_size_classes = {0, 0, 0, 0, 1, 0, 0, 2};
+
+    std::vector<std::size_t> requests;
+    auto allocate = [&requests](std::size_t bytes)
+    {
+        requests.push_back(bytes);
+        auto buffer = std::make_unique<buffer_type>();
+        buffer->reserve(bytes);
+        return buffer;
+    };
+
+    pool_type pool;
+    pool.set_size_function(buffer_size);
+    EXPECT_EQ(recycle::apply_profile(pool, profile, allocate), 6U);
+    EXPECT_EQ(pool.unused_resources(), 6U);
+
+    // The largest size of each class is requested
+    std::vector<std::size_t> expected_requests = {255, 255, 31};
+    EXPECT_EQ(requests, expected_requests);
+
+    // The classes of the histogram and three default resources
+    std::vector<std::size_t> expected = {3, 0, 0, 0, 1, 0, 0, 2};
+    EXPECT_EQ(pool.size_classes(), expected);
+
+    // The largest classes are created first
+    profile.m_recommended_unused = 1;
+    pool_type small;
+    small.set_size_function(buffer_size);
+    EXPECT_EQ(recycle::apply_profile(small, profile, allocate), 1U);
+    expected = {0, 0, 0, 0, 0, 0, 0, 1};
+    EXPECT_EQ(small.size_classes(), expected);
+}
+
+/// Test capturing a pool without a demand_tracker
+TEST(test_sizing_profile, no_tracker)
+{
+    recycle::unique_pool<uint32_t> pool;
+    EXPECT_EQ(pool.prewarm(3), 3U);
+
+    recycle::sizing_profile profile = recycle::capture_profile(pool);
+    EXPECT_DOUBLE_EQ(profile.m_peak, 3.0);
+    EXPECT_EQ(profile.m_recommended_unused, 3U);
+
+    recycle::unique_pool<uint32_t> restarted;
+    EXPECT_EQ(recycle::apply_profile(restarted, profile), 3U);
+}
+
+/// Test saving and loading the profiles of a number of pools
+TEST(test_sizing_profile, save_load)
+{
+    std::string path = testing::TempDir() + "recycle_test_profile";
+    std::remove(path.c_str());
+
+    recycle::profile_store store;
+    EXPECT_FALSE(store.load(path));
+
+    pool_type buffers;
+    buffers.set_size_function(buffer_size);
+    burst(buffers, 5);
+    recycle::adapt(buffers);
+
+    recycle::unique_pool<uint32_t> numbers;
+    numbers.prewarm(2);
+
+    store.capture("buffers", buffers);
+    store.capture("numbers", numbers);
+    EXPECT_EQ(store.size(), 2U);
+    EXPECT_TRUE(store.save(path));
+
+    recycle::profile_store loaded;
+    EXPECT_TRUE(loaded.load(path));
+    EXPECT_EQ(loaded.size(), 2U);
+
+    const recycle::sizing_profile* profile = loaded.find("buffers");
+    ASSERT_NE(profile, nullptr);
+    EXPECT_DOUBLE_EQ(profile->m_peak, 5.0);
+    EXPECT_EQ(profile->m_recommended_unused, 5U);
+    EXPECT_EQ(profile->m_size_classes,
+              store.find("buffers")->m_size_classes);
+
+    pool_type restarted;
+    EXPECT_EQ(loaded.restore("buffers", restarted), 5U);
+    EXPECT_EQ(loaded.restore("unknown", restarted), 0U);
+
+    pool_type sized;
+    sized.set_size_function(buffer_size);
+    auto allocate = [](std::size_t bytes)
+    {
+        auto buffer = std::make_unique<buffer_type>();
+        buffer->reserve(bytes);
+        return buffer;
+    };
+    EXPECT_EQ(loaded.restore("buffers", sized, allocate), 5U);
+    EXPECT_EQ(sized.size_classes(), profile->m_size_classes);
+
+    std::remove(path.c_str());
+}
+
+/// Test that malformed profiles are loaded leniently
+TEST(test_sizing_profile, malformed)
+{
+    std::string path = testing::TempDir() + "recycle_test_profile_malformed";
+
+    {
+        std::ofstream file(path, std::ios::trunc);
+        file << "peak = 10\n"
+             << "[pool]\r\n"
+             << "peak = 2.5\n"
+             << "recommended_unused = -1\n"
+             << "unknown = 42\n"
+             << "garbage\n"
+             << "size_classes = 1 2 x 3\n"
+             << "[too_many_classes]\n"
+             << "size_classes =";
+
+        std::size_t classes = recycle::sizing_profile::max_size_classes();
+        for (std::size_t i = 0; i <= classes; ++i)
+        {
+            file << " 1";
+        }
+
+        file << "\n";
+    }
+
+    recycle::profile_store store;
+    EXPECT_TRUE(store.load(path));
+    EXPECT_EQ(store.size(), 2U);
+
+    const recycle::sizing_profile* profile = store.find("pool");
+    ASSERT_NE(profile, nullptr);
+    EXPECT_DOUBLE_EQ(profile->m_peak, 2.5);
+    EXPECT_EQ(profile->m_recommended_unused, 0U);
+
+    std::vector<std::size_t> expected = {1, 2};
+    EXPECT_EQ(profile->m_size_classes, expected);
+
+    // A histogram with more classes than a size has bits is rejected
+    profile = store.find("too_many_classes");
+    ASSERT_NE(profile, nullptr);
+    EXPECT_TRUE(profile->m_size_classes.empty());
+
+    std::remove(path.c_str());
+}
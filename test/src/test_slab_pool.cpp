@@ -0,0 +1,224 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#include <recycle/slab_pool.hpp>
+
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+// Put tests classes in an anonymous namespace to avoid violations of
+// ODF (one-definition-rule) in other translation units
+namespace
+{
+// Default constructible dummy object
+struct dummy_one
+{
+    dummy_one()
+    {
+        ++m_count;
+    }
+
+    ~dummy_one()
+    {
+        --m_count;
+    }
+
+    // Counter which will check how many object have been allocate
+    // and deallocated
+    static int32_t m_count;
+};
+
+int32_t dummy_one::m_count = 0;
+
+// Trivial packet header
+struct header
+{
+    uint32_t m_sequence;
+    uint16_t m_length;
+    uint8_t m_flags;
+};
+
+// Header with default member initializers, not trivially default
+// constructible
+struct defaulted_header
+{
+    uint8_t m_ttl = 64;
+    uint16_t m_port = 80;
+};
+
+struct lock_policy
+{
+    using mutex_type = std::mutex;
+    using lock_type = std::lock_guard<mutex_type>;
+};
+}
+
+static_assert(recycle::slab_pool<header>::is_trivial, "header is trivial");
+static_assert(!recycle::slab_pool<dummy_one>::is_trivial,
+              "dummy_one is not trivial");
+static_assert(!recycle::slab_pool<defaulted_header>::is_trivial,
+              "defaulted_header is not trivial");
+
+/// Test the trivial fast path
+TEST(test_slab_pool, trivial)
+{
+    recycle::slab_pool<header> pool(4);
+    EXPECT_EQ(pool.slab_capacity(), 4U);
+    EXPECT_EQ(pool.slabs(), 0U);
+
+    std::vector<recycle::slab_pool<header>::pool_ptr> headers;
+    std::set<header*> addresses;
+
+    for (uint32_t i = 0; i < 6; ++i)
+    {
+        headers.push_back(pool.allocate());
+        headers.back()->m_sequence = i + 1;
+        addresses.insert(headers.back().get());
+    }
+
+    EXPECT_EQ(addresses.size(), 6U);
+    EXPECT_EQ(pool.slabs(), 2U);
+    EXPECT_EQ(pool.unused_resources(), 2U);
+
+    // Values of a slab are contiguous
+    EXPECT_EQ(headers[1].get(), headers[0].get() + 1);
+
+    // Released values are handed out as they were
+    header* address = headers[5].get();
+    headers[5].reset();
+    headers[5] = pool.allocate();
+    EXPECT_EQ(headers[5].get(), address);
+    EXPECT_EQ(headers[5]->m_sequence, 6U);
+
+    // The first slab is still in use
+    headers[4].reset();
+    headers[5].reset();
+    pool.free_unused();
+    EXPECT_EQ(pool.slabs(), 1U);
+    EXPECT_EQ(pool.unused_resources(), 0U);
+
+    headers.clear();
+    pool.free_unused();
+    EXPECT_EQ(pool.slabs(), 0U);
+}
+
+/// Test that released values can be zeroed
+TEST(test_slab_pool, zero_on_recycle)
+{
+    recycle::slab_pool<header> pool(1);
+    pool.set_zero_on_recycle(true);
+
+    {
+        // New slabs are zeroed
+        auto h = pool.allocate();
+        EXPECT_EQ(h->m_sequence, 0U);
+        EXPECT_EQ(h->m_length, 0U);
+        h->m_sequence = 42;
+        h->m_flags = 1;
+    }
+
+    auto h = pool.allocate();
+    EXPECT_EQ(h->m_sequence, 0U);
+    EXPECT_EQ(h->m_flags, 0U);
+    EXPECT_EQ(pool.slabs(), 1U);
+}
+
+/// Test values which need constructors and destructors
+TEST(test_slab_pool, non_trivial)
+{
+    {
+        recycle::slab_pool<dummy_one> pool(4);
+
+        auto d1 = pool.allocate();
+        auto d2 = pool.allocate();
+        EXPECT_EQ(dummy_one::m_count, 2);
+        EXPECT_EQ(pool.slabs(), 1U);
+
+        d2.reset();
+        EXPECT_EQ(dummy_one::m_count, 2);
+        EXPECT_EQ(pool.unused_resources(), 1U);
+
+        pool.free_unused();
+        EXPECT_EQ(dummy_one::m_count, 1);
+        EXPECT_EQ(pool.unused_resources(), 0U);
+        EXPECT_EQ(pool.slabs(), 1U);
+
+        d1.reset();
+        pool.free_unused();
+        EXPECT_EQ(dummy_one::m_count, 0);
+        EXPECT_EQ(pool.slabs(), 0U);
+
+        auto d3 = pool.allocate();
+        EXPECT_EQ(dummy_one::m_count, 1);
+    }
+
+    EXPECT_EQ(dummy_one::m_count, 0);
+}
+
+/// Test that default member initializers are honoured
+TEST(test_slab_pool, default_member_initializers)
+{
+    recycle::slab_pool<defaulted_header> pool(2);
+
+    auto h = pool.allocate();
+    EXPECT_EQ(h->m_ttl, 64U);
+    EXPECT_EQ(h->m_port, 80U);
+
+    auto g = pool.allocate();
+    EXPECT_EQ(g->m_ttl, 64U);
+    EXPECT_EQ(g->m_port, 80U);
+}
+
+/// Test that the pool may die before the resources it handed out
+TEST(test_slab_pool, pool_die_before_object)
+{
+    recycle::slab_pool<dummy_one>::pool_ptr d1;
+
+    {
+        recycle::slab_pool<dummy_one> pool;
+        d1 = pool.allocate();
+        auto d2 = pool.allocate();
+    }
+
+    EXPECT_EQ(dummy_one::m_count, 2);
+    d1.reset();
+    EXPECT_EQ(dummy_one::m_count, 0);
+}
+
+/// Test the pool with a locking policy
+TEST(test_slab_pool, threads)
+{
+    recycle::slab_pool<header, lock_policy> pool(16);
+
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < 4; ++t)
+    {
+        threads.emplace_back(
+            [&pool]()
+            {
+                for (uint32_t i = 0; i < 1000; ++i)
+                {
+                    auto a = pool.allocate();
+                    auto b = pool.allocate();
+                    a->m_sequence = i;
+                    b->m_sequence = i;
+                }
+            });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    EXPECT_EQ(pool.unused_resources(), pool.slabs() * 16);
+    pool.free_unused();
+    EXPECT_EQ(pool.slabs(), 0U);
+}
@@ -0,0 +1,156 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#include <recycle/static_pool.hpp>
+
+#include <cstdint>
+#include <set>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+// Put tests classes in an anonymous namespace to avoid violations of
+// ODF (one-definition-rule) in other translation units
+namespace
+{
+// Default constructible dummy object
+struct dummy_one
+{
+    dummy_one()
+    {
+        ++m_count;
+    }
+
+    ~dummy_one()
+    {
+        --m_count;
+    }
+
+    // Counter which will check how many object have been allocate
+    // and deallocated
+    static int32_t m_count;
+};
+
+int32_t dummy_one::m_count = 0;
+
+// Over-aligned object
+struct alignas(64) aligned_one
+{
+    uint8_t m_data[10];
+};
+}
+
+/// Test the basic API construct and free some objects
+TEST(test_static_pool, api)
+{
+    {
+        recycle::static_pool<dummy_one, 4> pool;
+
+        std::size_t capacity = pool.capacity;
+        EXPECT_EQ(capacity, 4U);
+        EXPECT_EQ(pool.unused_resources(), 0U);
+        EXPECT_EQ(pool.in_use(), 0U);
+
+        // Values are only constructed when needed
+        EXPECT_EQ(dummy_one::m_count, 0);
+
+        {
+            auto d1 = pool.allocate();
+            EXPECT_EQ(pool.in_use(), 1U);
+            EXPECT_EQ(dummy_one::m_count, 1);
+        }
+
+        EXPECT_EQ(pool.unused_resources(), 1U);
+        EXPECT_EQ(pool.in_use(), 0U);
+
+        auto d2 = pool.allocate();
+        EXPECT_EQ(pool.unused_resources(), 0U);
+        EXPECT_EQ(dummy_one::m_count, 1);
+
+        auto d3 = pool.allocate();
+        EXPECT_EQ(dummy_one::m_count, 2);
+
+        d3.reset();
+        pool.free_unused();
+        EXPECT_EQ(pool.unused_resources(), 0U);
+        EXPECT_EQ(dummy_one::m_count, 1);
+    }
+
+    EXPECT_EQ(dummy_one::m_count, 0);
+}
+
+/// Test that an exhausted pool returns empty pointers
+TEST(test_static_pool, exhausted)
+{
+    recycle::static_pool<uint32_t, 3> pool;
+
+    auto v1 = pool.allocate();
+    auto v2 = pool.allocate();
+    auto v3 = pool.allocate();
+    ASSERT_TRUE(v1 && v2 && v3);
+
+    EXPECT_FALSE(pool.allocate());
+
+    v2.reset();
+    auto v4 = pool.allocate();
+    EXPECT_TRUE(v4);
+}
+
+/// Test with more slots than fit in a single bitmap word
+TEST(test_static_pool, many_slots)
+{
+    recycle::static_pool<uint64_t, 130> pool;
+    std::vector<recycle::static_pool<uint64_t, 130>::pool_ptr> values;
+    std::set<uint64_t*> addresses;
+
+    for (std::size_t i = 0; i < 130; ++i)
+    {
+        values.push_back(pool.allocate());
+        ASSERT_TRUE(values.back());
+        *values.back() = i;
+        addresses.insert(values.back().get());
+    }
+
+    EXPECT_EQ(addresses.size(), 130U);
+    EXPECT_FALSE(pool.allocate());
+    EXPECT_EQ(pool.in_use(), 130U);
+
+    for (std::size_t i = 0; i < 130; ++i)
+    {
+        EXPECT_EQ(*values[i], i);
+    }
+
+    values.clear();
+    EXPECT_EQ(pool.unused_resources(), 130U);
+}
+
+/// Test that values are aligned and that the handles are small
+TEST(test_static_pool, layout)
+{
+    recycle::static_pool<aligned_one, 3> pool;
+
+    auto a1 = pool.allocate();
+    auto a2 = pool.allocate();
+
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(a1.get()) % 64, 0U);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(a2.get()) % 64, 0U);
+
+    EXPECT_EQ(sizeof(recycle::static_pool<aligned_one, 3>::pool_ptr),
+              2 * sizeof(void*));
+}
+
+/// Test that the pool can live in a global
+namespace
+{
+recycle::static_pool<uint32_t, 8> global_pool;
+}
+
+TEST(test_static_pool, global)
+{
+    auto v = global_pool.allocate();
+    ASSERT_TRUE(v);
+    *v = 42;
+    EXPECT_EQ(global_pool.in_use(), 1U);
+}
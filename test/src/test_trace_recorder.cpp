@@ -0,0 +1,203 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#include <recycle/trace_recorder.hpp>
+
+#include <recycle/no_locking_policy.hpp>
+#include <recycle/shared_pool.hpp>
+#include <recycle/unique_pool.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+using pool_type = recycle::unique_pool<uint32_t, recycle::no_locking_policy,
+                                       recycle::trace_recorder>;
+}
+
+/// Test that the events of a pool are recorded in order
+TEST(test_trace_recorder, record)
+{
+    std::string path = testing::TempDir() + "recycle_test_trace";
+
+    pool_type pool;
+
+    // Nothing is recorded before a writer is attached
+    EXPECT_FALSE(pool.observer().is_attached());
+    pool.allocate();
+
+    {
+        auto writer = std::make_shared<recycle::trace_writer>(path, 100);
+        EXPECT_EQ(writer->capacity(), 128U);
+
+        pool.observer().attach(writer, 7);
+        EXPECT_TRUE(pool.observer().is_attached());
+
+        {
+            auto v1 = pool.allocate();
+            auto v2 = pool.allocate();
+        }
+
+        pool.free_unused();
+        pool.observer().detach();
+        pool.allocate();
+
+        EXPECT_EQ(writer->recorded(), 6U);
+    }
+
+    recycle::trace_contents trace = recycle::read_trace(path);
+    EXPECT_EQ(trace.m_lost, 0U);
+    ASSERT_EQ(trace.m_events.size(), 6U);
+
+    using type = recycle::trace_event_type;
+
+    // The first allocation hits the resource released before
+    EXPECT_EQ(trace.m_events[0].m_type, type::allocate);
+    EXPECT_EQ(trace.m_events[1].m_type, type::miss);
+    EXPECT_EQ(trace.m_events[2].m_type, type::allocate);
+    EXPECT_EQ(trace.m_events[3].m_type, type::release);
+    EXPECT_EQ(trace.m_events[4].m_type, type::release);
+    EXPECT_EQ(trace.m_events[5].m_type, type::free_unused);
+    EXPECT_EQ(trace.m_events[5].m_value, 2U);
+
+    for (std::size_t i = 0; i < trace.m_events.size(); ++i)
+    {
+        EXPECT_EQ(trace.m_events[i].m_sequence, i + 1);
+        EXPECT_EQ(trace.m_events[i].m_pool, 7U);
+        EXPECT_EQ(trace.m_events[i].m_thread, recycle::trace_thread_id());
+
+        if (i > 0)
+        {
+            EXPECT_GE(trace.m_events[i].m_time, trace.m_events[i - 1].m_time);
+        }
+    }
+
+    std::remove(path.c_str());
+}
+
+/// Test that a copy of a pool does not record into the writer of the
+/// original pool
+TEST(test_trace_recorder, copy)
+{
+    std::string path = testing::TempDir() + "recycle_test_trace_copy";
+
+    auto writer = std::make_shared<recycle::trace_writer>(path, 16);
+
+    pool_type pool;
+    pool.observer().attach(writer, 1);
+
+    pool_type copy(pool);
+    EXPECT_FALSE(copy.observer().is_attached());
+    copy.allocate();
+    EXPECT_EQ(writer->recorded(), 0U);
+
+    pool_type assigned;
+    assigned.observer().attach(writer, 2);
+    assigned = pool;
+    EXPECT_FALSE(assigned.observer().is_attached());
+
+    // Moving the pool keeps the recording
+    pool_type moved(std::move(pool));
+    EXPECT_TRUE(moved.observer().is_attached());
+    moved.allocate();
+
+    // The miss, allocate and release events
+    EXPECT_EQ(writer->recorded(), 3U);
+
+    std::remove(path.c_str());
+}
+
+/// Test that the ring keeps the most recent events
+TEST(test_trace_recorder, ring)
+{
+    std::string path = testing::TempDir() + "recycle_test_trace_ring";
+
+    {
+        recycle::trace_writer writer(path, 4);
+
+        for (uint32_t i = 0; i < 10; ++i)
+        {
+            writer.record(recycle::trace_event_type::allocate, 0, i);
+        }
+    }
+
+    recycle::trace_contents trace = recycle::read_trace(path);
+    EXPECT_EQ(trace.m_lost, 6U);
+    ASSERT_EQ(trace.m_events.size(), 4U);
+
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        EXPECT_EQ(trace.m_events[i].m_value, 6 + i);
+    }
+
+    std::remove(path.c_str());
+}
+
+/// Test recording from several threads and pools
+TEST(test_trace_recorder, threads)
+{
+    std::string path = testing::TempDir() + "recycle_test_trace_threads";
+
+    {
+        auto writer = std::make_shared<recycle::trace_writer>(path, 1024);
+
+        recycle::shared_pool<uint32_t, recycle::no_locking_policy,
+                             recycle::trace_recorder>
+            first;
+        recycle::shared_pool<uint32_t, recycle::no_locking_policy,
+                             recycle::trace_recorder>
+            second;
+
+        first.observer().attach(writer, 1);
+        second.observer().attach(writer, 2);
+
+        // Each thread uses its own pool, the writer is shared
+        std::thread t1([&first]() { first.allocate(); });
+        std::thread t2([&second]() { second.allocate(); });
+        t1.join();
+        t2.join();
+    }
+
+    recycle::trace_contents trace = recycle::read_trace(path);
+    ASSERT_EQ(trace.m_events.size(), 6U);
+
+    uint32_t first_thread = 0;
+    uint32_t second_thread = 0;
+
+    for (const auto& event : trace.m_events)
+    {
+        (event.m_pool == 1 ? first_thread : second_thread) = event.m_thread;
+    }
+
+    EXPECT_NE(first_thread, second_thread);
+
+    std::remove(path.c_str());
+}
+
+/// Test that invalid files are rejected
+TEST(test_trace_recorder, invalid)
+{
+    std::string path = testing::TempDir() + "recycle_test_trace_invalid";
+    std::remove(path.c_str());
+
+    EXPECT_THROW(recycle::read_trace(path), std::runtime_error);
+
+    {
+        std::ofstream file(path, std::ios::trunc);
+        file << "not a trace";
+    }
+
+    EXPECT_THROW(recycle::read_trace(path), std::runtime_error);
+
+    std::remove(path.c_str());
+}
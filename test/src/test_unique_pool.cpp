@@ -11,9 +11,12 @@
 #include <mutex>
 #include <thread>
 #include <type_traits>
+#include <vector>
 
 #include <gtest/gtest.h>
 
+#include "counting_observer.hpp"
+
 // Put tests classes in an anonymous namespace to avoid violations of
 // ODF (one-definition-rule) in other translation units
 namespace
@@ -283,6 +286,39 @@ TEST(test_unique_pool, recycle)
     EXPECT_EQ(recycled, 1U);
 }
 
+/// Test that a resource reset by the recycle function is dropped
+TEST(test_unique_pool, recycle_drop)
+{
+    dummy_two* drop = nullptr;
+
+    auto recycle = [&drop](std::unique_ptr<dummy_two>& o)
+    {
+        if (o.get() == drop)
+        {
+            o.reset();
+        }
+    };
+
+    auto make = []() -> std::unique_ptr<dummy_two>
+    { return std::make_unique<dummy_two>(3U); };
+
+    {
+        recycle::unique_pool<dummy_two> pool(make, recycle);
+
+        auto o1 = pool.allocate();
+        auto o2 = pool.allocate();
+        drop = o2.get();
+
+        o1.reset();
+        o2.reset();
+
+        EXPECT_EQ(pool.unused_resources(), 1U);
+        EXPECT_EQ(dummy_two::m_count, 1);
+    }
+
+    EXPECT_EQ(dummy_two::m_count, 0);
+}
+
 /// Test that copying the shared_pool works as expected.
 ///
 /// For a type to be regular then:
@@ -485,3 +521,413 @@ TEST(test_unique_pool, enable_shared_from_this)
 
     EXPECT_EQ(dummy_three::m_count, 0);
 }
+
+/// Test that the observer gets notified about the pool events
+TEST(test_unique_pool, observer)
+{
+    recycle::unique_pool<dummy_one, recycle::no_locking_policy,
+                         counting_observer>
+        pool;
+
+    {
+        auto o1 = pool.allocate();
+        auto o2 = pool.allocate();
+    }
+
+    EXPECT_EQ(pool.observer().m_allocations, 2U);
+    EXPECT_EQ(pool.observer().m_misses, 2U);
+    EXPECT_EQ(pool.observer().m_recycles, 2U);
+    EXPECT_EQ(pool.observer().m_unused, 2U);
+
+    auto o3 = pool.allocate();
+
+    EXPECT_EQ(pool.observer().m_allocations, 3U);
+    EXPECT_EQ(pool.observer().m_misses, 2U);
+    EXPECT_EQ(pool.observer().m_unused, 1U);
+
+    pool.free_unused();
+
+    EXPECT_EQ(pool.observer().m_freed, 1U);
+}
+
+/// Test that the byte budget limits the memory retained by the pool
+TEST(test_unique_pool, byte_budget)
+{
+    recycle::unique_pool<std::vector<uint8_t>> pool;
+
+    // By default the size of a resource is its sizeof
+    {
+        auto o1 = pool.allocate();
+    }
+
+    EXPECT_EQ(pool.unused_bytes(), sizeof(std::vector<uint8_t>));
+
+    pool.set_size_function([](const std::vector<uint8_t>& v)
+                           { return v.capacity(); });
+
+    EXPECT_EQ(pool.unused_bytes(), 0U);
+    pool.free_unused();
+
+    pool.set_max_unused_bytes(1500U);
+    EXPECT_EQ(pool.max_unused_bytes(), 1500U);
+
+    {
+        auto o1 = pool.allocate();
+        auto o2 = pool.allocate();
+        auto o3 = pool.allocate();
+
+        o1->reserve(1000U);
+        o2->reserve(1000U);
+        o3->reserve(200U);
+    }
+
+    // o3 and o2 are recycled first, o1 does not fit in the budget
+    EXPECT_EQ(pool.unused_resources(), 2U);
+    EXPECT_EQ(pool.unused_bytes(), 1200U);
+
+    {
+        auto o1 = pool.allocate();
+        EXPECT_EQ(pool.unused_bytes(), 200U);
+    }
+
+    EXPECT_EQ(pool.unused_bytes(), 1200U);
+
+    pool.free_unused();
+    EXPECT_EQ(pool.unused_resources(), 0U);
+    EXPECT_EQ(pool.unused_bytes(), 0U);
+}
+
+/// Test that the resources stay in the pool while they are measured with
+/// a new size function
+TEST(test_unique_pool, set_size_function_keeps_resources)
+{
+    recycle::unique_pool<std::vector<uint8_t>> pool;
+
+    {
+        auto o1 = pool.allocate();
+        auto o2 = pool.allocate();
+        auto o3 = pool.allocate();
+
+        o1->reserve(100U);
+        o2->reserve(100U);
+        o3->reserve(100U);
+    }
+
+    std::vector<std::size_t> seen;
+
+    pool.set_size_function(
+        [&pool, &seen](const std::vector<uint8_t>& v)
+        {
+            // Only the resource being measured is taken out of the pool
+            seen.push_back(pool.unused_resources());
+            return v.capacity();
+        });
+
+    std::vector<std::size_t> expected = {2, 2, 2};
+    EXPECT_EQ(seen, expected);
+    EXPECT_EQ(pool.unused_resources(), 3U);
+    EXPECT_EQ(pool.unused_bytes(), 300U);
+}
+
+/// Test that the pool can be shrunk incrementally
+TEST(test_unique_pool, shrink_to_and_trim)
+{
+    recycle::unique_pool<std::vector<uint8_t>> pool;
+
+    {
+        std::vector<recycle::unique_pool<std::vector<uint8_t>>::pool_ptr>
+            objects;
+
+        for (std::size_t i = 0; i < 10; ++i)
+        {
+            objects.push_back(pool.allocate());
+            objects.back()->resize(i);
+        }
+
+        // Recycle the objects in order, i.e. the object of size zero has
+        // been unused the longest
+        for (auto& o : objects)
+        {
+            o.reset();
+        }
+    }
+
+    EXPECT_EQ(pool.unused_resources(), 10U);
+
+    EXPECT_EQ(pool.trim(3U), 3U);
+    EXPECT_EQ(pool.unused_resources(), 7U);
+
+    EXPECT_EQ(pool.shrink_to(8U), 0U);
+    EXPECT_EQ(pool.shrink_to(2U), 5U);
+    EXPECT_EQ(pool.unused_resources(), 2U);
+
+    // The most recently recycled objects are kept
+    auto o1 = pool.allocate();
+    auto o2 = pool.allocate();
+    EXPECT_EQ(o1->size(), 9U);
+    EXPECT_EQ(o2->size(), 8U);
+
+    EXPECT_EQ(pool.trim(10U), 0U);
+}
+
+/// Test acquiring and releasing raw resources
+TEST(test_unique_pool, acquire_release)
+{
+    {
+        recycle::unique_pool<dummy_one, recycle::no_locking_policy,
+                             counting_observer>
+            pool;
+
+        dummy_one* o1 = pool.acquire();
+        dummy_one* o2 = pool.acquire();
+        EXPECT_NE(o1, o2);
+        EXPECT_EQ(dummy_one::m_count, 2);
+        EXPECT_EQ(pool.unused_resources(), 0U);
+
+        pool.release(o1);
+        pool.release(o2);
+        EXPECT_EQ(pool.unused_resources(), 2U);
+        EXPECT_EQ(pool.observer().m_recycles, 2U);
+
+        // The most recently released resource is reused
+        dummy_one* o3 = pool.acquire();
+        EXPECT_EQ(o3, o2);
+        EXPECT_EQ(pool.observer().m_allocations, 3U);
+        EXPECT_EQ(pool.observer().m_misses, 2U);
+
+        // Raw resources and pool_ptr can be mixed
+        auto o4 = pool.allocate();
+        EXPECT_EQ(o4.get(), o1);
+        pool.release(o3);
+    }
+
+    EXPECT_EQ(dummy_one::m_count, 0);
+}
+
+/// Test the scoped_ptr RAII wrapper
+TEST(test_unique_pool, acquire_scoped)
+{
+    {
+        recycle::unique_pool<dummy_one> pool;
+
+        using scoped_ptr = recycle::unique_pool<dummy_one>::scoped_ptr;
+
+        dummy_one* raw = nullptr;
+
+        {
+            scoped_ptr o1 = pool.acquire_scoped();
+            EXPECT_TRUE(o1);
+            raw = o1.get();
+
+            scoped_ptr o2 = std::move(o1);
+            EXPECT_FALSE(o1);
+            EXPECT_EQ(o2.get(), raw);
+            EXPECT_EQ(pool.unused_resources(), 0U);
+        }
+
+        EXPECT_EQ(pool.unused_resources(), 1U);
+
+        scoped_ptr o3 = pool.acquire_scoped();
+        EXPECT_EQ(o3.get(), raw);
+
+        o3.reset();
+        EXPECT_FALSE(o3);
+        EXPECT_EQ(pool.unused_resources(), 1U);
+
+        // Ownership can escape to the raw API
+        scoped_ptr o4 = pool.acquire_scoped();
+        dummy_one* released = o4.release();
+        EXPECT_FALSE(o4);
+        EXPECT_EQ(pool.unused_resources(), 0U);
+        pool.release(released);
+        EXPECT_EQ(pool.unused_resources(), 1U);
+
+        EXPECT_FALSE(std::is_copy_constructible<scoped_ptr>::value);
+    }
+
+    EXPECT_EQ(dummy_one::m_count, 0);
+}
+
+/// Test that misses create batches of resources
+TEST(test_unique_pool, growth_policy)
+{
+    using pool_type = recycle::unique_pool<std::vector<uint8_t>>;
+
+    std::vector<std::size_t> requests;
+
+    pool_type pool;
+    pool.set_batch_allocate_function(
+        [&requests](std::size_t n)
+        {
+            requests.push_back(n);
+
+            // One allocation shared by the whole batch would go here
+            std::vector<pool_type::value_ptr> batch;
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                batch.push_back(std::make_unique<std::vector<uint8_t>>());
+            }
+            return batch;
+        });
+
+    // Without a growth policy a single resource is created
+    auto o1 = pool.allocate();
+    EXPECT_TRUE(requests.empty());
+
+    recycle::growth_policy growth;
+    growth.m_initial_batch = 2;
+    growth.m_factor = 2.0;
+    growth.m_max_batch = 8;
+    pool.set_growth_policy(growth);
+
+    std::vector<pool_type::pool_ptr> objects;
+    for (std::size_t i = 0; i < 14; ++i)
+    {
+        objects.push_back(pool.allocate());
+    }
+
+    std::vector<std::size_t> expected = {2, 4, 8};
+    EXPECT_EQ(requests, expected);
+    EXPECT_EQ(pool.unused_resources(), 0U);
+
+    // The next miss is capped at the maximum
+    objects.push_back(pool.allocate());
+    EXPECT_EQ(requests.back(), 8U);
+    EXPECT_EQ(pool.unused_resources(), 7U);
+
+    // Freeing unused resources starts over with the initial batch
+    pool.free_unused();
+    pool.allocate();
+    EXPECT_EQ(requests.back(), 2U);
+    EXPECT_EQ(pool.unused_resources(), 2U);
+}
+
+/// Test batches without a batch allocate function and within the budget
+TEST(test_unique_pool, growth_policy_budget)
+{
+    recycle::unique_pool<dummy_one, recycle::no_locking_policy,
+                         counting_observer>
+        pool;
+
+    recycle::growth_policy growth;
+    growth.m_initial_batch = 4;
+    pool.set_growth_policy(growth);
+    pool.set_max_unused_bytes(2 * sizeof(dummy_one));
+
+    {
+        auto o1 = pool.allocate();
+        EXPECT_EQ(pool.unused_resources(), 2U);
+        EXPECT_EQ(pool.observer().m_misses, 1U);
+        EXPECT_EQ(pool.observer().m_unused, 2U);
+
+        // The extra resource over the budget has been destroyed
+        EXPECT_EQ(dummy_one::m_count, 3);
+    }
+
+    EXPECT_EQ(dummy_one::m_count, 2);
+}
+
+/// Test that bad results of the batch allocate function are tolerated
+TEST(test_unique_pool, growth_policy_bad_batch)
+{
+    using pool_type = recycle::unique_pool<std::vector<uint8_t>>;
+
+    std::vector<std::size_t> requests;
+
+    pool_type pool;
+    pool.set_batch_allocate_function(
+        [&requests](std::size_t n)
+        {
+            requests.push_back(n);
+
+            // The first batch is empty, the others hold a null and one
+            // resource too many
+            std::vector<pool_type::value_ptr> batch;
+            if (requests.size() > 1)
+            {
+                batch.push_back(nullptr);
+                for (std::size_t i = 0; i <= n; ++i)
+                {
+                    batch.push_back(std::make_unique<std::vector<uint8_t>>());
+                }
+            }
+            return batch;
+        });
+
+    recycle::growth_policy growth;
+    growth.m_initial_batch = 3;
+    pool.set_growth_policy(growth);
+
+    // The allocate function is used for the empty batch
+    auto o1 = pool.allocate();
+    ASSERT_TRUE(o1);
+    EXPECT_EQ(pool.unused_resources(), 2U);
+
+    // The null and the extra resource are dropped
+    auto resources = pool.borrow(5);
+    EXPECT_EQ(resources.size(), 5U);
+    for (const auto& resource : resources)
+    {
+        EXPECT_TRUE(resource);
+    }
+
+    // A single resource is created with the allocate function
+    auto more = pool.borrow(1);
+    EXPECT_EQ(more.size(), 1U);
+
+    std::vector<std::size_t> expected = {3, 3};
+    EXPECT_EQ(requests, expected);
+}
+
+/// Test taking and putting back several resources at once
+TEST(test_unique_pool, borrow_give_back)
+{
+    recycle::unique_pool<dummy_one, recycle::no_locking_policy,
+                         counting_observer>
+        pool;
+
+    EXPECT_EQ(pool.prewarm(2), 2U);
+
+    auto resources = pool.borrow(5);
+    EXPECT_EQ(resources.size(), 5U);
+    EXPECT_EQ(pool.unused_resources(), 0U);
+    EXPECT_EQ(pool.observer().m_misses, 3U);
+    EXPECT_EQ(pool.observer().m_allocations, 5U);
+    EXPECT_EQ(dummy_one::m_count, 5);
+
+    // Only what fits in the budget is kept
+    pool.set_max_unused_bytes(4 * sizeof(dummy_one));
+    pool.give_back(std::move(resources));
+    EXPECT_EQ(pool.unused_resources(), 4U);
+    EXPECT_EQ(pool.observer().m_recycles, 5U);
+    EXPECT_EQ(pool.observer().m_unused, 4U);
+    EXPECT_EQ(dummy_one::m_count, 4);
+
+    pool.free_unused();
+    EXPECT_EQ(dummy_one::m_count, 0);
+}
+
+/// Test that the resources reset by the recycle function are dropped when
+/// given back
+TEST(test_unique_pool, give_back_drop)
+{
+    auto recycle = [](std::unique_ptr<dummy_one>& o) { o.reset(); };
+
+    recycle::unique_pool<dummy_one, recycle::no_locking_policy,
+                         counting_observer>
+        pool(make_dummy_one, recycle);
+
+    auto resources = pool.borrow(2);
+    EXPECT_EQ(resources.size(), 2U);
+    EXPECT_EQ(dummy_one::m_count, 2);
+
+    pool.give_back(std::move(resources));
+    EXPECT_EQ(pool.unused_resources(), 0U);
+    EXPECT_EQ(pool.unused_bytes(), 0U);
+    EXPECT_EQ(pool.observer().m_recycles, 2U);
+    EXPECT_EQ(dummy_one::m_count, 0);
+
+    auto o = pool.allocate();
+    EXPECT_TRUE(o);
+    EXPECT_EQ(dummy_one::m_count, 1);
+}
@@ -0,0 +1,137 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+#include <recycle/usdt_observer.hpp>
+
+#include <recycle/unique_pool.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<elf.h>)
+#include <elf.h>
+#define RECYCLE_TEST_ELF 1
+#endif
+#endif
+
+static_assert(RECYCLE_HAS_USDT == 0 || RECYCLE_HAS_USDT == 1,
+              "RECYCLE_HAS_USDT must tell whether the probes are compiled");
+
+// The probes live in the code, not in the observer
+static_assert(std::is_empty<recycle::usdt_observer>::value,
+              "The usdt_observer must be empty");
+
+#if defined(RECYCLE_TEST_ELF)
+namespace
+{
+/// Reads an object from the ELF file
+/// @return False if the object is not within the file
+template <class Object>
+bool read(const std::vector<char>& elf, std::size_t offset, Object& object)
+{
+    if (offset > elf.size() || elf.size() - offset < sizeof(Object))
+    {
+        return false;
+    }
+
+    std::memcpy(&object, elf.data() + offset, sizeof(Object));
+    return true;
+}
+
+/// @return The names of the USDT probes of the provider found in the ELF
+///         notes of the executable of this process
+std::set<std::string> probes(const std::string& provider)
+{
+    std::ifstream file("/proc/self/exe", std::ios::binary);
+    std::vector<char> elf((std::istreambuf_iterator<char>(file)),
+                          std::istreambuf_iterator<char>());
+
+    std::set<std::string> names;
+
+    Elf64_Ehdr header;
+    if (!read(elf, 0, header) || header.e_ident[EI_CLASS] != ELFCLASS64)
+    {
+        return names;
+    }
+
+    for (std::size_t i = 0; i < header.e_shnum; ++i)
+    {
+        Elf64_Shdr section;
+        if (!read(elf, header.e_shoff + i * header.e_shentsize, section) ||
+            section.sh_type != SHT_NOTE)
+        {
+            continue;
+        }
+
+        std::size_t offset = section.sh_offset;
+        std::size_t end = std::min<std::size_t>(
+            elf.size(), section.sh_offset + section.sh_size);
+
+        Elf64_Nhdr note;
+        while (offset < end && read(elf, offset, note))
+        {
+            offset += sizeof(note);
+            std::size_t desc = offset + ((note.n_namesz + 3) & ~3U);
+            std::size_t next = desc + ((note.n_descsz + 3) & ~3U);
+
+            // The description of a stapsdt note holds three addresses
+            // followed by the provider and the probe name
+            if (next <= end && note.n_type == 3 && note.n_namesz == 8 &&
+                std::memcmp(elf.data() + offset, "stapsdt", 8) == 0 &&
+                note.n_descsz > 3 * sizeof(uint64_t))
+            {
+                const char* text = elf.data() + desc + 3 * sizeof(uint64_t);
+                std::size_t size = note.n_descsz - 3 * sizeof(uint64_t);
+                std::string strings(text, size);
+
+                std::size_t split = strings.find('\0');
+                if (split != std::string::npos &&
+                    strings.compare(0, split, provider) == 0)
+                {
+                    names.insert(strings.c_str() + split + 1);
+                }
+            }
+
+            offset = next;
+        }
+    }
+
+    return names;
+}
+}
+
+/// Test that the probes are compiled into the executable if <sys/sdt.h>
+/// was found, and that nothing is compiled in otherwise
+TEST(test_usdt_observer, probes)
+{
+    recycle::unique_pool<int, recycle::no_locking_policy,
+                         recycle::usdt_observer>
+        pool;
+
+    {
+        auto o1 = pool.allocate();
+    }
+    pool.free_unused();
+
+    std::set<std::string> found = probes("recycle");
+
+#if RECYCLE_HAS_USDT
+    std::set<std::string> expected = {"allocate", "miss", "recycle",
+                                      "free_unused"};
+    EXPECT_EQ(found, expected);
+#else
+    EXPECT_TRUE(found.empty());
+#endif
+}
+#endif
@@ -0,0 +1,231 @@
+// Copyright Steinwurf ApS 2014.
+// All Rights Reserved
+//
+// Distributed under the "BSD License". See the accompanying LICENSE.rst file.
+
+/// Replays a trace recorded by the recycle::trace_recorder against a
+/// number of pool configurations and reports the hit rate, peak memory
+/// and lock acquisitions of each.
+///
+/// Every combination of the listed retention limits, shard counts and
+/// thread cache sizes is simulated. A retention limit of "unlimited"
+/// retains every released resource, as the unique_pool does without a
+/// byte budget.
+///
+/// Usage: recycle_trace_replay <trace> [--bytes N] [--retention LIST]
+///                             [--shards LIST] [--cache LIST]
+///
+/// Where LIST is a comma separated list of numbers, e.g.
+///
+///     recycle_trace_replay pool.trace --retention 16,64,unlimited
+///                          --shards 1,4 --cache 0,8
+
+#include <recycle/pool_simulator.hpp>
+#include <recycle/trace_recorder.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <limits>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+const std::size_t unlimited = std::numeric_limits<std::size_t>::max();
+
+void usage()
+{
+    std::fprintf(stderr,
+                 "Usage: recycle_trace_replay <trace> [--bytes N] "
+                 "[--retention LIST]\n"
+                 "                            [--shards LIST] "
+                 "[--cache LIST]\n");
+}
+
+/// Parses a number, "unlimited" is allowed if limit is true
+bool parse_number(const std::string& text, bool limit, std::size_t& value)
+{
+    if (limit && text == "unlimited")
+    {
+        value = unlimited;
+        return true;
+    }
+
+    if (text.empty() ||
+        text.find_first_not_of("0123456789") != std::string::npos)
+    {
+        return false;
+    }
+
+    value = std::strtoull(text.c_str(), nullptr, 10);
+    return true;
+}
+
+/// Parses a comma separated list of numbers
+bool parse_list(const std::string& text, bool limit,
+                std::vector<std::size_t>& values)
+{
+    values.clear();
+
+    std::istringstream list(text);
+    std::string item;
+
+    while (std::getline(list, item, ','))
+    {
+        std::size_t value = 0;
+        if (!parse_number(item, limit, value))
+        {
+            return false;
+        }
+
+        values.push_back(value);
+    }
+
+    return !values.empty();
+}
+
+std::string format_limit(std::size_t value)
+{
+    return value == unlimited ? "unlimited" : std::to_string(value);
+}
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    std::string path = argv[1];
+    std::size_t bytes = 1;
+    std::vector<std::size_t> retentions = {unlimited};
+    std::vector<std::size_t> shards = {1};
+    std::vector<std::size_t> caches = {0};
+
+    for (int i = 2; i < argc; i += 2)
+    {
+        std::string option = argv[i];
+
+        if (i + 1 >= argc)
+        {
+            usage();
+            return EXIT_FAILURE;
+        }
+
+        std::string value = argv[i + 1];
+        bool valid = false;
+
+        if (option == "--bytes")
+        {
+            valid = parse_number(value, false, bytes) && bytes > 0;
+        }
+        else if (option == "--retention")
+        {
+            valid = parse_list(value, true, retentions);
+        }
+        else if (option == "--shards")
+        {
+            valid = parse_list(value, false, shards) &&
+                    *std::min_element(shards.begin(), shards.end()) > 0;
+        }
+        else if (option == "--cache")
+        {
+            valid = parse_list(value, false, caches);
+        }
+
+        if (!valid)
+        {
+            std::fprintf(stderr, "Invalid option: %s %s\n", option.c_str(),
+                         value.c_str());
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    recycle::trace_contents trace;
+
+    try
+    {
+        trace = recycle::read_trace(path);
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return EXIT_FAILURE;
+    }
+
+    // Summarize the recorded run
+    std::set<uint32_t> pools;
+    std::set<uint32_t> threads;
+    uint64_t allocations = 0;
+    uint64_t misses = 0;
+
+    for (const recycle::trace_event& event : trace.m_events)
+    {
+        pools.insert(event.m_pool);
+        threads.insert(event.m_thread);
+
+        if (event.m_type == recycle::trace_event_type::allocate)
+        {
+            ++allocations;
+        }
+        else if (event.m_type == recycle::trace_event_type::miss)
+        {
+            ++misses;
+        }
+    }
+
+    std::printf("trace: %zu events, %zu pools, %zu threads, %llu lost\n",
+                trace.m_events.size(), pools.size(), threads.size(),
+                static_cast<unsigned long long>(trace.m_lost));
+
+    if (allocations > 0)
+    {
+        double hit_rate = 1.0 - static_cast<double>(misses) /
+                                    static_cast<double>(allocations);
+        std::printf("recorded: %llu allocations, hit rate %.2f%%\n",
+                    static_cast<unsigned long long>(allocations),
+                    hit_rate * 100.0);
+    }
+
+    std::printf("\n%-10s %7s %7s %9s %15s %15s %18s\n", "retention",
+                "shards", "cache", "hit rate", "peak resources",
+                "peak bytes", "lock acquisitions");
+
+    for (std::size_t retention : retentions)
+    {
+        for (std::size_t shard_count : shards)
+        {
+            for (std::size_t cache : caches)
+            {
+                recycle::simulation_config config;
+                config.m_max_unused = retention;
+                config.m_shards = shard_count;
+                config.m_thread_cache = cache;
+                config.m_resource_bytes = bytes;
+
+                recycle::simulation_result result =
+                    recycle::simulate(trace.m_events, config);
+
+                std::printf("%-10s %7zu %7zu %8.2f%% %15llu %15llu %18llu\n",
+                            format_limit(retention).c_str(), shard_count,
+                            cache, result.hit_rate() * 100.0,
+                            static_cast<unsigned long long>(
+                                result.m_peak_resources),
+                            static_cast<unsigned long long>(
+                                result.m_peak_bytes),
+                            static_cast<unsigned long long>(
+                                result.m_lock_acquisitions));
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}